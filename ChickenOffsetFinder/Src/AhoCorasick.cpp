@@ -0,0 +1,117 @@
+#include "AhoCorasick.h"
+
+#include <algorithm>
+
+namespace COF
+{
+  std::size_t AhoCorasick::AddPattern(const std::vector<std::uint8_t>& Pattern)
+  {
+    auto It = std::find(this->Patterns.begin(), this->Patterns.end(), Pattern);
+
+    if (It != this->Patterns.end())
+    {
+      return static_cast<std::size_t>(It - this->Patterns.begin());
+    }
+
+    this->Patterns.push_back(Pattern);
+    return this->Patterns.size() - 1;
+  }
+
+  const std::vector<std::uint8_t>& AhoCorasick::GetPattern(std::size_t PatternID) const
+  {
+    return this->Patterns[PatternID];
+  }
+
+  std::size_t AhoCorasick::GetPatternCount() const
+  {
+    return this->Patterns.size();
+  }
+
+  void AhoCorasick::Build()
+  {
+    // Give every byte used by a pattern its own class
+    this->ByteClasses.fill(0);
+    this->ClassCount = 1;
+
+    for (const auto& Pattern : this->Patterns)
+    {
+      for (std::uint8_t Byte : Pattern)
+      {
+        if (!this->ByteClasses[Byte])
+        {
+          this->ByteClasses[Byte] = static_cast<std::uint16_t>(this->ClassCount++);
+        }
+      }
+    }
+
+    const std::size_t Classes = this->ClassCount;
+
+    // Trie, 0 doubles as "no child" since the root is never a child
+    this->Transitions.assign(Classes, 0);
+    this->Terminals.assign(1, -1);
+
+    for (std::size_t ID = 0; ID < this->Patterns.size(); ++ID)
+    {
+      std::uint32_t State = 0;
+
+      for (std::uint8_t Byte : this->Patterns[ID])
+      {
+        std::size_t Slot = State * Classes + this->ByteClasses[Byte];
+
+        if (!this->Transitions[Slot])
+        {
+          std::uint32_t NewState = static_cast<std::uint32_t>(this->Terminals.size());
+          this->Transitions[Slot] = NewState;
+          this->Transitions.resize(this->Transitions.size() + Classes, 0);
+          this->Terminals.push_back(-1);
+        }
+
+        State = this->Transitions[Slot];
+      }
+
+      this->Terminals[State] = static_cast<std::int32_t>(ID);
+    }
+
+    // Breadth first, turn the trie into a DFA by filling in missing transitions
+    // from the failure state, which is always on a lower depth and already complete.
+    const std::size_t StateCount = this->Terminals.size();
+    std::vector<std::uint32_t> Failures(StateCount, 0);
+    std::vector<std::uint32_t> Queue;
+    Queue.reserve(StateCount);
+    this->DictLinks.assign(StateCount, -1);
+
+    for (std::size_t Class = 0; Class < Classes; ++Class)
+    {
+      if (std::uint32_t Child = this->Transitions[Class]; Child)
+      {
+        Queue.push_back(Child);
+      }
+    }
+
+    for (std::size_t Head = 0; Head < Queue.size(); ++Head)
+    {
+      std::uint32_t State = Queue[Head];
+      std::uint32_t Failure = Failures[State];
+
+      this->DictLinks[State] = (this->Terminals[Failure] >= 0)
+        ? static_cast<std::int32_t>(Failure)
+        : this->DictLinks[Failure];
+
+      for (std::size_t Class = 0; Class < Classes; ++Class)
+      {
+        std::uint32_t& Child = this->Transitions[State * Classes + Class];
+        std::uint32_t FailureChild = this->Transitions[Failure * Classes + Class];
+
+        if (Child)
+        {
+          Failures[Child] = FailureChild;
+          Queue.push_back(Child);
+        }
+        else
+        {
+          Child = FailureChild;
+        }
+      }
+    }
+  }
+} // !namespace COF
@@ -0,0 +1,70 @@
+#ifndef COF_AHO_CORASICK_H
+#define COF_AHO_CORASICK_H
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace COF
+{
+  // Aho-Corasick automaton over bytes.
+  // Finds every occurrence of any number of patterns in a single pass over the input.
+  // Transitions are stored as a full DFA over byte classes (only the bytes used by the patterns
+  // get their own class), which keeps the table small for text-like patterns.
+  class AhoCorasick
+  {
+    std::vector<std::vector<std::uint8_t>> Patterns;
+
+    std::array<std::uint16_t, 256> ByteClasses{}; // Class 0 is every byte not used by any pattern
+    std::size_t ClassCount = 1;
+
+    std::vector<std::uint32_t> Transitions; // [State * ClassCount + Class]
+    std::vector<std::int32_t> Terminals;    // Pattern ending at state, -1 if none
+    std::vector<std::int32_t> DictLinks;    // Nearest terminal state along the failure chain, -1 if none
+
+  public:
+    // Returns ID of the pattern, adding the same pattern twice returns the same ID.
+    // Must be called before Build(), empty patterns are not allowed.
+    std::size_t AddPattern(const std::vector<std::uint8_t>& Pattern);
+
+    const std::vector<std::uint8_t>& GetPattern(std::size_t PatternID) const;
+    std::size_t GetPatternCount() const;
+
+    void Build();
+
+    // Calls OnMatch(PatternID, MatchOffset) for every occurrence, in order of the match end.
+    // OnMatch returns false to stop searching.
+    template <typename Callback>
+    void Search(const std::uint8_t* Data, std::size_t Size, Callback&& OnMatch) const
+    {
+      if (this->Transitions.empty())
+      {
+        return;
+      }
+
+      std::uint32_t State = 0;
+
+      for (std::size_t I = 0; I < Size; ++I)
+      {
+        State = this->Transitions[State * this->ClassCount + this->ByteClasses[Data[I]]];
+
+        std::int32_t Output = (this->Terminals[State] >= 0)
+          ? static_cast<std::int32_t>(State)
+          : this->DictLinks[State];
+
+        for (; Output >= 0; Output = this->DictLinks[Output])
+        {
+          std::size_t PatternID = static_cast<std::size_t>(this->Terminals[Output]);
+
+          if (!OnMatch(PatternID, I + 1 - this->Patterns[PatternID].size()))
+          {
+            return;
+          }
+        }
+      }
+    }
+  };
+} // !namespace COF
+
+#endif // !COF_AHO_CORASICK_H
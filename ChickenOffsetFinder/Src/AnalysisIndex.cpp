@@ -0,0 +1,173 @@
+#include "AnalysisIndex.h"
+
+#include <filesystem>
+#include <system_error>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace COF
+{
+  namespace AnalysisIndex
+  {
+    std::string GetPath(const std::string& DumpPath)
+    {
+      return DumpPath + ".cofidx";
+    }
+
+    const SectionEntry& Header::GetSection(Section Which) const
+    {
+      return this->Sections[static_cast<std::size_t>(Which)];
+    }
+
+    SectionEntry& Header::GetSection(Section Which)
+    {
+      return this->Sections[static_cast<std::size_t>(Which)];
+    }
+
+    bool Header::IsValid(std::uint64_t ContentHash, std::uint64_t FileSize) const
+    {
+      if (this->Magic != AnalysisIndex::Magic ||
+        this->Version != AnalysisIndex::Version ||
+        this->HeaderSize != sizeof(Header) ||
+        this->ContentHash != ContentHash)
+      {
+        return false;
+      }
+
+      for (const SectionEntry& Entry : this->Sections)
+      {
+        if (Entry.Offset && (Entry.Offset < sizeof(Header) || Entry.Size > FileSize || Entry.Offset > FileSize - Entry.Size))
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    std::uint64_t HashBytes(const std::uint8_t* Data, std::size_t Size, std::uint64_t Seed)
+    {
+      constexpr std::uint64_t Prime = 0x100000001B3;
+      std::uint64_t Hash = Seed;
+      std::size_t I = 0;
+
+      // One multiply per word keeps this at memory speed for a whole .text
+      for (; I + sizeof(std::uint64_t) <= Size; I += sizeof(std::uint64_t))
+      {
+        std::uint64_t Word;
+        std::memcpy(&Word, Data + I, sizeof(Word));
+        Hash = (Hash ^ Word) * Prime;
+      }
+
+      for (; I < Size; ++I)
+      {
+        Hash = (Hash ^ Data[I]) * Prime;
+      }
+
+      // Buffers that only differ in trailing zero bytes must not collide
+      Hash = (Hash ^ static_cast<std::uint64_t>(Size)) * Prime;
+      return Hash ^ (Hash >> 32);
+    }
+
+    bool Writer::Good() const
+    {
+      return static_cast<bool>(this->OutFile);
+    }
+
+    bool Writer::Finish()
+    {
+      this->OutFile.close();
+
+      if (!this->OutFile)
+      {
+        return false;
+      }
+
+      std::error_code Error;
+      std::filesystem::rename(this->TempPath, this->FilePath, Error);
+      this->Finished = !Error;
+      return this->Finished;
+    }
+
+    std::uint64_t Writer::Tell()
+    {
+      return static_cast<std::uint64_t>(this->OutFile.tellp());
+    }
+
+    void Writer::Seek(std::uint64_t Offset)
+    {
+      this->OutFile.seekp(static_cast<std::streamoff>(Offset));
+    }
+
+    void Writer::WriteBytes(const void* Data, std::size_t Size)
+    {
+      if (Size)
+      {
+        this->OutFile.write(static_cast<const char*>(Data), static_cast<std::streamsize>(Size));
+      }
+    }
+
+    void Writer::WriteString(const std::string& String)
+    {
+      this->Write<std::uint64_t>(String.size());
+      this->WriteBytes(String.data(), String.size());
+    }
+
+    Writer::Writer(const std::string& FilePath)
+      : FilePath(FilePath), TempPath(FilePath + ".tmp")
+    {
+      this->OutFile.open(this->TempPath, std::ios::binary | std::ios::trunc);
+    }
+
+    Writer::~Writer()
+    {
+      if (!this->Finished)
+      {
+        this->OutFile.close();
+
+        std::error_code Error;
+        std::filesystem::remove(this->TempPath, Error);
+      }
+    }
+
+    bool Reader::Good() const
+    {
+      return !this->Failed;
+    }
+
+    const std::uint8_t* Reader::ReadBytes(std::size_t Count)
+    {
+      if (this->Failed || Count > this->Size - this->Position)
+      {
+        this->Failed = true;
+        return nullptr;
+      }
+
+      const std::uint8_t* Bytes = this->Data + this->Position;
+      this->Position += Count;
+      return Bytes;
+    }
+
+    bool Reader::ReadString(std::string& String)
+    {
+      std::uint64_t Length = 0;
+
+      if (!this->Read(Length) || Length > this->Size - this->Position)
+      {
+        this->Failed = true;
+        return false;
+      }
+
+      const std::uint8_t* Bytes = this->ReadBytes(static_cast<std::size_t>(Length));
+      String.assign(reinterpret_cast<const char*>(Bytes), static_cast<std::size_t>(Length));
+      return true;
+    }
+
+    Reader::Reader(const std::uint8_t* Data, std::size_t Size)
+      : Data(Data), Size(Size)
+    {
+    }
+  } // !namespace AnalysisIndex
+} // !namespace COF
@@ -0,0 +1,164 @@
+#ifndef COF_ANALYSIS_INDEX_H
+#define COF_ANALYSIS_INDEX_H
+
+#include <fstream>
+#include <vector>
+#include <string>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace COF
+{
+  // Sidecar file (<dump>.cofidx) caching the results of DumpAnalyzer::Analyze(),
+  // so re-running the same dump skips the .text sweeps.
+  // The file is a raw dump of the analysis tables for this build of COF, it is not portable.
+  namespace AnalysisIndex
+  {
+    constexpr std::uint64_t Magic = 0x0000584449464F43; // "COFIDX"
+
+    // Bump whenever the layout of the file or the output of the analysis changes,
+    // older index files are then rebuilt instead of loaded.
+    constexpr std::uint32_t Version = 4;
+
+    // Artifacts stored in the index. Each one is optional, the file only holds
+    // the ones that were needed (computed) by some run over the dump.
+    enum class Section : std::uint32_t
+    {
+      FileVersion,
+      Functions,
+      CrossReferences,
+      Instructions,
+      Count
+    };
+
+    struct SectionEntry
+    {
+      std::uint64_t Offset = 0; // File offset, 0 if not stored
+      std::uint64_t Size = 0;
+    };
+
+    struct Header
+    {
+      std::uint64_t Magic = 0;
+      std::uint32_t Version = 0;
+      std::uint32_t HeaderSize = 0;
+      std::uint64_t ContentHash = 0; // See HashBytes(), identifies the dump contents
+      SectionEntry Sections[static_cast<std::size_t>(Section::Count)];
+
+      const SectionEntry& GetSection(Section Which) const;
+      SectionEntry& GetSection(Section Which);
+
+      // Whether the header belongs to an index of this version for the dump ContentHash identifies,
+      // with all sections inside the file.
+      bool IsValid(std::uint64_t ContentHash, std::uint64_t FileSize) const;
+    };
+
+    std::string GetPath(const std::string& DumpPath);
+
+    // Fast non-cryptographic 64-bit hash (FNV-1a over 8 byte words).
+    // Chain calls through Seed to hash several buffers.
+    std::uint64_t HashBytes(const std::uint8_t* Data, std::size_t Size, std::uint64_t Seed = 0xCBF29CE484222325);
+
+    // Streams the index into a temporary file, Finish() moves it into place.
+    // Readers never see a partially written index.
+    class Writer
+    {
+      std::string FilePath;
+      std::string TempPath;
+      std::ofstream OutFile;
+      bool Finished = false;
+
+    public:
+      bool Good() const;
+      bool Finish();
+      std::uint64_t Tell();
+      void Seek(std::uint64_t Offset);
+      void WriteBytes(const void* Data, std::size_t Size);
+
+      template <typename T>
+      void Write(const T& Value)
+      {
+        static_assert(std::is_trivially_copyable_v<T>);
+        this->WriteBytes(&Value, sizeof(T));
+      }
+
+      // Element size is stored too, so a layout change reads as a corrupt file
+      template <typename T>
+      void WriteArray(const std::vector<T>& Values)
+      {
+        static_assert(std::is_trivially_copyable_v<T>);
+        this->Write<std::uint64_t>(Values.size());
+        this->Write<std::uint32_t>(sizeof(T));
+        this->WriteBytes(Values.data(), Values.size() * sizeof(T));
+      }
+
+      void WriteString(const std::string& String);
+
+      Writer& operator=(const Writer& Other) = delete;
+      Writer(const Writer& Other) = delete;
+      explicit Writer(const std::string& FilePath);
+      ~Writer();
+    };
+
+    // Bounds checked reads from a section of a (mapped) index file.
+    // Any failed read leaves the reader failed, check Good() once after reading everything.
+    class Reader
+    {
+      const std::uint8_t* Data = nullptr;
+      std::size_t Size = 0;
+      std::size_t Position = 0;
+      bool Failed = false;
+
+    public:
+      bool Good() const;
+      const std::uint8_t* ReadBytes(std::size_t Count);
+
+      template <typename T>
+      bool Read(T& Value)
+      {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const std::uint8_t* Bytes = this->ReadBytes(sizeof(T));
+
+        if (Bytes)
+        {
+          std::memcpy(&Value, Bytes, sizeof(T));
+        }
+
+        return Bytes != nullptr;
+      }
+
+      template <typename T>
+      bool ReadArray(std::vector<T>& Values)
+      {
+        static_assert(std::is_trivially_copyable_v<T>);
+        std::uint64_t Count = 0;
+        std::uint32_t ElementSize = 0;
+
+        if (!this->Read(Count) || !this->Read(ElementSize) || ElementSize != sizeof(T) ||
+          Count > (this->Size - this->Position) / sizeof(T))
+        {
+          this->Failed = true;
+          return false;
+        }
+
+        const std::uint8_t* Bytes = this->ReadBytes(static_cast<std::size_t>(Count) * sizeof(T));
+        Values.resize(static_cast<std::size_t>(Count));
+
+        if (Count)
+        {
+          std::memcpy(Values.data(), Bytes, static_cast<std::size_t>(Count) * sizeof(T));
+        }
+
+        return true;
+      }
+
+      bool ReadString(std::string& String);
+
+      Reader(const std::uint8_t* Data, std::size_t Size);
+    };
+  } // !namespace AnalysisIndex
+} // !namespace COF
+
+#endif // !COF_ANALYSIS_INDEX_H
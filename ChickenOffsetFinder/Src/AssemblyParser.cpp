@@ -19,11 +19,48 @@
 #include <unordered_map>
 #include <utility>
 #include <any>
+#include <stdexcept>
 
 namespace COF
 {
   namespace AssemblyParser
   {
+    namespace
+    {
+      // Whole string must be a number (any base std::stoull accepts)
+      std::optional<std::uint64_t> ParseUnsigned(const std::string& NumberString)
+      {
+        std::string T = Util::String::Trim(NumberString);
+        std::size_t Parsed = 0;
+
+        try
+        {
+          std::uint64_t Value = std::stoull(T, &Parsed, 0);
+          return (Parsed == T.size()) ? std::optional<std::uint64_t>(Value) : std::nullopt;
+        }
+        catch (const std::logic_error&)
+        {
+          return std::nullopt;
+        }
+      }
+
+      std::optional<std::int64_t> ParseSigned(const std::string& NumberString)
+      {
+        std::string T = Util::String::Trim(NumberString);
+        std::size_t Parsed = 0;
+
+        try
+        {
+          std::int64_t Value = std::stoll(T, &Parsed, 0);
+          return (Parsed == T.size()) ? std::optional<std::int64_t>(Value) : std::nullopt;
+        }
+        catch (const std::logic_error&)
+        {
+          return std::nullopt;
+        }
+      }
+    } // !namespace
+
     std::optional<ZydisMnemonic> ParseMnemonic(const std::string& MnemonicString)
     {
       static std::unordered_map<std::string, ZydisMnemonic> MnemonicMap;
@@ -92,12 +129,138 @@ namespace COF
       return std::nullopt;
     }
 
+    std::optional<RegisterSet> ParseRegisterSet(const std::string& RegisterSetString)
+    {
+      static const std::unordered_map<std::string, std::vector<ZydisRegisterClass>> ClassMap =
+      {
+        { "GPR", { ZYDIS_REGCLASS_GPR8, ZYDIS_REGCLASS_GPR16, ZYDIS_REGCLASS_GPR32, ZYDIS_REGCLASS_GPR64 } },
+        { "GPR8", { ZYDIS_REGCLASS_GPR8 } },
+        { "GPR16", { ZYDIS_REGCLASS_GPR16 } },
+        { "GPR32", { ZYDIS_REGCLASS_GPR32 } },
+        { "GPR64", { ZYDIS_REGCLASS_GPR64 } },
+        { "X87", { ZYDIS_REGCLASS_X87 } },
+        { "MMX", { ZYDIS_REGCLASS_MMX } },
+        { "XMM", { ZYDIS_REGCLASS_XMM } },
+        { "YMM", { ZYDIS_REGCLASS_YMM } },
+        { "ZMM", { ZYDIS_REGCLASS_ZMM } },
+        { "SEG", { ZYDIS_REGCLASS_SEGMENT } },
+        { "MASK", { ZYDIS_REGCLASS_MASK } }
+      };
+
+      std::string Key = Util::String::ToUpper(Util::String::Trim(RegisterSetString));
+      RegisterSet Set;
+
+      if (Key == "?")
+      {
+        return Set.set();
+      }
+
+      if (auto Register = ParseRegister(Key))
+      {
+        return Set.set(*Register);
+      }
+
+      auto It = ClassMap.find(Key);
+
+      if (It == ClassMap.end())
+      {
+        return std::nullopt;
+      }
+
+      for (int I = 0; I <= ZYDIS_REGISTER_MAX_VALUE; ++I)
+      {
+        auto Class = ZydisRegisterGetClass(static_cast<ZydisRegister>(I));
+
+        if (std::find(It->second.begin(), It->second.end(), Class) != It->second.end())
+        {
+          Set.set(I);
+        }
+      }
+
+      return Set;
+    }
+
     bool IsRegister(const std::string& PotentialRegister)
     {
       return ParseRegister(PotentialRegister).has_value();
     }
 
-    std::optional<MemoryOperand> ParseMemoryOperand(const std::string& MemoryOperandString)
+    std::optional<ParsedOperand> ParseImmediateOperand(const std::string& ImmediateOperandString)
+    {
+      std::string T = Util::String::Trim(ImmediateOperandString);
+      ParsedOperand Op;
+      Op.Types = 1 << ZYDIS_OPERAND_TYPE_IMMEDIATE;
+
+      if (Util::String::ToUpper(T) == "IMM")
+      {
+        // Any immediate
+        return Op;
+      }
+
+      auto Range = T.find("..");
+
+      if (Range != std::string::npos)
+      {
+        // Min..Max (inclusive)
+        auto Min = ParseUnsigned(T.substr(0, Range));
+        auto Max = ParseUnsigned(T.substr(Range + 2));
+
+        if (!Min || !Max || *Min > *Max)
+        {
+          return std::nullopt;
+        }
+
+        Op.ImmMin = *Min;
+        Op.ImmMax = *Max;
+        return Op;
+      }
+
+      if (T.find('?') != std::string::npos)
+      {
+        // Hex value with nibble wild cards (e.g. 0x1??0)
+        if (T.size() < 3 || T.size() > 18 || T[0] != '0' || (T[1] != 'x' && T[1] != 'X'))
+        {
+          return std::nullopt;
+        }
+
+        std::uint64_t Wildcards = 0;
+
+        for (std::size_t I = 2; I < T.size(); ++I)
+        {
+          Wildcards <<= 4;
+          Op.ImmValue <<= 4;
+
+          if (T[I] == '?')
+          {
+            Wildcards |= 0xF;
+          }
+          else if (std::isxdigit(static_cast<unsigned char>(T[I])))
+          {
+            Op.ImmValue |= std::stoull(T.substr(I, 1), nullptr, 16);
+          }
+          else
+          {
+            return std::nullopt;
+          }
+        }
+
+        Op.ImmMask = ~Wildcards;
+        return Op;
+      }
+
+      auto Value = ParseUnsigned(T);
+
+      if (!Value)
+      {
+        return std::nullopt;
+      }
+
+      Op.ImmMin = *Value;
+      Op.ImmMax = *Value;
+      return Op;
+    }
+
+    std::optional<ParsedOperand> ParseMemoryOperand(const std::string& MemoryOperandString)
     {
       std::string Trimmed = Util::String::Trim(MemoryOperandString);
 
@@ -109,7 +272,10 @@ namespace COF
       }
 
       std::string Content = Trimmed.substr(1, Trimmed.size() - 2);
-      MemoryOperand Op;
+      ParsedOperand Op;
+      Op.Types = 1 << ZYDIS_OPERAND_TYPE_MEMORY;
+      bool HasBase = false;
+      bool HasDisp = false;
 
       // Split into signed tokens (+ or -)
       std::vector<std::pair<char, std::string>> Tokens;
@@ -136,7 +302,7 @@ namespace COF
 
         if (Tok.empty() || Tok == "?")
         {
-          // Wildcard: do not set Base, Index, Scale or Disp
+          // Wildcard: do not constrain Base, Index, Scale or Disp
           continue;
         }
 
@@ -144,55 +310,149 @@ namespace COF
         if (Star != std::string::npos)
         {
           // Index*Scale
-          std::string RegStr = Util::String::Trim(Tok.substr(0, Star));
+          auto IndexSet = ParseRegisterSet(Tok.substr(0, Star));
           std::string ScaleStr = Util::String::Trim(Tok.substr(Star + 1));
 
-          if (RegStr != "?")
+          if (!IndexSet)
           {
-            Op.Index = ParseRegister(RegStr);
+            return std::nullopt;
           }
 
+          Op.Index = *IndexSet;
+
           if (ScaleStr != "?")
           {
-            Op.Scale = static_cast<uint8_t>(std::stoull(ScaleStr, nullptr, 0));
+            auto Scale = ParseUnsigned(ScaleStr);
+
+            if (!Scale || (*Scale != 1 && *Scale != 2 && *Scale != 4 && *Scale != 8))
+            {
+              return std::nullopt;
+            }
+
+            Op.Scales = static_cast<std::uint16_t>(1 << *Scale);
           }
         }
-        else if (IsRegister(Tok))
+        else if (auto Registers = ParseRegisterSet(Tok))
         {
-          // Pure register token
-          auto R = ParseRegister(Tok);
-
-          if (!Op.Base)
+          // Register (or register class) token
+          if (!HasBase)
           {
-            Op.Base = R;
+            Op.Base = *Registers;
+            HasBase = true;
           }
           else
           {
-            Op.Index = R;
+            Op.Index = *Registers;
           }
         }
         else
         {
-          // Signed displacement
-          // Tok cannot be "?" here (we skipped it), so safe to parse
-          int64_t Val = std::stoll(Tok, nullptr, 0);
+          // Signed displacement or displacement range (Min..Max),
+          // a '-' sign negates the whole range.
+          auto Range = Tok.find("..");
+          auto Min = ParseSigned(Tok.substr(0, Range));
+          auto Max = (Range == std::string::npos) ? Min : ParseSigned(Tok.substr(Range + 2));
 
-          if (TokSign == '-')
+          if (!Min || !Max || *Min > *Max)
           {
-            Val = -Val;
+            return std::nullopt;
           }
 
-          if (Op.Disp)
+          if (TokSign == '-')
           {
-            Op.Disp = *Op.Disp + Val;
+            std::swap(Min, Max);
+            Min = -*Min;
+            Max = -*Max;
           }
-          else
+
+          if (!HasDisp)
           {
-            Op.Disp = Val;
+            Op.DispMin = 0;
+            Op.DispMax = 0;
+            HasDisp = true;
           }
+
+          Op.DispMin += *Min;
+          Op.DispMax += *Max;
+        }
+      }
+
+      return Op;
+    }
+
+    std::optional<ParsedOperand> ParseOperand(const std::string& OperandString)
+    {
+      static const std::unordered_map<std::string, std::uint16_t> SizeMap =
+      {
+        { "BYTE", 8 }, { "WORD", 16 }, { "DWORD", 32 }, { "QWORD", 64 }, { "TWORD", 80 },
+        { "XMMWORD", 128 }, { "YMMWORD", 256 }, { "ZMMWORD", 512 }
+      };
+
+      std::string T = Util::String::Trim(OperandString);
+      std::uint16_t Size = 0;
+
+      if (T.empty())
+      {
+        return std::nullopt;
+      }
+
+      // Optional operand size (e.g. "dword ptr [rax]", "byte ?")
+      auto SpacePos = T.find(' ');
+
+      auto It = (SpacePos != std::string::npos) ? SizeMap.find(Util::String::ToUpper(T.substr(0, SpacePos))) : SizeMap.end();
+
+      if (It != SizeMap.end())
+      {
+        Size = It->second;
+        T = Util::String::Trim(T.substr(SpacePos + 1));
+
+        if (Util::String::ToUpper(T.substr(0, 4)) == "PTR ")
+        {
+          T = Util::String::Trim(T.substr(4));
         }
       }
 
+      std::optional<ParsedOperand> Op;
+
+      if (T == "?")
+      {
+        // Wildcard operand
+        Op = ParsedOperand{};
+      }
+      else if (T.front() == '$')
+      {
+        // Same register as operand N
+        auto Other = ParseUnsigned(T.substr(1));
+
+        if (Other && *Other < ParsedOperand::NoOperand)
+        {
+          Op = ParsedOperand{};
+          Op->Types = 1 << ZYDIS_OPERAND_TYPE_REGISTER;
+          Op->SameAs = static_cast<std::uint8_t>(*Other);
+        }
+      }
+      else if (T.front() == '[' && T.back() == ']')
+      {
+        // Memory operand (may itself contain '?' inside)
+        Op = ParseMemoryOperand(T);
+      }
+      else if (auto Registers = ParseRegisterSet(T))
+      {
+        // Register (or register class) operand
+        Op = ParsedOperand{};
+        Op->Types = 1 << ZYDIS_OPERAND_TYPE_REGISTER;
+        Op->Registers = *Registers;
+      }
+      else
+      {
+        Op = ParseImmediateOperand(T);
+      }
+
+      if (Op)
+      {
+        Op->Size = Size;
+      }
+
       return Op;
     }
 
@@ -245,49 +505,66 @@ namespace COF
       // Parse each operand (allow '?' as wildcard)
       for (auto& Raw : Parts)
       {
-        std::string T = Util::String::Trim(Raw);
-        std::optional<ParsedOperand> OutOp;
+        auto Op = ParseOperand(Raw);
 
-        if (T == "?")
+        if (!Op)
         {
-          // Wildcard operand OutOp stays empty
+          // Malformed operand
+          return std::nullopt;
         }
-        else if (T.front() == '[' && T.back() == ']')
-        {
-          // Memory operand (may itself contain '?' inside)
-          auto MemOp = ParseMemoryOperand(T);
 
-          if (MemOp)
-          {
-            ParsedOperand P;
-            P.Mem = *MemOp;
-            OutOp = P;
-          }
-          else
-          {
-            // Malformed memory, treat as wildcard
-          }
-        }
-        else if (IsRegister(T))
-        {
-          // Register operand
-          ParsedOperand P;
-          P.Reg = *ParseRegister(T);
-          OutOp = P;
-        }
-        else
+        Instr.Operands.push_back(*Op);
+      }
+
+      // "$N" must refer to another operand of this instruction
+      for (std::size_t I = 0; I < Instr.Operands.size(); ++I)
+      {
+        auto SameAs = Instr.Operands[I].SameAs;
+
+        if (SameAs != ParsedOperand::NoOperand && (SameAs >= Instr.Operands.size() || SameAs == I))
         {
-          // Immediate operand
-          // (T != "?" here, so safe to parse)
-          ParsedOperand P;
-          P.Imm = std::stoull(T, nullptr, 0);
-          OutOp = P;
+          return std::nullopt;
         }
-
-        Instr.Operands.push_back(OutOp);
       }
 
       return Instr;
     }
+
+    std::optional<std::size_t> ParseGap(const std::string& GapString)
+    {
+      std::string T = Util::String::Trim(GapString);
+
+      if (T.rfind("...", 0) != 0)
+      {
+        return std::nullopt;
+      }
+
+      if (T.size() == 3)
+      {
+        return ParsedInstruction::AnyGap;
+      }
+
+      // "...{N}"
+      if (T.size() < 6 || T[3] != '{' || T.back() != '}')
+      {
+        return std::nullopt;
+      }
+
+      std::string Count = T.substr(4, T.size() - 5);
+
+      if (!std::all_of(Count.begin(), Count.end(), [](unsigned char C) { return std::isdigit(C); }))
+      {
+        return std::nullopt;
+      }
+
+      try
+      {
+        return static_cast<std::size_t>(std::stoull(Count));
+      }
+      catch (const std::out_of_range&)
+      {
+        return ParsedInstruction::AnyGap;
+      }
+    }
   } // !namespace AssemblyParser
 } // !namespace COF
\ No newline at end of file
@@ -8,21 +8,39 @@
 #include <string>
 #include <vector>
 #include <optional>
+#include <cstddef>
 
 namespace COF
 {
   namespace AssemblyParser
   {
     // Semantic aliases
-    using MemoryOperand = DumpAnalyzer::MemoryOperand;
+    using RegisterSet = DumpAnalyzer::RegisterSet;
     using ParsedOperand = DumpAnalyzer::MatchOperand;
     using ParsedInstruction = DumpAnalyzer::MatchInstruction;
 
     std::optional<ZydisMnemonic> ParseMnemonic(const std::string& MnemonicString);
     std::optional<ZydisRegister> ParseRegister(const std::string& RegisterString);
+
+    // Register name, register class (gpr, gpr8/16/32/64, x87, mmx, xmm, ymm, zmm, seg, mask) or '?'
+    std::optional<RegisterSet> ParseRegisterSet(const std::string& RegisterSetString);
     bool IsRegister(const std::string& PotentialRegister);
-    std::optional<MemoryOperand> ParseMemoryOperand(const std::string& MemoryOperandString);
+
+    // "imm" (any), exact value, "Min..Max" or hex with nibble wild cards (e.g. "0x1??0")
+    std::optional<ParsedOperand> ParseImmediateOperand(const std::string& ImmediateOperandString);
+
+    // [Base+Index*Scale+Disp], every part may be '?', registers may be classes and Disp a "Min..Max" range
+    std::optional<ParsedOperand> ParseMemoryOperand(const std::string& MemoryOperandString);
+
+    // Any of the above, "$N" (same register as operand N) or '?', optionally prefixed with
+    // an operand size (byte, word, dword, qword, tword, xmmword, ymmword, zmmword and an optional "ptr").
+    std::optional<ParsedOperand> ParseOperand(const std::string& OperandString);
+
     std::optional<ParsedInstruction> ParseInstruction(const std::string& InstructionString);
+
+    // Gap markers between instructions: "..." skips any number of instructions, "...{N}" at most N.
+    // nullopt if the string isn't a gap marker.
+    std::optional<std::size_t> ParseGap(const std::string& GapString);
   } // !namespace AssemblyParser
 } // !namespace COF
 
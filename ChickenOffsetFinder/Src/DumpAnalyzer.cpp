@@ -1,5 +1,9 @@
 ﻿#include "DumpAnalyzer.h"
 #include "Util.h"
+#include "AhoCorasick.h"
+#include "PatternScanner.h"
+#include "AnalysisIndex.h"
+#include "LengthDecoder.h"
 
 #include <Windows.h>
 #include <winver.h>
@@ -15,6 +19,7 @@
 #include <vector>
 #include <optional>
 #include <cstdint>
+#include <cstring>
 #include <cstdio>
 
 // TODO: Get version details from dump (from PE header maybe?)
@@ -32,7 +37,6 @@ namespace COF
   using PeSection = DumpAnalyzer::PeSection;
   using PeSections = DumpAnalyzer::PeSections;
   using StringType = DumpAnalyzer::StringType;
-  using PatternElem = DumpAnalyzer::PatternElem;
 
   PeSection::PeSection(const std::string& Name, std::uint64_t Offset, std::uint64_t Size)
     : Name(Name), Offset(Offset), Size(Size)
@@ -91,50 +95,188 @@ namespace COF
     this->BaseAddress = Base.BaseAddress;
   }
 
-  std::optional<std::uint64_t> DumpAnalyzer::TranslateVirtualOffsetToFileOffset(std::uint64_t VirtualOffset) const
+  std::uint64_t DumpAnalyzer::GetFileSize() const
   {
-    std::uint64_t VirtualAddress = this->InMetadata.BaseAddress + VirtualOffset;
-    std::uint64_t DumpSectionOffset = this->InMetadata.DumpSectionOffset;
-    std::uint64_t FileOffset = DumpSectionOffset;
+    if (this->InMapping)
+    {
+      return this->InMapping->GetSize();
+    }
+
+    std::lock_guard<std::mutex> Lock(this->InFileMutex);
+    this->InFile.clear();
+    this->InFile.seekg(0, std::ios::end);
+    return static_cast<std::uint64_t>(this->InFile.tellg());
+  }
+
+  // Precomputes where each region lives in the dump file and sorts them by address.
+  // Regions are dumped back to back in the order they were enumerated,
+  // so the file offset of a region is the sum of the sizes of all regions before it.
+  void DumpAnalyzer::BuildRegionMappings()
+  {
+    std::uint64_t FileOffset = this->InMetadata.DumpSectionOffset;
+
+    this->InRegionMappings.clear();
+    this->InRegionMappings.reserve(this->InMemoryRegions.size());
 
     for (const auto& Region : this->InMemoryRegions)
     {
-      std::size_t RegionSize = (Region.AddressEnd + 1) - Region.AddressBegin;
+      std::uint64_t AddressEnd = Region.AddressEnd + 1;
+      this->InRegionMappings.push_back({ Region.AddressBegin, AddressEnd, FileOffset });
+      FileOffset += AddressEnd - Region.AddressBegin;
+    }
 
-      if (VirtualAddress >= Region.AddressBegin && VirtualAddress <= Region.AddressEnd)
-      {
-        std::uint64_t RegionOffset = VirtualAddress - Region.AddressBegin;
-        FileOffset += RegionOffset;
-        return FileOffset;
-      }
+    std::sort(this->InRegionMappings.begin(), this->InRegionMappings.end(),
+      [](const RegionMapping& A, const RegionMapping& B)
+    {
+      return A.AddressBegin < B.AddressBegin;
+    });
+  }
+
+  const DumpAnalyzer::RegionMapping* DumpAnalyzer::FindRegionMapping(std::uint64_t VirtualAddress) const
+  {
+    const auto& Mappings = this->InRegionMappings;
+
+    // First region beginning after the address, the one before it is our candidate
+    auto It = std::upper_bound(Mappings.begin(), Mappings.end(), VirtualAddress,
+      [](std::uint64_t Address, const RegionMapping& Mapping)
+    {
+      return Address < Mapping.AddressBegin;
+    });
 
-      FileOffset += RegionSize;
+    if (It == Mappings.begin())
+    {
+      return nullptr;
     }
 
-    return std::nullopt;
+    const RegionMapping& Mapping = *std::prev(It);
+
+    if (VirtualAddress >= Mapping.AddressEnd)
+    {
+      // Address falls into a gap between regions (not dumped)
+      return nullptr;
+    }
+
+    return &Mapping;
+  }
+
+  std::optional<std::uint64_t> DumpAnalyzer::TranslateVirtualOffsetToFileOffset(std::uint64_t VirtualOffset) const
+  {
+    std::uint64_t VirtualAddress = this->InMetadata.BaseAddress + VirtualOffset;
+    const RegionMapping* Mapping = this->FindRegionMapping(VirtualAddress);
+
+    if (!Mapping)
+    {
+      return std::nullopt;
+    }
+
+    return Mapping->FileOffset + (VirtualAddress - Mapping->AddressBegin);
   }
 
-  std::vector<std::uint8_t> DumpAnalyzer::_Read(std::uint64_t Offset, std::size_t Size) const
+  DumpAnalyzer::View DumpAnalyzer::_Read(std::uint64_t Offset, std::size_t Size) const
   {
+    // Fast path, point straight into the mapped dump
+    if (this->InMapping)
+    {
+      std::uint64_t FileSize = this->InMapping->GetSize();
+
+      if (Offset >= FileSize)
+      {
+        return {};
+      }
+
+      std::size_t Available = static_cast<std::size_t>(FileSize - Offset);
+      return { this->InMapping->GetData() + Offset, (std::min)(Size, Available) };
+    }
+
+    // Fallback, buffered read through the file stream.
+    // Seek and read share the stream position, so reads from different threads are serialized.
     std::vector<std::uint8_t> Buffer(Size);
+    std::lock_guard<std::mutex> Lock(this->InFileMutex);
     this->InFile.clear();
     this->InFile.seekg(Offset, std::ios::beg);
     this->InFile.read(reinterpret_cast<char*>(Buffer.data()), Size);
-    return Buffer;
+    Buffer.resize(static_cast<std::size_t>(this->InFile.gcount()));
+    return View(std::move(Buffer));
   }
 
-  std::vector<std::uint8_t> DumpAnalyzer::Read(std::uint64_t Offset, std::size_t Size) const
+  DumpAnalyzer::View DumpAnalyzer::Read(std::uint64_t Offset, std::size_t Size) const
   {
     if (this->AnalysisMode == Mode::Regions)
     {
-      auto FileOffset = this->TranslateVirtualOffsetToFileOffset(Offset);
+      std::uint64_t VirtualAddress = this->InMetadata.BaseAddress + Offset;
+      const RegionMapping* Mapping = this->FindRegionMapping(VirtualAddress);
+
+      if (!Mapping)
+      {
+        return {};
+      }
+
+      std::uint64_t RegionOffset = VirtualAddress - Mapping->AddressBegin;
+      std::uint64_t FileOffset = Mapping->FileOffset + RegionOffset;
+      std::uint64_t Available = Mapping->AddressEnd - VirtualAddress;
+
+      if (Size <= Available)
+      {
+        // Common case, read lies within a single region
+        return this->_Read(FileOffset, Size);
+      }
+
+      // Read straddles the region end. Collect the (file) pieces of all
+      // virtually adjacent regions it covers, stopping at the first gap
+      // since memory in between regions was never dumped.
+      std::vector<std::pair<std::uint64_t, std::size_t>> Pieces;
+      Pieces.push_back({ FileOffset, static_cast<std::size_t>(Available) });
+
+      std::size_t Remaining = Size - static_cast<std::size_t>(Available);
+      bool IsFileContiguous = true;
+
+      for (const RegionMapping* Next = Mapping + 1;
+        Remaining > 0 && Next != this->InRegionMappings.data() + this->InRegionMappings.size();
+        ++Next)
+      {
+        const RegionMapping* Previous = Next - 1;
+
+        if (Next->AddressBegin != Previous->AddressEnd)
+        {
+          break;
+        }
+
+        std::size_t PieceSize = static_cast<std::size_t>(
+          (std::min)(static_cast<std::uint64_t>(Remaining), Next->AddressEnd - Next->AddressBegin));
+
+        if (Next->FileOffset != Previous->FileOffset + (Previous->AddressEnd - Previous->AddressBegin))
+        {
+          IsFileContiguous = false;
+        }
 
-      if (FileOffset)
+        Pieces.push_back({ Next->FileOffset, PieceSize });
+        Remaining -= PieceSize;
+      }
+
+      std::size_t Covered = Size - Remaining;
+
+      if (IsFileContiguous)
+      {
+        // Adjacent regions were also dumped back to back, still zero-copy
+        return this->_Read(FileOffset, Covered);
+      }
+
+      // Stitch the pieces together
+      std::vector<std::uint8_t> Buffer;
+      Buffer.reserve(Covered);
+
+      for (const auto& [PieceOffset, PieceSize] : Pieces)
       {
-        return this->_Read(*FileOffset, Size);
+        auto Piece = this->_Read(PieceOffset, PieceSize);
+        Buffer.insert(Buffer.end(), Piece.begin(), Piece.end());
+
+        if (Piece.size() != PieceSize)
+        {
+          break; // Truncated dump
+        }
       }
 
-      return {};
+      return View(std::move(Buffer));
     }
     else if (this->AnalysisMode == Mode::Sparse)
     {
@@ -172,17 +314,38 @@ namespace COF
     const std::uint8_t* Base = SectionData.data();
     std::uint32_t DirOff = 0;
 
+    // The read may stop short of SectionSize (truncated dump or a gap between regions),
+    // so every offset is bound by what was actually read.
+    const std::uint64_t Available = SectionData.size();
+
+    auto Fits = [Available](std::uint64_t Offset, std::uint64_t Size)
+    {
+      return Offset <= Available && Size <= Available - Offset;
+    };
+
+    // false if the directory or its entries are out of bounds
     auto WalkDirectory = [&](std::uint32_t& OutCount, std::uint32_t& OutEntriesOff)
     {
+      if (!Fits(DirOff, sizeof(IMAGE_RESOURCE_DIRECTORY)))
+      {
+        return false;
+      }
+
       auto Dir = reinterpret_cast<const IMAGE_RESOURCE_DIRECTORY*>(Base + DirOff);
       OutCount = Dir->NumberOfNamedEntries + Dir->NumberOfIdEntries;
       OutEntriesOff = DirOff + sizeof(IMAGE_RESOURCE_DIRECTORY);
+
+      return Fits(OutEntriesOff, static_cast<std::uint64_t>(OutCount) * sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY));
     };
 
     // Level 1: find RT_VERSION (16)
     {
       std::uint32_t Count, EntriesOff;
-      WalkDirectory(Count, EntriesOff);
+
+      if (!WalkDirectory(Count, EntriesOff))
+      {
+        return std::nullopt;
+      }
 
       bool Found = false;
       constexpr std::uint16_t RtVersionId = 16;
@@ -209,7 +372,11 @@ namespace COF
     // Level 2: find Name=1
     {
       std::uint32_t Count, EntriesOff;
-      WalkDirectory(Count, EntriesOff);
+
+      if (!WalkDirectory(Count, EntriesOff))
+      {
+        return std::nullopt;
+      }
 
       bool Found = false;
       constexpr std::uint16_t NameId = 1;
@@ -237,9 +404,8 @@ namespace COF
     std::uint32_t DataEntryOff;
     {
       std::uint32_t Count, EntriesOff;
-      WalkDirectory(Count, EntriesOff);
 
-      if (Count == 0)
+      if (!WalkDirectory(Count, EntriesOff) || Count == 0)
       {
         return std::nullopt;
       }
@@ -255,7 +421,7 @@ namespace COF
     }
 
     // Read IMAGE_RESOURCE_DATA_ENTRY
-    if (DataEntryOff + sizeof(IMAGE_RESOURCE_DATA_ENTRY) > SectionSize)
+    if (!Fits(DataEntryOff, sizeof(IMAGE_RESOURCE_DATA_ENTRY)))
     {
       return std::nullopt;
     }
@@ -271,7 +437,7 @@ namespace COF
 
     std::uint32_t DataOffset = DataBase - static_cast<std::uint32_t>(SectionBase);
 
-    if (DataOffset + DataSize > SectionSize)
+    if (!Fits(DataOffset, DataSize))
     {
       return std::nullopt;
     }
@@ -348,11 +514,10 @@ namespace COF
     {
       this->InPeHeader = std::nullopt;
       this->InPeSections = std::nullopt;
+      this->InExceptionDirectory = std::nullopt;
     };
 
-    this->InFile.clear();
-    this->InFile.seekg(0, std::ios::end);
-    const std::uint64_t FileSize = static_cast<std::uint64_t>(this->InFile.tellg());
+    const std::uint64_t FileSize = this->GetFileSize();
 
     // Validate DOS header
     if (FileSize < sizeof(IMAGE_DOS_HEADER))
@@ -389,7 +554,27 @@ namespace COF
       return SetNullopt();
     }
 
-    // Skip reading OptionalHeader entirely
+    // Only the exception directory is of interest in the OptionalHeader (for function extents)
+    const std::uint64_t OptionalHeaderOffset = PeOffset + sizeof(uint32_t) + sizeof(IMAGE_FILE_HEADER);
+
+    if (FileHeader.SizeOfOptionalHeader >= sizeof(IMAGE_OPTIONAL_HEADER64))
+    {
+      IMAGE_OPTIONAL_HEADER64 OptionalHeader = this->Read<IMAGE_OPTIONAL_HEADER64>(OptionalHeaderOffset);
+
+      if (OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC &&
+        OptionalHeader.NumberOfRvaAndSizes > IMAGE_DIRECTORY_ENTRY_EXCEPTION)
+      {
+        const IMAGE_DATA_DIRECTORY& Directory = OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXCEPTION];
+
+        if (Directory.VirtualAddress && Directory.Size)
+        {
+          this->InExceptionDirectory = PeSection(".exception",
+            static_cast<std::uint64_t>(Directory.VirtualAddress),
+            static_cast<std::uint64_t>(Directory.Size));
+        }
+      }
+    }
+
     const std::uint64_t SectionTableOffset = PeOffset + sizeof(uint32_t) + sizeof(IMAGE_FILE_HEADER) + FileHeader.SizeOfOptionalHeader;
     const std::uint64_t ExpectedSectionTableSize = static_cast<std::uint64_t>(FileHeader.NumberOfSections) * sizeof(IMAGE_SECTION_HEADER);
 
@@ -431,7 +616,14 @@ namespace COF
   }
 
   // Enumerate instructions in the .text section to find direct call targets.
-  void DumpAnalyzer::ExtractAndSaveFunctions()
+  // The linear sweep is split into chunks decoded in parallel (when a thread pool is available).
+  // Each chunk starts decoding a little before its begin, so its instruction boundaries have
+  // (almost always) converged with the ones of a serial sweep by the time it gets there.
+  // Chunks are then stitched in order: the serial sweep is followed into a chunk until it meets
+  // one of the chunk's boundaries, from there on the chunk's results are exactly the serial ones.
+  // If they don't meet early on, the chunk is swept again serially, so the table is always
+  // identical to the one of a single serial sweep.
+  void DumpAnalyzer::ExtractCallTargets(std::vector<Function>& Functions) const
   {
     if (!this->InPeSections)
     {
@@ -450,13 +642,35 @@ namespace COF
     std::uint64_t TextSectionEnd = TextSectionOffset + TextSectionSize;
 
     auto Buffer = this->Read(TextSectionOffset, TextSectionSize);
-    std::size_t BytesRead = this->InFile.gcount();
-    std::size_t Offset = 0;
-    ZydisDecoderContext Context;
+    std::size_t BytesRead = Buffer.size();
 
-    while (Offset < BytesRead)
+    // Decodes the instruction at Offset the way the serial sweep does (with the rest of .text available),
+    // returns where the sweep continues. CallTarget is set for calls into .text.
+    auto Step = [&](std::size_t Offset, std::optional<std::uint64_t>& CallTarget) -> std::size_t
     {
+      ZydisDecoderContext Context;
       ZydisDecodedInstruction Instruction;
+      CallTarget.reset();
+
+      // Most of .text only needs its length decoded, Zydis handles whatever the table decoder doesn't cover
+      if (auto Decoded = LengthDecoder::Decode(Buffer.data() + Offset, BytesRead - Offset))
+      {
+        if (Decoded->OpcodeClass == LengthDecoder::Class::CallRel32)
+        {
+          std::int32_t Relative = 0;
+          std::memcpy(&Relative, Buffer.data() + Offset + Decoded->BranchOffset, sizeof(Relative));
+
+          std::int64_t CallEnd = static_cast<std::int64_t>(TextSectionOffset + Offset + Decoded->Length);
+          std::uint64_t FunctionOffset = static_cast<std::uint64_t>(CallEnd + Relative);
+
+          if (FunctionOffset < TextSectionEnd)
+          {
+            CallTarget = FunctionOffset;
+          }
+        }
+
+        return Offset + Decoded->Length;
+      }
 
       ZyanStatus Status = ZydisDecoderDecodeInstruction(
         &this->Decoder,
@@ -468,8 +682,7 @@ namespace COF
 
       if (!ZYAN_SUCCESS(Status))
       {
-        Offset += 1;
-        continue;
+        return Offset + 1;
       }
 
       // Look for: call <imm>
@@ -496,365 +709,378 @@ namespace COF
             // Ignore any calls to outside of the .Text section.
             // This will ignore any valid function offsets in custom sections.
             // TODO: Allow custom sections too, but for now this is just fine.
-            if (FunctionOffset >= TextSectionEnd)
+            if (FunctionOffset < TextSectionEnd)
             {
-              Offset += Instruction.length;
-              continue;
+              CallTarget = FunctionOffset;
             }
-
-            this->InFunctionOffsets.insert(FunctionOffset);
           }
         }
       }
 
-      Offset += Instruction.length;
-    }
-  }
-
-  void DumpAnalyzer::ExtractAndSaveFileVersion()
-  {
-    this->InFileVersion = this->GetFileVersionInternal();
-  }
-
-  const std::vector<pmm::Region>& DumpAnalyzer::GetMemoryRegions() const
-  {
-    return this->InMemoryRegions;
-  }
-
-  const std::optional<std::string>& DumpAnalyzer::GetFileVersion() const
-  {
-    return this->InFileVersion;
-  }
+      return Offset + Instruction.length;
+    };
 
-  const std::optional<PeHeader>& DumpAnalyzer::GetPeHeader() const
-  {
-    return this->InPeHeader;
-  }
+    struct Chunk
+    {
+      std::size_t Begin = 0;
+      std::size_t End = 0;
+      std::vector<std::size_t> SyncPoints;                      // First instruction boundaries at or after Begin
+      std::vector<std::pair<std::size_t, std::uint64_t>> Calls; // Call instruction offset, call target
+      std::size_t Exit = 0;                                     // First boundary at or after End
+    };
 
-  const std::optional<PeSections>& DumpAnalyzer::GetPeSections() const
-  {
-    return this->InPeSections;
-  }
+    constexpr std::size_t MinChunkSize = 1 << 20;
+    constexpr std::size_t Overlap = 64;       // Boundaries converge within a few instructions
+    constexpr std::size_t MaxSyncPoints = 64;
 
-  const std::set<std::uint64_t>& DumpAnalyzer::GetFunctions() const
-  {
-    return this->InFunctionOffsets;
-  }
+    const std::size_t ThreadCount = this->InThreadPool ? this->InThreadPool->GetThreadCount() : 1;
+    const std::size_t ChunkSize = (std::max)(BytesRead / (ThreadCount * 4) + 1, MinChunkSize);
+    const std::size_t ChunkCount = (BytesRead + ChunkSize - 1) / ChunkSize;
+    std::vector<Chunk> Chunks(ChunkCount);
 
-  template<StringType T>
-  std::optional<DumpAnalyzer::Result<std::vector<std::uint64_t>>>
-    DumpAnalyzer::FindString(const std::string& Str, std::size_t MaxMatches) const
-  {
-    if (!this->InPeSections)
+    auto SweepChunk = [&](std::size_t Index)
     {
-      return std::nullopt;
-    }
+      Chunk& Current = Chunks[Index];
+      Current.Begin = Index * ChunkSize;
+      Current.End = (std::min)(Current.Begin + ChunkSize, BytesRead);
 
-    auto RdataSection = this->InPeSections->GetSection(".rdata");
-
-    if (!RdataSection)
-    {
-      return std::nullopt;
-    }
+      std::size_t Offset = Current.Begin - (std::min)(Current.Begin, Overlap);
+      std::optional<std::uint64_t> CallTarget;
 
-    Result<std::vector<std::uint64_t>> Out;
-    std::vector<std::uint64_t> Matches;
+      while (Offset < Current.End)
+      {
+        std::size_t Next = Step(Offset, CallTarget);
 
-    // Helper to not repeat code
-    auto SetSizeAndValue = [&Out](std::size_t Size,
-      const std::vector<std::uint64_t>& Value)
-    {
-      Out.Range.Size;
-      Out.Value = Value;
-    };
+        if (Offset >= Current.Begin)
+        {
+          if (Current.SyncPoints.size() < MaxSyncPoints)
+          {
+            Current.SyncPoints.push_back(Offset);
+          }
 
-    std::uint64_t RdataSectionOffset = RdataSection->GetOffset();
-    std::size_t RdataSectionSize = RdataSection->GetSize();
-    auto Buffer = this->Read(RdataSectionOffset, RdataSectionSize);
+          if (CallTarget)
+          {
+            Current.Calls.emplace_back(Offset, *CallTarget);
+          }
+        }
 
-    if (Buffer.empty())
-    {
-      return std::nullopt;
-    }
+        Offset = Next;
+      }
 
-    std::vector<std::uint8_t> Pattern;
+      Current.Exit = Offset;
+    };
 
-    if constexpr (T == StringType::ASCII)
+    if (this->InThreadPool && ChunkCount > 1)
     {
-      Pattern.assign(Str.begin(), Str.end());
+      this->InThreadPool->ParallelFor(ChunkCount, 1, [&SweepChunk](std::size_t Begin, std::size_t End)
+      {
+        for (std::size_t Index = Begin; Index < End; ++Index)
+        {
+          SweepChunk(Index);
+        }
+      });
     }
-    else if constexpr (T == StringType::UTF16_LE)
+    else
     {
-      for (char C : Str)
+      for (std::size_t Index = 0; Index < ChunkCount; ++Index)
       {
-        Pattern.push_back(static_cast<std::uint8_t>(C));
-        Pattern.push_back(0x00);
+        SweepChunk(Index);
       }
     }
 
-    const std::size_t PatternSize = Pattern.size();
-    bool FirstMatch = true;
+    std::size_t Offset = 0;
+    std::optional<std::uint64_t> CallTarget;
 
-    for (std::size_t I = 0; I + PatternSize <= Buffer.size(); I++)
+    for (const Chunk& Current : Chunks)
     {
-      bool Match = true;
+      const auto& SyncPoints = Current.SyncPoints;
+
+      auto IsSyncPoint = [&SyncPoints](std::size_t Offset)
+      {
+        return std::binary_search(SyncPoints.begin(), SyncPoints.end(), Offset);
+      };
 
-      for (std::size_t J = 0; J < PatternSize; ++J)
+      // Follow the serial sweep into the chunk until it meets the chunk's sweep
+      while (Offset < Current.End && !IsSyncPoint(Offset) && !SyncPoints.empty() && Offset < SyncPoints.back())
       {
-        if (Buffer[I + J] != Pattern[J])
+        Offset = Step(Offset, CallTarget);
+
+        if (CallTarget)
         {
-          Match = false;
-          break;
+          Functions.push_back({ *CallTarget, 0, Function::CallTarget });
         }
       }
 
-      if (Match)
+      if (Offset < Current.End && IsSyncPoint(Offset))
       {
-        std::uint64_t MatchOffset = RdataSectionOffset + I;
-        Matches.push_back(MatchOffset);
-
-        if (FirstMatch)
+        for (const auto& [CallOffset, Target] : Current.Calls)
         {
-          Out.Range.Offset = MatchOffset;
-          FirstMatch = false;
+          if (CallOffset >= Offset)
+          {
+            Functions.push_back({ Target, 0, Function::CallTarget });
+          }
         }
 
-        // Maximum amount of matches reached, return matches
-        if (Matches.size() >= MaxMatches)
+        Offset = Current.Exit;
+        continue;
+      }
+
+      // Didn't converge, finish the chunk serially
+      while (Offset < Current.End)
+      {
+        Offset = Step(Offset, CallTarget);
+
+        if (CallTarget)
         {
-          SetSizeAndValue((MatchOffset + PatternSize) - Out.Range.Offset, Matches);
-          return Out;
+          Functions.push_back({ *CallTarget, 0, Function::CallTarget });
         }
       }
     }
+  }
 
-    // Some matches found, return them
-    if (!Matches.empty())
+  // Walks the RUNTIME_FUNCTION table of the exception directory (.pdata).
+  // Gives exact extents for every function with unwind info, including the ones
+  // never called directly (virtual functions, callbacks etc.) which the call sweep misses.
+  void DumpAnalyzer::ExtractRuntimeFunctions(std::vector<Function>& Functions) const
+  {
+    if (!this->InExceptionDirectory)
     {
-      auto LastOffset = Matches.back();
-      SetSizeAndValue((LastOffset + PatternSize) - Out.Range.Offset, Matches);
-      return Out;
+      return;
     }
 
-    // No matches found
-    return std::nullopt;
-  }
+    auto Table = this->Read(this->InExceptionDirectory->GetOffset(), this->InExceptionDirectory->GetSize());
+    std::size_t Count = Table.size() / sizeof(RUNTIME_FUNCTION);
 
-  std::vector<PatternElem>
-    DumpAnalyzer::ParsePattern(const std::string& PatternStr) const
-  {
-    std::vector<PatternElem> Pattern;
-    std::istringstream Stream(PatternStr);
-    std::string Token;
+    auto ReadEntry = [&Table](std::size_t Index)
+    {
+      RUNTIME_FUNCTION Entry;
+      std::memcpy(&Entry, Table.data() + Index * sizeof(RUNTIME_FUNCTION), sizeof(Entry));
+      return Entry;
+    };
 
-    // Helper to build mask/value for one hex digit at bit‐shift Shift
-    auto MakeNibble = [&](char Char, int Shift) -> std::pair<std::uint8_t, std::uint8_t>
+    // Follows chained unwind info back to the entry of the function owning it.
+    // Chained entries describe separated parts of a function (e.g. shrink-wrapped epilogues),
+    // so they're not function starts on their own.
+    auto FindPrimaryEntry = [this](RUNTIME_FUNCTION Entry)
     {
-      if (Char == '?')
+      // Guard against malformed (cyclic) chains
+      for (int Depth = 0; Depth < 32; ++Depth)
       {
-        return { 0x0, 0x0 };
+        std::uint64_t ParentOffset = 0;
+
+        if (Entry.UnwindData & 1)
+        {
+          // Indirect, unwind data points straight at the parent entry
+          ParentOffset = Entry.UnwindData & ~1u;
+        }
+        else
+        {
+          // UNWIND_INFO: Version:3 Flags:5, SizeOfProlog, CountOfCodes, Frame, UnwindCode[CountOfCodes]
+          std::uint8_t VersionAndFlags = this->Read<std::uint8_t>(Entry.UnwindData);
+          std::uint8_t CountOfCodes = this->Read<std::uint8_t>(Entry.UnwindData + 2);
+
+          if (!((VersionAndFlags >> 3) & UNW_FLAG_CHAININFO))
+          {
+            break;
+          }
+
+          // Parent RUNTIME_FUNCTION follows the (even-padded) unwind codes
+          ParentOffset = Entry.UnwindData + 4 + ((CountOfCodes + 1) & ~1) * sizeof(std::uint16_t);
+        }
+
+        RUNTIME_FUNCTION Parent = this->Read<RUNTIME_FUNCTION>(ParentOffset);
+
+        if (!Parent.BeginAddress || Parent.EndAddress <= Parent.BeginAddress)
+        {
+          break;
+        }
+
+        Entry = Parent;
       }
 
-      std::uint8_t NibbleValue = static_cast<std::uint8_t>(
-        std::stoul(std::string(1, Char), nullptr, 16)
-        );
+      return Entry;
+    };
 
-      return {
-        static_cast<std::uint8_t>(0xF << Shift),
-        static_cast<std::uint8_t>(NibbleValue << Shift)
-      };
+    struct Fragment
+    {
+      std::uint64_t Begin = 0;
+      std::uint64_t End = 0;
+      std::uint64_t Primary = 0;
     };
 
-    while (Stream >> Token)
+    std::vector<Fragment> Fragments;
+    std::unordered_map<std::uint64_t, std::uint64_t> FunctionEnds;
+
+    for (std::size_t I = 0; I < Count; ++I)
     {
-      PatternElem Elem{ 0x00, 0x00 };
+      RUNTIME_FUNCTION Entry = ReadEntry(I);
 
-      // Full‐byte wildcard
-      if (Token == "?" || Token == "??")
+      if (!Entry.BeginAddress || Entry.EndAddress <= Entry.BeginAddress)
       {
-        Elem = { 0x00, 0x00 };
+        continue;
       }
-      // Two‐character token, possibly with '?' nibble
-      else if (Token.size() == 2 &&
-        (isxdigit(Token[0]) || Token[0] == '?') &&
-        (isxdigit(Token[1]) || Token[1] == '?'))
+
+      RUNTIME_FUNCTION Primary = FindPrimaryEntry(Entry);
+
+      if (Primary.BeginAddress == Entry.BeginAddress)
       {
-        auto [MaskHigh, ValueHigh] = MakeNibble(Token[0], 4);
-        auto [MaskLow, ValueLow] = MakeNibble(Token[1], 0);
-        Elem.first = MaskHigh | MaskLow;
-        Elem.second = ValueHigh | ValueLow;
+        std::uint64_t& End = FunctionEnds[Entry.BeginAddress];
+        End = (std::max)(End, static_cast<std::uint64_t>(Entry.EndAddress));
       }
-      // Fixed byte
       else
       {
-        std::uint8_t ByteValue = static_cast<std::uint8_t>(
-          std::stoul(Token, nullptr, 16)
-          );
-        Elem = { 0xFF, ByteValue };
+        Fragments.push_back({ Entry.BeginAddress, Entry.EndAddress, Primary.BeginAddress });
       }
+    }
+
+    // Fragments directly continuing their function grow its extent,
+    // detached ones (cold code placed elsewhere) can't be expressed as one range and are left out.
+    std::sort(Fragments.begin(), Fragments.end(), [](const Fragment& A, const Fragment& B)
+    {
+      return A.Begin < B.Begin;
+    });
+
+    for (const Fragment& Part : Fragments)
+    {
+      auto It = FunctionEnds.find(Part.Primary);
 
-      Pattern.push_back(Elem);
+      if (It != FunctionEnds.end() && It->second == Part.Begin)
+      {
+        It->second = Part.End;
+      }
     }
 
-    return Pattern;
+    for (const auto& [Begin, End] : FunctionEnds)
+    {
+      Functions.push_back({ Begin, End, Function::RuntimeFunction });
+    }
   }
 
-  std::optional<uint64_t> DumpAnalyzer::FindPattern(const std::vector<std::uint8_t>& Buffer,
-    const std::vector<PatternElem>& Pattern) const
+  // Sorts and deduplicates the functions collected by the extraction passes,
+  // and gives every function without an exact extent the next function's begin as its end
+  // (or the end of its section, if it's the last one in there).
+  void DumpAnalyzer::BuildFunctionTable(std::vector<Function>& Functions) const
   {
-    if (Buffer.size() < Pattern.size())
+    std::sort(Functions.begin(), Functions.end(), [](const Function& A, const Function& B)
     {
-      return std::nullopt;
-    }
+      return A.Begin < B.Begin;
+    });
 
-    for (std::size_t Index = 0; Index <= Buffer.size() - Pattern.size(); ++Index)
-    {
-      bool IsMatched = true;
+    // Merge duplicates (e.g. call targets that also have unwind info)
+    std::size_t Count = 0;
 
-      for (std::size_t PatternIndex = 0; PatternIndex < Pattern.size(); ++PatternIndex)
+    for (std::size_t I = 0; I < Functions.size(); ++I)
+    {
+      if (Count && Functions[Count - 1].Begin == Functions[I].Begin)
       {
-        auto [Mask, Value] = Pattern[PatternIndex];
-        std::uint8_t BufferByte = Buffer[Index + PatternIndex];
+        Function& Merged = Functions[Count - 1];
 
-        if ((BufferByte & Mask) != Value)
+        if (Functions[I].Flags & Function::RuntimeFunction)
         {
-          IsMatched = false;
-          break;
+          Merged.End = (std::max)(Merged.End, Functions[I].End);
         }
+
+        Merged.Flags |= Functions[I].Flags;
+        continue;
       }
 
-      if (IsMatched)
+      Functions[Count++] = Functions[I];
+    }
+
+    Functions.resize(Count);
+    Functions.shrink_to_fit();
+
+    for (std::size_t I = 0; I < Functions.size(); ++I)
+    {
+      Function& Current = Functions[I];
+
+      if (Current.HasExactEnd())
       {
-        return Index;
+        continue;
       }
-    }
 
-    return std::nullopt;
-  }
+      std::uint64_t End = (I + 1 < Functions.size())
+        ? Functions[I + 1].Begin
+        : UINT64_MAX;
 
-  std::optional<DumpAnalyzer::Result<>>
-    DumpAnalyzer::FindPattern(std::uint64_t StartOffset, std::size_t Size, const std::string& IdaPattern) const
-  {
-    // Patterns could be larger than specified Size,
-    // so make sure that Pattern is handled even if the
-    // specified Size is smaller than the size of the Pattern.
-    // TODO:
-    //  Remove this.
-    //  Its the users responsibility to make sure the size is valid.
-    auto ParsedPattern = ParsePattern(IdaPattern);
-    std::size_t PatternSize = ParsedPattern.size();
-
-    std::size_t BufferSize = (PatternSize > Size) ? PatternSize : Size;
-    auto Buffer = this->Read(StartOffset, BufferSize);
-
-    if (Buffer.empty())
-    {
-      return std::nullopt;
-    }
-
-    auto Parsed = ParsePattern(IdaPattern);
-    auto MatchOffset = FindPattern(Buffer, ParsedPattern);
+      if (this->InPeSections)
+      {
+        for (const auto& Section : this->InPeSections->GetAll())
+        {
+          std::uint64_t SectionEnd = Section.GetOffset() + Section.GetSize();
 
-    if (MatchOffset)
-    {
-      // Return offset & size of successfully matched pattern
-      return Result<>{
-        MatchRange{
-          StartOffset + *MatchOffset,
-          PatternSize
+          if (Current.Begin >= Section.GetOffset() && Current.Begin < SectionEnd)
+          {
+            End = (std::min)(End, SectionEnd);
+            break;
+          }
         }
-      };
-    }
-
-    return std::nullopt;
-  }
-
-  std::optional<DumpAnalyzer::Result<std::vector<DumpAnalyzer::MatchRange>>>
-    DumpAnalyzer::FindPatternSubsequence(std::uint64_t StartOffset, std::size_t Size,
-      const std::vector<std::string>& IdaPatterns) const
-  {
-    Result<std::vector<MatchRange>> Out;
-
-    // List of offset & size info of all patterns that matched
-    std::vector<MatchRange> MatchOffsets;
-
-    std::size_t PatternIndex = 0;
-    std::uint64_t NextOffset = StartOffset;
-    std::size_t NextSize = Size;
-
-    for (const auto& IdaPattern : IdaPatterns)
-    {
-      auto Pattern = this->FindPattern(NextOffset, NextSize, IdaPattern);
-
-      if (!Pattern)
-      {
-        // No match found
-        break;
       }
 
-      std::uint64_t PatternOffset = Pattern->Range.Offset;
-      std::size_t PatternSize = Pattern->Range.Size;
-      MatchOffsets.push_back({ PatternOffset, PatternSize });
-
-      // Start matching the next pattern at the next offset beyond
-      // the range of the current match.
-      NextOffset = PatternOffset + PatternSize;
-      NextSize = Size - (NextOffset - StartOffset);
-      ++PatternIndex;
-
-      if (PatternIndex == 1)
-      {
-        // Start offset of the pattern
-        Out.Range.Offset = PatternOffset;
-      }
-      
-      if (PatternIndex == IdaPatterns.size())
-      {
-        // Final pattern found, return pattern coverage range.
-        Out.Range.Size = (PatternOffset + PatternSize) - Out.Range.Offset;
-        Out.Value = MatchOffsets;
-        return Out;
-      }
+      Current.End = End;
     }
-
-    return std::nullopt;
   }
 
-  std::optional<DumpAnalyzer::Result<std::vector<DumpAnalyzer::MatchRange>>>
-    DumpAnalyzer::FindInstructionSequence(std::uint64_t StartOffset, std::size_t Size,
-      const std::vector<MatchInstruction>& Pattern) const
+  // Single sweep over the .text section recording every RIP-relative reference,
+  // so lookups for "who references X" don't have to re-decode the section each time.
+  // Data inside .text (jump tables, padding) can throw the sweep off instruction boundaries,
+  // so it restarts at the begin of every known function: runtime (.pdata) functions and
+  // call targets, the latter being the only record of leaf functions without unwind info.
+  std::vector<DumpAnalyzer::CrossReference> DumpAnalyzer::ExtractCrossReferences() const
   {
-    if (Pattern.empty())
+    std::vector<CrossReference> References;
+
+    if (!this->InPeSections)
     {
-      // Pattern cant be empty
-      return std::nullopt;
+      return References;
     }
 
-    // Read a chunk from the function start
-    auto Buffer = this->Read(StartOffset, Size);
+    auto TextSection = this->InPeSections->GetSection(".text");
 
-    if (Buffer.empty())
+    if (!TextSection)
     {
-      return std::nullopt;
+      return References;
     }
 
-    Result<std::vector<MatchRange>> Out;
-    std::vector<MatchRange> MatchOffsets;
-    std::size_t PatternIndex = 0;
+    std::uint64_t TextSectionOffset = TextSection->GetOffset();
+    auto Buffer = this->Read(TextSectionOffset, TextSection->GetSize());
     std::size_t Offset = 0;
     ZydisDecoderContext Context;
 
-    // Helper to reset sequence state
-    auto ResetMatcher = [&]()
+    // Relative to .text, ascending
+    std::vector<std::size_t> SyncOffsets;
+
+    for (const auto& Entry : this->GetFunctions())
     {
-      PatternIndex = 0;
-      MatchOffsets.clear();
-    };
+      if (Entry.Begin >= TextSectionOffset && Entry.Begin < TextSectionOffset + Buffer.size())
+      {
+        SyncOffsets.push_back(static_cast<std::size_t>(Entry.Begin - TextSectionOffset));
+      }
+    }
+
+    auto NextSync = SyncOffsets.begin();
 
     while (Offset < Buffer.size())
     {
+      // Reached (or decoded across) the next function begin, continue exactly there
+      if (NextSync != SyncOffsets.end() && Offset >= *NextSync)
+      {
+        Offset = *NextSync;
+        ++NextSync;
+      }
+
       ZydisDecodedInstruction Instruction;
 
+      // Skip non-relative instructions without a full decode, relative ones still go through
+      // Zydis below for their operands and mnemonic
+      auto Decoded = LengthDecoder::Decode(Buffer.data() + Offset, Buffer.size() - Offset);
+
+      if (Decoded && !Decoded->IsRelative())
+      {
+        Offset += Decoded->Length;
+        continue;
+      }
+
       if (!ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(
         &this->Decoder,
         &Context,
@@ -862,9 +1088,15 @@ namespace COF
         Buffer.size() - Offset,
         &Instruction)))
       {
-        // Decode failure, reset and advance by one byte
-        ++Offset;
-        ResetMatcher();
+        Offset += 1;
+        continue;
+      }
+
+      // Only instructions with RIP-relative memory operands or
+      // relative immediates are of interest, skip decoding operands otherwise.
+      if (!(Instruction.attributes & ZYDIS_ATTRIB_IS_RELATIVE))
+      {
+        Offset += Instruction.length;
         continue;
       }
 
@@ -875,672 +1107,1220 @@ namespace COF
         &Context,
         &Instruction,
         Operands,
-        Instruction.operand_count_visible)))
-      {
-        // Invalid operands, reset and skip instruction
-        Offset += Instruction.length;
-        ResetMatcher();
-        continue;
-      }
-
-      std::uint64_t InstructionOffset = StartOffset + Offset;
-      const MatchInstruction& MIInstruction = Pattern[PatternIndex];
-
-      // Mnemonic check (wildcard if nullopt)
-      if (MIInstruction.Mnemonic)
-      {
-        if (*MIInstruction.Mnemonic == ZYDIS_MNEMONIC_INVALID ||
-          *MIInstruction.Mnemonic != Instruction.mnemonic)
-        {
-          // Mismatch, reset and skip
-          Offset += Instruction.length;
-          ResetMatcher();
-          continue;
-        }
-      }
-
-      // Operand count check
-      if (Instruction.operand_count_visible != MIInstruction.Operands.size())
+        Instruction.operand_count)))
       {
         Offset += Instruction.length;
-        ResetMatcher();
         continue;
       }
 
-      // Per-operand checks
-      std::size_t OperandsMatched = 0;
+      std::uint64_t InstructionStart = TextSectionOffset + Offset;
+      std::int64_t InstructionEnd = static_cast<std::int64_t>(InstructionStart + Instruction.length);
 
-      for (std::size_t I = 0; I < Instruction.operand_count_visible; ++I)
+      // Only one operand can be RIP-relative
+      for (std::size_t I = 0; I < Instruction.operand_count; ++I)
       {
         const auto& Operand = Operands[I];
-        const auto& MIOperand = MIInstruction.Operands[I];
+        std::int64_t Relative = 0;
 
-        if (!MIOperand)
+        if (Operand.type == ZYDIS_OPERAND_TYPE_MEMORY &&
+          Operand.mem.base == ZYDIS_REGISTER_RIP &&
+          Operand.mem.disp.size > 0)
         {
-          ++OperandsMatched;
-          continue;
+          Relative = static_cast<std::int64_t>(Operand.mem.disp.value);
         }
-
-        if (Operand.type == ZYDIS_OPERAND_TYPE_REGISTER)
+        else if (Operand.type == ZYDIS_OPERAND_TYPE_IMMEDIATE &&
+          Operand.imm.is_relative)
         {
-          if (!MIOperand->Reg || MIOperand->Imm || MIOperand->Mem ||
-            Operand.reg.value != *MIOperand->Reg)
-          {
-            ResetMatcher();
-            break;
-          }
-
-          ++OperandsMatched;
+          Relative = static_cast<std::int64_t>(Operand.imm.value.s);
         }
-        else if (Operand.type == ZYDIS_OPERAND_TYPE_IMMEDIATE)
+        else
         {
-          if (!MIOperand->Imm || MIOperand->Reg || MIOperand->Mem)
-          {
-            ResetMatcher();
-            break;
-          }
-          
-          bool ImmediateMatch = false;
-
-          if (Operand.imm.is_signed)
-          {
-            if (Operand.imm.size == sizeof(std::uint8_t) * CHAR_BIT) // 8-bits
-            {
-              ImmediateMatch = (static_cast<std::uint8_t>(Operand.imm.value.u) == *MIOperand->Imm);
-            }
-            else if (Operand.imm.size == sizeof(std::uint16_t) * CHAR_BIT) // 16-bits
-            {
-              ImmediateMatch = (static_cast<std::uint16_t>(Operand.imm.value.u) == *MIOperand->Imm);
-            }
-            else if (Operand.imm.size == sizeof(std::uint32_t) * CHAR_BIT) // 32-bits
-            {
-              ImmediateMatch = (static_cast<std::uint32_t>(Operand.imm.value.u) == *MIOperand->Imm);
-            }
-            else // 64-bits
-            {
-              ImmediateMatch = (static_cast<std::uint64_t>(Operand.imm.value.u) == *MIOperand->Imm);
-            }
-          }
-          else
-          {
-            ImmediateMatch = (Operand.imm.value.u == *MIOperand->Imm);
-          }
+          continue;
+        }
 
-          if (!ImmediateMatch)
-          {
-            ResetMatcher();
-            break;
-          }
+        References.push_back({
+          static_cast<std::uint64_t>(InstructionEnd + Relative),
+          InstructionStart,
+          Instruction.mnemonic,
+          Instruction.length
+        });
 
-          ++OperandsMatched;
-        }
-        else if (Operand.type == ZYDIS_OPERAND_TYPE_MEMORY)
-        {
-          if (!MIOperand->Mem || MIOperand->Reg || MIOperand->Imm)
-          {
-            ResetMatcher();
-            break;
-          }
+        break;
+      }
 
-          if (MIOperand->Mem->Base && Operand.mem.base != *MIOperand->Mem->Base)
-          {
-            ResetMatcher();
-            break;
-          }
+      Offset += Instruction.length;
+    }
 
-          if (MIOperand->Mem->Index && Operand.mem.index != *MIOperand->Mem->Index)
-          {
-            ResetMatcher();
-            break;
-          }
+    std::sort(References.begin(), References.end(),
+      [](const CrossReference& A, const CrossReference& B)
+    {
+      return (A.Target != B.Target) ? (A.Target < B.Target) : (A.Instruction < B.Instruction);
+    });
 
-          if (MIOperand->Mem->Scale && Operand.mem.scale != *MIOperand->Mem->Scale)
-          {
-            ResetMatcher();
-            break;
-          }
+    return References;
+  }
 
-          if (MIOperand->Mem->Disp && Operand.mem.disp.value != *MIOperand->Mem->Disp)
-          {
-            ResetMatcher();
-            break;
-          }
+  std::optional<std::string> DumpAnalyzer::ComputeFileVersion() const
+  {
+    std::optional<std::string> FileVersion;
 
-          ++OperandsMatched;
-        }
-      }
+    bool Loaded = this->LoadFromIndex(AnalysisIndex::Section::FileVersion, [&FileVersion](AnalysisIndex::Reader& In)
+    {
+      std::uint8_t HasFileVersion = 0;
+      std::string Version;
 
-      // If any operand failed to match
-      if (OperandsMatched != Instruction.operand_count_visible)
+      if (!In.Read(HasFileVersion) || (HasFileVersion && !In.ReadString(Version)))
       {
-        Offset += Instruction.length;
-        ResetMatcher();
-        continue;
+        return false;
       }
 
-      // Record the match and advance the sequence
-      MatchOffsets.push_back({ InstructionOffset, Instruction.length });
-      ++PatternIndex;
+      FileVersion = HasFileVersion ? std::optional<std::string>(std::move(Version)) : std::nullopt;
+      return true;
+    });
 
-      if (PatternIndex == 1)
-      {
-        Out.Range.Offset = InstructionOffset;
-      }
+    if (!Loaded)
+    {
+      FileVersion = this->GetFileVersionInternal();
+      this->MarkIndexDirty();
+    }
 
-      if (PatternIndex == Pattern.size())
-      {
-        Out.Range.Size = (InstructionOffset + Instruction.length) - Out.Range.Offset;
-        Out.Value = MatchOffsets;
-        return Out;
-      }
+    return FileVersion;
+  }
 
-      Offset += Instruction.length;
+  std::vector<DumpAnalyzer::Function> DumpAnalyzer::ComputeFunctions() const
+  {
+    std::vector<Function> Functions;
+
+    bool Loaded = this->LoadFromIndex(AnalysisIndex::Section::Functions, [&Functions](AnalysisIndex::Reader& In)
+    {
+      return In.ReadArray(Functions);
+    });
+
+    if (!Loaded)
+    {
+      Functions.clear();
+      this->ExtractCallTargets(Functions);
+      this->ExtractRuntimeFunctions(Functions);
+      this->BuildFunctionTable(Functions);
+      this->MarkIndexDirty();
     }
 
-    return std::nullopt;
+    return Functions;
   }
 
-  std::optional<DumpAnalyzer::Result<std::vector<DumpAnalyzer::MatchRange>>>
-    DumpAnalyzer::FindInstructionSubsequence(std::uint64_t StartOffset, std::size_t Size,
-      const std::vector<MatchInstruction>& Pattern) const
+  std::vector<DumpAnalyzer::CrossReference> DumpAnalyzer::ComputeCrossReferences() const
   {
-    if (Pattern.empty())
+    std::vector<CrossReference> References;
+
+    bool Loaded = this->LoadFromIndex(AnalysisIndex::Section::CrossReferences, [&References](AnalysisIndex::Reader& In)
     {
-      // Pattern cant be empty
-      return std::nullopt;
+      return In.ReadArray(References);
+    });
+
+    if (!Loaded)
+    {
+      References = this->ExtractCrossReferences();
+      this->MarkIndexDirty();
     }
 
-    // Read a chunk from the function start
-    auto Buffer = this->Read(StartOffset, Size);
+    return References;
+  }
 
-    if (Buffer.empty())
+  // Hashes everything the cached analysis stages read: the headers (incl. section table),
+  // .text (functions, cross references), the exception directory and .rdata (runtime functions, unwind info)
+  // and .rsrc (file version). Writable sections are left out, they differ between dumps of the same binary.
+  std::optional<std::uint64_t> DumpAnalyzer::ComputeContentHash() const
+  {
+    if (!this->InPeHeader || !this->InPeSections || !this->InPeSections->GetSection(".text"))
     {
       return std::nullopt;
     }
 
-    Result<std::vector<MatchRange>> Out;
-
-    // List of offset & size info of all pattern matched instructions
-    std::vector<MatchRange> MatchOffsets;
+    std::uint64_t Hash = AnalysisIndex::HashBytes(
+      reinterpret_cast<const std::uint8_t*>(&this->AnalysisMode), sizeof(this->AnalysisMode));
 
-    // Currently matched instruction index in subsequence
-    std::size_t PatternIndex = 0;
+    auto HashRange = [this, &Hash](std::uint64_t Offset, std::size_t Size)
+    {
+      auto Bytes = this->Read(Offset, Size);
+      Hash = AnalysisIndex::HashBytes(Bytes.data(), Bytes.size(), Hash);
+    };
 
-    std::size_t Offset = 0;
-    ZydisDecoderContext Context;
+    HashRange(this->InPeHeader->GetOffset(), this->InPeHeader->GetSize());
 
-    while (Offset < Buffer.size())
+    if (this->InExceptionDirectory)
     {
-      ZydisDecodedInstruction Instruction;
+      HashRange(this->InExceptionDirectory->GetOffset(), this->InExceptionDirectory->GetSize());
+    }
 
-      if (!ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(
-        &this->Decoder,
-        &Context,
-        Buffer.data() + Offset,
-        Buffer.size() - Offset,
-        &Instruction)))
+    for (const char* Name : { ".text", ".rdata", ".rsrc" })
+    {
+      if (auto Section = this->InPeSections->GetSection(Name))
       {
-        ++Offset;
-        continue;
+        HashRange(Section->GetOffset(), Section->GetSize());
       }
+    }
 
-      ZydisDecodedOperand Operands[ZYDIS_MAX_OPERAND_COUNT];
-
-      if (!ZYAN_SUCCESS(ZydisDecoderDecodeOperands(
-        &this->Decoder,
-        &Context,
-        &Instruction,
-        Operands,
-        Instruction.operand_count_visible)))
-      {
-        // Invalid Instruction?
-        Offset += Instruction.length;
-        continue;
-      }
+    return Hash;
+  }
 
-      std::uint64_t InstructionOffset = StartOffset + Offset;
-      const MatchInstruction& MIInstruction = Pattern[PatternIndex];
+  DumpAnalyzer::IndexFile& DumpAnalyzer::OpenIndex() const
+  {
+    IndexFile& Index = *this->InIndex;
 
-      // We only care about matching the mnemonic if
-      // our pattern mnemonic is not a wildcard.
-      if (MIInstruction.Mnemonic)
-      {
-        // If this condition is true, our pattern isnt a wildcad.
-        // We mus therefore check if our mnemonics
-        // match with the current instruction.
+    std::call_once(Index.Opened, [this, &Index]()
+    {
+      Index.ContentHash = this->ComputeContentHash();
 
-        if (*MIInstruction.Mnemonic == ZYDIS_MNEMONIC_INVALID ||
-          *MIInstruction.Mnemonic != Instruction.mnemonic)
-        {
-          // Mnemonic doesnt match
-          Offset += Instruction.length;
-          continue;
-        }
-      }
+      auto Mapping = std::make_unique<MappedFile>();
+      AnalysisIndex::Header Header;
 
-      if (Instruction.operand_count_visible != MIInstruction.Operands.size())
+      if (!Index.ContentHash || !Mapping->Open(AnalysisIndex::GetPath(this->InFilePath)))
       {
-        // Pattern size must match instruction size (operands)
-        Offset += Instruction.length;
-        continue;
+        return;
       }
 
-      std::size_t OperandsMatched = 0;
+      AnalysisIndex::Reader In(Mapping->GetData(), static_cast<std::size_t>(Mapping->GetSize()));
 
-      for (std::size_t I = 0; I < Instruction.operand_count_visible; ++I)
+      if (In.Read(Header) && Header.IsValid(*Index.ContentHash, Mapping->GetSize()))
       {
-        const auto& Operand = Operands[I];
-        auto& MIOperand = MIInstruction.Operands[I];
+        Index.Header = Header;
+        Index.Mapping = std::move(Mapping);
+      }
+    });
 
-        // Empty operand means we hit a wildcard.
-        // Operand is therefore a match no matter what.
-        if (!MIOperand)
-        {
-          ++OperandsMatched;
-          continue;
-        }
+    return Index;
+  }
 
-        if (Operand.type == ZYDIS_OPERAND_TYPE_REGISTER)
-        {
-          if (!MIOperand->Reg || MIOperand->Imm || MIOperand->Mem)
-          {
-            // Decoded operand is a register but pattern operand
-            // is not a register.
-            break;
-          }
+  void DumpAnalyzer::MarkIndexDirty() const
+  {
+    if (!this->IndexEnabled)
+    {
+      return;
+    }
 
-          if (Operand.reg.value != *MIOperand->Reg)
-          {
-            // Pattern operand doesnt match decoded operand
-            break;
-          }
+    IndexFile& Index = *this->InIndex;
+    std::lock_guard<std::mutex> Lock(Index.Mutex);
+    Index.Dirty = true;
+  }
 
-          // Reaching this point means that the registers match
-          ++OperandsMatched;
-        }
-        else if (Operand.type == ZYDIS_OPERAND_TYPE_IMMEDIATE)
-        {
-          if (!MIOperand->Imm || MIOperand->Reg || MIOperand->Mem)
-          {
-            // Decoded operand is an immediate value but pattern operand
-            // is not an immediate value.
-            break;
-          }
+  template <typename Loader>
+  bool DumpAnalyzer::LoadFromIndex(AnalysisIndex::Section Section, Loader&& Load) const
+  {
+    if (!this->IndexEnabled)
+    {
+      return false;
+    }
 
-          // Signed immediate values must be converted to unsigned
-          // because our MemoryOperand struct defines an unsigned 'Imm' field.
-          // The reason we do it this way is to handle jmp, jz, jnz etc.
-          // signed immediate displacements.
-          if (Operand.imm.is_signed)
-          {
-            if (Operand.imm.size == sizeof(std::uint8_t) * CHAR_BIT) // 8-bits
-            {
-              if (static_cast<std::uint8_t>(Operand.imm.value.u) != *MIOperand->Imm)
-              {
-                break;
-              }
-            }
-            else if (Operand.imm.size == sizeof(std::uint16_t) * CHAR_BIT) // 16-bits
-            {
-              if (static_cast<std::uint16_t>(Operand.imm.value.u) != *MIOperand->Imm)
-              {
-                break;
-              }
-            }
-            else if (Operand.imm.size == sizeof(std::uint32_t) * CHAR_BIT) // 32-bits
-            {
-              if (static_cast<std::uint32_t>(Operand.imm.value.u) != *MIOperand->Imm)
-              {
-                break;
-              }
-            }
-            // Redundant? Can signed immediates exist in 64-bit Intel ASM?
-            else if (Operand.imm.size == sizeof(std::uint64_t) * CHAR_BIT) // 64-bits
-            {
-              if (static_cast<std::uint64_t>(Operand.imm.value.u) != *MIOperand->Imm)
-              {
-                break;
-              }
-            }
-          }
-          else
-          {
-            // Unsigned immediates, no matter size can simply be compared,
-            // as we dont need to think about 2s complement conversions.
-            if (Operand.imm.value.u != *MIOperand->Imm)
-            {
-              // Pattern operand doesnt match decoded operand
-              break;
-            }
-          }
+    IndexFile& Index = this->OpenIndex();
+    std::lock_guard<std::mutex> Lock(Index.Mutex);
 
-          // Reaching this point means that the immediate values match
-          ++OperandsMatched;
-        }
-        else if (Operand.type == ZYDIS_OPERAND_TYPE_MEMORY)
-        {
-          if (!MIOperand->Mem || MIOperand->Reg || MIOperand->Imm)
-          {
-            // Decoded operand is a memory operand but pattern operand
-            // is not a memory operand.
-            break;
-          }
+    if (!Index.Header || !Index.Mapping)
+    {
+      return false;
+    }
 
-          // If none of these are true,
-          // treat entire operand as a matched wildcard and move to next.
+    const AnalysisIndex::SectionEntry& Entry = Index.Header->GetSection(Section);
 
-          if (MIOperand->Mem->Base)
-          {
-            if (Operand.mem.base != *MIOperand->Mem->Base)
-            {
-              break;
-            }
-          }
+    if (!Entry.Offset)
+    {
+      return false;
+    }
 
-          if (MIOperand->Mem->Index)
-          {
-            if (Operand.mem.index != *MIOperand->Mem->Index)
-            {
-              break;
-            }
-          }
+    AnalysisIndex::Reader In(Index.Mapping->GetData() + Entry.Offset, static_cast<std::size_t>(Entry.Size));
+    return Load(In) && In.Good();
+  }
 
-          if (MIOperand->Mem->Scale)
-          {
-            if (Operand.mem.scale != *MIOperand->Mem->Scale)
-            {
-              break;
-            }
-          }
+  bool DumpAnalyzer::SaveIndex()
+  {
+    if (!this->IndexEnabled)
+    {
+      return false;
+    }
 
-          if (MIOperand->Mem->Disp)
-          {
-            // Unlike for the immediate handler above,
-            // there is no need to check the size of the displacement
-            // or convert between signed and unsigned values
-            // because both Zydis' disp value and our Disp are signed.
-            if (Operand.mem.disp.value != *MIOperand->Mem->Disp)
-            {
-              break;
-            }
-          }
+    IndexFile& Index = *this->InIndex;
+    std::lock_guard<std::mutex> Lock(Index.Mutex);
 
-          // All effective address components in memory operand
-          // match, therefore our operand matches the pattern.
-          ++OperandsMatched;
+    if (!Index.Dirty || !Index.ContentHash)
+    {
+      return !Index.Dirty;
+    }
+
+    const std::string IndexPath = AnalysisIndex::GetPath(this->InFilePath);
+    AnalysisIndex::Writer Out(IndexPath);
+    AnalysisIndex::Header Header;
+
+    Header.Magic = AnalysisIndex::Magic;
+    Header.Version = AnalysisIndex::Version;
+    Header.HeaderSize = sizeof(AnalysisIndex::Header);
+    Header.ContentHash = *Index.ContentHash;
+    Out.Write(Header);
+
+    // Writes the artifact if it was computed (or loaded) in this run,
+    // otherwise carries its section over from the current index file.
+    auto WriteSection = [&](AnalysisIndex::Section Section, auto&& Save)
+    {
+      AnalysisIndex::SectionEntry& Entry = Header.GetSection(Section);
+      Entry.Offset = Out.Tell();
+
+      if (!Save())
+      {
+        if (!Index.Header || !Index.Mapping || !Index.Header->GetSection(Section).Offset)
+        {
+          Entry.Offset = 0;
+          return;
         }
+
+        const AnalysisIndex::SectionEntry& Current = Index.Header->GetSection(Section);
+        Out.WriteBytes(Index.Mapping->GetData() + Current.Offset, static_cast<std::size_t>(Current.Size));
       }
 
-      if (OperandsMatched != Instruction.operand_count_visible)
+      Entry.Size = Out.Tell() - Entry.Offset;
+    };
+
+    WriteSection(AnalysisIndex::Section::FileVersion, [this, &Out]()
+    {
+      const auto* FileVersion = this->InFileVersion.TryGet();
+
+      if (FileVersion)
       {
-        // Not all operands matched the pattern,
-        // welp move to the next instruction to try again
-        Offset += Instruction.length;
-        continue;
+        Out.Write<std::uint8_t>(*FileVersion ? 1 : 0);
+
+        if (*FileVersion)
+        {
+          Out.WriteString(**FileVersion);
+        }
       }
 
-      // For each subsequence match, save the offset & size
-      MatchOffsets.push_back({ InstructionOffset, Instruction.length });
-      ++PatternIndex;
+      return FileVersion != nullptr;
+    });
+
+    WriteSection(AnalysisIndex::Section::Functions, [this, &Out]()
+    {
+      const auto* Functions = this->InFunctions.TryGet();
 
-      if (PatternIndex == 1)
+      if (Functions)
       {
-        // Start offset of the pattern
-        Out.Range.Offset = InstructionOffset;
+        Out.WriteArray(*Functions);
       }
 
-      if (PatternIndex == Pattern.size())
+      return Functions != nullptr;
+    });
+
+    WriteSection(AnalysisIndex::Section::CrossReferences, [this, &Out]()
+    {
+      const auto* References = this->InCrossReferences.TryGet();
+
+      if (References)
       {
-        // Final pattern found, return pattern coverage range.
-        Out.Range.Size = (InstructionOffset + Instruction.length) - Out.Range.Offset;
-        Out.Value = MatchOffsets;
-        return Out;
+        Out.WriteArray(*References);
       }
 
-      Offset += Instruction.length;
+      return References != nullptr;
+    });
+
+    WriteSection(AnalysisIndex::Section::Instructions, [this, &Out]()
+    {
+      if (this->InInstructions)
+      {
+        this->InInstructions->Save(Out);
+      }
+
+      return this->InInstructions != nullptr;
+    });
+
+    Out.Seek(0);
+    Out.Write(Header);
+
+    if (!Out.Good())
+    {
+      return false;
     }
 
-    return std::nullopt;
+    // The file being replaced can't stay mapped while it's replaced
+    Index.Mapping.reset();
+
+    if (Out.Finish())
+    {
+      Index.Header = Header;
+      Index.Dirty = false;
+    }
+
+    // Keep the (new, or old if replacing failed) index mapped for artifacts that weren't needed yet
+    auto Mapping = std::make_unique<MappedFile>();
+
+    if (Index.Header && Mapping->Open(IndexPath))
+    {
+      Index.Mapping = std::move(Mapping);
+    }
+    else
+    {
+      Index.Header.reset();
+    }
+
+    return !Index.Dirty;
   }
 
-  // Resolves the RIP relative address of the first instruction
-  // it encounters that matches the conditions (i.e. RIP + DISP).
-  // InstructionSize should be large enough to hold the full instruction (e.g., 10–15 bytes for x64).
-  std::optional<DumpAnalyzer::Result<std::uint64_t>>
-    DumpAnalyzer::ResolveRipRelativeOffset(std::uint64_t StartOffset, std::size_t Size,
-    std::function<bool(ZydisDecodedInstruction*, ZydisDecodedOperand*)> Filter) const
+  void DumpAnalyzer::UseIndex(bool Enable)
   {
-    auto Buffer = this->Read(StartOffset, Size);
+    this->IndexEnabled = Enable;
+  }
+
+  void DumpAnalyzer::UseThreadPool(std::shared_ptr<ThreadPool> Pool)
+  {
+    this->InThreadPool = std::move(Pool);
+  }
+
+  DumpAnalyzer::ScanStatistics DumpAnalyzer::GetScanStatistics() const
+  {
+    ScanStatistics Statistics;
+    Statistics.Instructions = this->InScanCounters->Instructions.load(std::memory_order_relaxed);
+    Statistics.OperandDecodes = this->InScanCounters->OperandDecodes.load(std::memory_order_relaxed);
+    return Statistics;
+  }
+
+  const std::vector<pmm::Region>& DumpAnalyzer::GetMemoryRegions() const
+  {
+    return this->InMemoryRegions;
+  }
+
+  const std::optional<std::string>& DumpAnalyzer::GetFileVersion() const
+  {
+    return this->InFileVersion.Get([this]()
+    {
+      return this->ComputeFileVersion();
+    });
+  }
+
+  const std::optional<PeHeader>& DumpAnalyzer::GetPeHeader() const
+  {
+    return this->InPeHeader;
+  }
+
+  const std::optional<PeSections>& DumpAnalyzer::GetPeSections() const
+  {
+    return this->InPeSections;
+  }
+
+  std::size_t DumpAnalyzer::Function::GetSize() const
+  {
+    return static_cast<std::size_t>(this->End - this->Begin);
+  }
+
+  bool DumpAnalyzer::Function::HasExactEnd() const
+  {
+    return (this->Flags & RuntimeFunction) != 0;
+  }
+
+  bool DumpAnalyzer::Function::Contains(std::uint64_t Offset) const
+  {
+    return Offset >= this->Begin && Offset < this->End;
+  }
+
+  const std::vector<DumpAnalyzer::Function>& DumpAnalyzer::GetFunctions() const
+  {
+    return this->InFunctions.Get([this]()
+    {
+      return this->ComputeFunctions();
+    });
+  }
+
+  const DumpAnalyzer::Function* DumpAnalyzer::FindContainingFunction(std::uint64_t Offset) const
+  {
+    const auto& Functions = this->GetFunctions();
+
+    auto It = std::upper_bound(Functions.begin(), Functions.end(), Offset,
+      [](std::uint64_t Value, const Function& Entry)
+    {
+      return Value < Entry.Begin;
+    });
+
+    if (It == Functions.begin())
+    {
+      return nullptr;
+    }
+
+    const Function& Containing = *std::prev(It);
+    return Containing.Contains(Offset) ? &Containing : nullptr;
+  }
+
+  const std::vector<DumpAnalyzer::CrossReference>& DumpAnalyzer::GetCrossReferences() const
+  {
+    return this->InCrossReferences.Get([this]()
+    {
+      return this->ComputeCrossReferences();
+    });
+  }
+
+  bool DumpAnalyzer::BuildInstructionStore()
+  {
+    if (this->InInstructions)
+    {
+      return true;
+    }
+
+    auto Store = std::make_shared<InstructionStore>();
+
+    if (this->LoadFromIndex(AnalysisIndex::Section::Instructions, [&Store](AnalysisIndex::Reader& In)
+    {
+      return Store->Load(In);
+    }))
+    {
+      this->InInstructions = Store;
+      return true;
+    }
+
+    if (!this->InPeSections)
+    {
+      return false;
+    }
+
+    auto TextSection = this->InPeSections->GetSection(".text");
+
+    if (!TextSection)
+    {
+      return false;
+    }
+
+    auto Buffer = this->Read(TextSection->GetOffset(), TextSection->GetSize());
 
     if (Buffer.empty())
     {
-      // Reading failed, buffer too small?
-      return std::nullopt;
+      return false;
     }
 
-    std::size_t Offset = 0;
-    ZydisDecoderContext Context;
+    Store->Clear();
+    Store->Build(this->Decoder, TextSection->GetOffset(), Buffer.data(), Buffer.size());
+    this->InInstructions = Store;
+    this->MarkIndexDirty();
+    return true;
+  }
 
-    while (Offset < Buffer.size())
+  Util::Span<const DumpAnalyzer::CrossReference> DumpAnalyzer::FindCrossReferences(std::uint64_t TargetOffset) const
+  {
+    const auto& References = this->GetCrossReferences();
+
+    auto Begin = std::lower_bound(References.begin(), References.end(), TargetOffset,
+      [](const CrossReference& Reference, std::uint64_t Target)
     {
-      ZydisDecodedInstruction Instruction;
+      return Reference.Target < Target;
+    });
 
-      if (!ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(
-        &this->Decoder,
-        &Context,
-        Buffer.data() + Offset,
-        Buffer.size() - Offset,
-        &Instruction)))
+    auto End = std::upper_bound(Begin, References.end(), TargetOffset,
+      [](std::uint64_t Target, const CrossReference& Reference)
+    {
+      return Target < Reference.Target;
+    });
+
+    return { References.data() + (Begin - References.begin()), static_cast<std::size_t>(End - Begin) };
+  }
+
+  std::vector<std::uint8_t> DumpAnalyzer::EncodeString(const std::string& Str, StringType Type)
+  {
+    std::vector<std::uint8_t> Encoded;
+
+    if (Type == StringType::ASCII)
+    {
+      Encoded.assign(Str.begin(), Str.end());
+    }
+    else if (Type == StringType::UTF16_LE)
+    {
+      for (char C : Str)
       {
-        // Invalid Instruction address?
-        Offset += 1;
-        continue;
+        Encoded.push_back(static_cast<std::uint8_t>(C));
+        Encoded.push_back(0x00);
       }
+    }
 
-      ZydisDecodedOperand Operands[ZYDIS_MAX_OPERAND_COUNT];
+    return Encoded;
+  }
 
-      if (!ZYAN_SUCCESS(ZydisDecoderDecodeOperands(
-        &this->Decoder,
-        &Context,
-        &Instruction,
-        Operands,
-        Instruction.operand_count)))
+  std::vector<std::vector<std::uint64_t>> DumpAnalyzer::FindStrings(const std::vector<StringQuery>& Queries) const
+  {
+    std::vector<std::vector<std::uint64_t>> Out(Queries.size());
+
+    if (!this->InPeSections)
+    {
+      return Out;
+    }
+
+    auto RdataSection = this->InPeSections->GetSection(".rdata");
+
+    if (!RdataSection)
+    {
+      return Out;
+    }
+
+    // Same string in the same encoding is searched for once,
+    // with the most matches any of its queries asks for.
+    AhoCorasick Automaton;
+    std::vector<std::size_t> QueryPatterns(Queries.size());
+    std::vector<std::size_t> PatternMaxMatches;
+
+    for (std::size_t I = 0; I < Queries.size(); ++I)
+    {
+      auto Encoded = EncodeString(Queries[I].String, Queries[I].Type);
+
+      if (Encoded.empty() || !Queries[I].MaxMatches)
       {
-        // Invalid Instruction address?
-        Offset += Instruction.length;
+        QueryPatterns[I] = SIZE_MAX;
         continue;
       }
 
-      if (Filter && !Filter(&Instruction, Operands))
+      std::size_t PatternID = Automaton.AddPattern(Encoded);
+      PatternMaxMatches.resize(Automaton.GetPatternCount(), 0);
+      PatternMaxMatches[PatternID] = (std::max)(PatternMaxMatches[PatternID], Queries[I].MaxMatches);
+      QueryPatterns[I] = PatternID;
+    }
+
+    if (!Automaton.GetPatternCount())
+    {
+      return Out;
+    }
+
+    auto Buffer = this->Read(RdataSection->GetOffset(), RdataSection->GetSize());
+
+    if (Buffer.empty())
+    {
+      return Out;
+    }
+
+    Automaton.Build();
+
+    std::vector<std::vector<std::uint64_t>> PatternMatches(Automaton.GetPatternCount());
+    std::size_t Unsatisfied = Automaton.GetPatternCount();
+    const std::uint64_t RdataSectionOffset = RdataSection->GetOffset();
+
+    Automaton.Search(Buffer.data(), Buffer.size(), [&](std::size_t PatternID, std::size_t MatchOffset)
+    {
+      auto& Matches = PatternMatches[PatternID];
+
+      if (Matches.size() < PatternMaxMatches[PatternID])
+      {
+        Matches.push_back(RdataSectionOffset + MatchOffset);
+
+        if (Matches.size() == PatternMaxMatches[PatternID])
+        {
+          --Unsatisfied;
+        }
+      }
+
+      // Stop as soon as every string has all the matches it asked for
+      return Unsatisfied > 0;
+    });
+
+    for (std::size_t I = 0; I < Queries.size(); ++I)
+    {
+      if (QueryPatterns[I] == SIZE_MAX)
       {
-        // Filtering out
-        Offset += Instruction.length;
         continue;
       }
 
-      std::uint64_t InstructionStart = StartOffset + Offset;
-      std::int64_t InstructionEnd = static_cast<std::int64_t>(InstructionStart + Instruction.length);
+      const auto& Matches = PatternMatches[QueryPatterns[I]];
+      std::size_t Count = (std::min)(Matches.size(), Queries[I].MaxMatches);
+      Out[I].assign(Matches.begin(), Matches.begin() + Count);
+    }
 
-      Result<std::uint64_t> Out = {
+    return Out;
+  }
+
+  template<StringType T>
+  std::optional<DumpAnalyzer::Result<std::vector<std::uint64_t>>>
+    DumpAnalyzer::FindString(const std::string& Str, std::size_t MaxMatches) const
+  {
+    auto Matches = std::move(this->FindStrings({ { Str, T, MaxMatches } })[0]);
+
+    if (Matches.empty())
+    {
+      // No matches found
+      return std::nullopt;
+    }
+
+    Result<std::vector<std::uint64_t>> Out;
+    Out.Range.Offset = Matches.front();
+    Out.Range.Size = (Matches.back() + EncodeString(Str, T).size()) - Out.Range.Offset;
+    Out.Value = std::move(Matches);
+    return Out;
+  }
+
+  std::optional<uint64_t> DumpAnalyzer::FindPattern(const View& Buffer,
+    const CompiledPattern& Pattern) const
+  {
+    auto MatchOffset = PatternScanner::Find(Buffer.data(), Buffer.size(), Pattern);
+
+    if (!MatchOffset)
+    {
+      return std::nullopt;
+    }
+
+    return static_cast<std::uint64_t>(*MatchOffset);
+  }
+
+  std::optional<DumpAnalyzer::Result<>>
+    DumpAnalyzer::FindPattern(std::uint64_t StartOffset, std::size_t Size, const CompiledPattern& Pattern) const
+  {
+    // Patterns could be larger than specified Size,
+    // so make sure that Pattern is handled even if the
+    // specified Size is smaller than the size of the Pattern.
+    // TODO:
+    //  Remove this.
+    //  Its the users responsibility to make sure the size is valid.
+    std::size_t PatternSize = Pattern.GetSize();
+
+    std::size_t BufferSize = (PatternSize > Size) ? PatternSize : Size;
+    auto Buffer = this->Read(StartOffset, BufferSize);
+
+    if (Buffer.empty())
+    {
+      return std::nullopt;
+    }
+
+    auto MatchOffset = FindPattern(Buffer, Pattern);
+
+    if (MatchOffset)
+    {
+      // Return offset & size of successfully matched pattern
+      return Result<>{
         MatchRange{
-          InstructionStart,
-          Instruction.length
+          StartOffset + *MatchOffset,
+          PatternSize
         }
       };
+    }
+
+    return std::nullopt;
+  }
+
+  std::optional<DumpAnalyzer::Result<std::size_t>>
+    DumpAnalyzer::FindApproximatePattern(std::uint64_t StartOffset, std::size_t Size,
+      const CompiledPattern& Pattern, std::size_t MaxMismatches) const
+  {
+    // Same as FindPattern, the window always covers at least the whole pattern
+    std::size_t PatternSize = Pattern.GetSize();
+
+    std::size_t BufferSize = (PatternSize > Size) ? PatternSize : Size;
+    auto Buffer = this->Read(StartOffset, BufferSize);
+
+    if (Buffer.empty())
+    {
+      return std::nullopt;
+    }
+
+    auto Match = PatternScanner::FindApproximate(Buffer.data(), Buffer.size(), Pattern, MaxMismatches);
+
+    if (!Match)
+    {
+      return std::nullopt;
+    }
 
-      // For now, in 64-bit assembly, only one operand can use RIP relative addressing.
-      // So enumerate over all operands to find it.
-      for (int I = 0; I < Instruction.operand_count; ++I)
+    return Result<std::size_t>{
+      MatchRange{
+        StartOffset + Match->Offset,
+        PatternSize
+      },
+      Match->Mismatches
+    };
+  }
+
+  std::optional<DumpAnalyzer::Result<std::uint64_t>>
+    DumpAnalyzer::ExtractCapture(std::uint64_t MatchOffset, const CompiledPattern& Pattern) const
+  {
+    const auto& Captures = Pattern.GetCaptures();
+
+    if (Captures.empty())
+    {
+      return std::nullopt;
+    }
+
+    const auto& Capture = Captures.front();
+    std::uint64_t CaptureOffset = MatchOffset + Capture.Offset;
+    auto Bytes = this->Read(CaptureOffset, Capture.Size);
+
+    if (Bytes.size() < Capture.Size)
+    {
+      return std::nullopt;
+    }
+
+    return Result<std::uint64_t>{
+      MatchRange{
+        CaptureOffset,
+        Capture.Size
+      },
+      Capture.Resolve(Bytes.data(), CaptureOffset)
+    };
+  }
+
+  std::vector<std::uint64_t>
+    DumpAnalyzer::FindPatternMatches(std::uint64_t StartOffset, std::size_t Size, const CompiledPattern& Pattern) const
+  {
+    std::vector<std::uint64_t> Matches;
+    auto Buffer = this->Read(StartOffset, Size);
+
+    if (Buffer.empty() || Pattern.IsEmpty())
+    {
+      return Matches;
+    }
+
+    std::size_t Position = 0;
+
+    while (Position < Buffer.size())
+    {
+      auto MatchOffset = PatternScanner::Find(Buffer.data() + Position, Buffer.size() - Position, Pattern);
+
+      if (!MatchOffset)
+      {
+        break;
+      }
+
+      Position += *MatchOffset;
+      Matches.push_back(StartOffset + Position);
+      ++Position;
+    }
+
+    return Matches;
+  }
+
+  std::optional<DumpAnalyzer::Result<std::vector<DumpAnalyzer::MatchRange>>>
+    DumpAnalyzer::FindPatternSubsequence(std::uint64_t StartOffset, std::size_t Size,
+      const GappedPattern& Patterns) const
+  {
+    auto Buffer = this->Read(StartOffset, Size);
+
+    if (Buffer.empty() || Patterns.IsEmpty())
+    {
+      return std::nullopt;
+    }
+
+    auto Found = Patterns.Find(Buffer.data(), Buffer.size());
+
+    if (!Found)
+    {
+      return std::nullopt;
+    }
+
+    // List of offset & size info of all patterns that matched
+    std::vector<MatchRange> MatchOffsets;
+
+    for (const auto& [Offset, PatternSize] : *Found)
+    {
+      MatchOffsets.push_back({ StartOffset + Offset, PatternSize });
+    }
+
+    // Pattern coverage range
+    Result<std::vector<MatchRange>> Out;
+    Out.Range.Offset = MatchOffsets.front().Offset;
+    Out.Range.Size = (MatchOffsets.back().Offset + MatchOffsets.back().Size) - Out.Range.Offset;
+    Out.Value = std::move(MatchOffsets);
+    return Out;
+  }
+
+  ZydisDecodedOperand* DumpAnalyzer::LazyOperands::Get()
+  {
+    if (!this->Decoded && !this->Failed)
+    {
+      ++this->Decodes;
+
+      if (this->Store)
+      {
+        this->Store->MaterializeOperands(this->StoreIndex, this->Operands);
+      }
+      else
+      {
+        this->Failed = !ZYAN_SUCCESS(ZydisDecoderDecodeOperands(
+          this->Decoder,
+          this->Context,
+          this->Instruction,
+          this->Operands,
+          this->Instruction->operand_count));
+      }
+
+      this->Decoded = !this->Failed;
+    }
+
+    return this->Decoded ? this->Operands : nullptr;
+  }
+
+  void DumpAnalyzer::LazyOperands::SetStored(const InstructionStore* Store, std::size_t Index, bool Failed)
+  {
+    this->Store = Store;
+    this->StoreIndex = Index;
+    this->Context = nullptr;
+    this->Instruction = nullptr;
+    this->Decoded = false;
+    this->Failed = Failed;
+    ++this->Visited;
+  }
+
+  void DumpAnalyzer::LazyOperands::SetDecoded(const ZydisDecoderContext* Context, const ZydisDecodedInstruction* Instruction)
+  {
+    this->Store = nullptr;
+    this->Context = Context;
+    this->Instruction = Instruction;
+    this->Decoded = false;
+    this->Failed = false;
+    ++this->Visited;
+  }
+
+  DumpAnalyzer::LazyOperands::LazyOperands(const ZydisDecoder* Decoder, ScanCounters* Counters) :
+    Decoder(Decoder),
+    Counters(Counters)
+  {
+  }
+
+  DumpAnalyzer::LazyOperands::~LazyOperands()
+  {
+    this->Counters->Instructions.fetch_add(this->Visited, std::memory_order_relaxed);
+    this->Counters->OperandDecodes.fetch_add(this->Decodes, std::memory_order_relaxed);
+  }
+
+  bool DumpAnalyzer::MatchesInstruction(const MatchInstruction& MIInstruction,
+    const ZydisDecodedInstruction& Instruction, LazyOperands& Lazy)
+  {
+    // We only care about matching the mnemonic if
+    // our pattern mnemonic is not a wildcard.
+    if (MIInstruction.Mnemonic)
+    {
+      if (*MIInstruction.Mnemonic == ZYDIS_MNEMONIC_INVALID ||
+        *MIInstruction.Mnemonic != Instruction.mnemonic)
+      {
+        // Mnemonic doesnt match
+        return false;
+      }
+    }
+
+    if (Instruction.operand_count_visible != MIInstruction.Operands.size())
+    {
+      // Pattern size must match instruction size (operands)
+      return false;
+    }
+
+    // Operands are only decoded for instructions passing the checks above.
+    // Failing to decode them counts as a mismatch.
+    const ZydisDecodedOperand* Operands = Lazy.Get();
+
+    if (!Operands)
+    {
+      return false;
+    }
+
+    for (std::size_t I = 0; I < Instruction.operand_count_visible; ++I)
+    {
+      const auto& Operand = Operands[I];
+      const auto& MIOperand = MIInstruction.Operands[I];
+
+      // Default predicates (wildcards) pass every check below
+      bool Match = ((MIOperand.Types >> Operand.type) & 1) &&
+        (!MIOperand.Size || MIOperand.Size == Operand.size);
+
+      if (Operand.type == ZYDIS_OPERAND_TYPE_REGISTER)
+      {
+        const auto SameAs = MIOperand.SameAs;
+
+        Match = Match && MIOperand.Registers.test(Operand.reg.value) &&
+          (SameAs == MatchOperand::NoOperand ||
+            (SameAs < Instruction.operand_count_visible &&
+              Operands[SameAs].type == ZYDIS_OPERAND_TYPE_REGISTER &&
+              Operands[SameAs].reg.value == Operand.reg.value));
+      }
+      else if (Operand.type == ZYDIS_OPERAND_TYPE_IMMEDIATE)
       {
-        const auto& Operand = Operands[I];
+        // Signed immediate values are compared at their encoded width
+        // (e.g. jmp, jz, jnz etc. signed immediate displacements),
+        // so a pattern can give them as the unsigned value of their bytes.
+        std::uint64_t Value = Operand.imm.value.u;
 
-        // Displacement relative value
-        if (Operand.type == ZYDIS_OPERAND_TYPE_MEMORY &&
-          Operand.mem.base == ZYDIS_REGISTER_RIP &&
-          Operand.mem.disp.size > 0)
+        if (Operand.imm.is_signed && Operand.imm.size < sizeof(std::uint64_t) * CHAR_BIT)
         {
-          // Do some casting to avoid negative wraparound due to integer promotion (in std::uint64_t)
-          std::int64_t Displacement = static_cast<std::int64_t>(Operand.mem.disp.value);
-          std::uint64_t ResolvedOffset = static_cast<std::uint64_t>(InstructionEnd + Displacement);
-          Out.Value = ResolvedOffset;
-
-          return Out;
+          Value &= (std::uint64_t{ 1 } << Operand.imm.size) - 1;
         }
-        // Immediate relative value
-        else if (Operand.type == ZYDIS_OPERAND_TYPE_IMMEDIATE &&
-          Operand.imm.is_signed)
-        {
-          std::int64_t Immediate = static_cast<std::int64_t>(Operand.imm.value.s);
-          std::uint64_t ResolvedOffset = static_cast<std::uint64_t>(InstructionEnd + Immediate);
-          Out.Value = ResolvedOffset;
 
-          return Out;
-        }
+        Match = Match && Value >= MIOperand.ImmMin && Value <= MIOperand.ImmMax &&
+          (Value & MIOperand.ImmMask) == MIOperand.ImmValue;
+      }
+      else if (Operand.type == ZYDIS_OPERAND_TYPE_MEMORY)
+      {
+        // Both Zydis' disp value and our Disp range are signed, no conversion needed.
+        Match = Match && MIOperand.Base.test(Operand.mem.base) && MIOperand.Index.test(Operand.mem.index) &&
+          ((MIOperand.Scales >> Operand.mem.scale) & 1) &&
+          Operand.mem.disp.value >= MIOperand.DispMin && Operand.mem.disp.value <= MIOperand.DispMax;
       }
 
-      Offset += Instruction.length;
+      if (!Match)
+      {
+        return false;
+      }
     }
 
-    // Unable to resolve RIP relative address for some reason
-    return std::nullopt;
+    return true;
   }
 
-  // TODO:
-  //  Handle negative offsets, for now this is fine since
-  //  we're working mainly with .Text and .Rdata sections.
-  std::optional<DumpAnalyzer::Result<std::uint64_t>>
-    DumpAnalyzer::FindRipRelativeReference(std::uint64_t StartOffset, std::size_t Size, std::uint64_t TargetOffset,
-    std::function<bool(ZydisDecodedInstruction*, ZydisDecodedOperand*)> Filter) const
+  // Each matcher runs as an NFA over its pattern. A thread is a partial match waiting for
+  // pattern instruction PatternIndex, having skipped Gap instructions since its last match.
+  // Every instruction may start a new thread, so matches overlapping a failed attempt are still found.
+  // Threads in the same state have the same future, only the one that started first is kept,
+  // so the state set stays bounded by the pattern (and gap bounds) instead of growing with the window.
+  // The first thread to complete wins: earliest match end, then earliest start.
+  std::vector<std::optional<DumpAnalyzer::Result<std::vector<DumpAnalyzer::MatchRange>>>>
+    DumpAnalyzer::FindInstructionMatches(std::uint64_t StartOffset, std::size_t Size,
+      const std::vector<InstructionMatcher>& Matchers, bool StopAtFirst) const
   {
-    auto Buffer = this->Read(StartOffset, Size);
+    constexpr std::size_t AnyGap = MatchInstruction::AnyGap;
 
-    if (Buffer.empty())
+    struct Thread
     {
-      return std::nullopt;
-    }
+      std::size_t PatternIndex = 0;
+      std::size_t Gap = 0;
+      std::vector<MatchRange> MatchOffsets;
+    };
 
-    std::size_t Offset = 0;
-    ZydisDecoderContext Context;
+    struct MatcherState
+    {
+      std::vector<std::size_t> MaxGaps;   // Per pattern instruction, AnyGap for no limit
+      std::vector<std::size_t> StateBase; // First state slot of each pattern instruction (one per gap count)
+      std::vector<std::size_t> Claimed;   // Step that last claimed each state slot
+      std::vector<std::int8_t> Matched;   // Per pattern instruction, match of the current instruction (-1 unknown)
+      std::vector<Thread> Threads;        // In start order
+      std::vector<Thread> NextThreads;
+      bool Done = false;
+    };
 
-    while (Offset < Buffer.size())
+    std::vector<std::optional<Result<std::vector<MatchRange>>>> Results(Matchers.size());
+    std::vector<MatcherState> States(Matchers.size());
+    std::size_t Remaining = 0;
+
+    for (std::size_t I = 0; I < Matchers.size(); ++I)
     {
-      ZydisDecodedInstruction Instruction;
+      const InstructionMatcher& Matcher = Matchers[I];
+      MatcherState& State = States[I];
 
-      if (!ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(
-        &this->Decoder,
-        &Context,
-        Buffer.data() + Offset,
-        Buffer.size() - Offset,
-        &Instruction)))
+      // Pattern cant be empty
+      State.Done = !Matcher.Pattern || Matcher.Pattern->empty();
+
+      if (State.Done)
       {
-        Offset += 1;
         continue;
       }
 
-      ZydisDecodedOperand Operands[ZYDIS_MAX_OPERAND_COUNT];
+      const std::size_t Length = Matcher.Pattern->size();
+      std::size_t Slots = 0;
 
-      if (!ZYAN_SUCCESS(ZydisDecoderDecodeOperands(
-        &this->Decoder,
-        &Context,
-        &Instruction,
-        Operands,
-        Instruction.operand_count)))
-      {
-        Offset += Instruction.length;
-        continue;
-      }
+      State.MaxGaps.resize(Length, 0);
+      State.StateBase.resize(Length, 0);
+      State.Matched.resize(Length, -1);
 
-      if (Filter && !Filter(&Instruction, Operands))
+      for (std::size_t Index = 1; Index < Length; ++Index)
       {
-        // Filtering out
-        Offset += Instruction.length;
-        continue;
+        std::size_t MaxGap = (*Matcher.Pattern)[Index].MaxGap.value_or(Matcher.Subsequence ? AnyGap : 0);
+
+        // The window can't hold more instructions than bytes
+        State.MaxGaps[Index] = (MaxGap >= Size) ? AnyGap : MaxGap;
+        State.StateBase[Index] = Slots;
+        Slots += (State.MaxGaps[Index] == AnyGap) ? 1 : State.MaxGaps[Index] + 1;
       }
 
-      std::uint64_t InstructionStart = StartOffset + Offset;
-      std::int64_t InstructionEnd = static_cast<std::int64_t>(InstructionStart + Instruction.length);
+      State.Claimed.resize(Slots, 0);
+      ++Remaining;
+    }
+
+    if (!Remaining)
+    {
+      return Results;
+    }
+
+    std::size_t Step = 0;
+
+    this->WalkInstructions(StartOffset, Size,
+      [&](std::uint64_t InstructionOffset, ZydisDecodedInstruction* Decoded, LazyOperands& Lazy)
+    {
+      ++Step;
 
-      // For now, in 64-bit assembly, only one operand can use RIP relative addressing.
-      // So enumerate over all operands to find it.
-      for (int I = 0; I < Instruction.operand_count; ++I)
+      for (std::size_t I = 0; I < Matchers.size(); ++I)
       {
-        const auto& Operand = Operands[I];
-        std::uint64_t ResolvedOffset = 0;
+        const std::vector<MatchInstruction>& Pattern = *Matchers[I].Pattern;
+        MatcherState& State = States[I];
 
-        // Displacement relative value
-        if (Operand.type == ZYDIS_OPERAND_TYPE_MEMORY &&
-          Operand.mem.base == ZYDIS_REGISTER_RIP &&
-          Operand.mem.disp.size > 0)
+        if (State.Done)
         {
-          std::int64_t Displacement = static_cast<std::int64_t>(Operand.mem.disp.value);
-          ResolvedOffset = static_cast<std::uint64_t>(InstructionEnd + Displacement);
+          continue;
         }
-        // Immediate relative value
-        else if (Operand.type == ZYDIS_OPERAND_TYPE_IMMEDIATE &&
-          Operand.imm.is_signed)
+
+        std::fill(State.Matched.begin(), State.Matched.end(), static_cast<std::int8_t>(-1));
+
+        // Pattern instructions are checked at most once per instruction, however many threads wait on them
+        auto Matches = [&](std::size_t Index)
+        {
+          if (State.Matched[Index] < 0)
+          {
+            State.Matched[Index] = (Decoded && MatchesInstruction(Pattern[Index], *Decoded, Lazy)) ? 1 : 0;
+          }
+
+          return State.Matched[Index] != 0;
+        };
+
+        // Whether no earlier started thread is in the state yet
+        auto Claim = [&](std::size_t Index, std::size_t Gap)
+        {
+          std::size_t Slot = State.StateBase[Index] + ((State.MaxGaps[Index] == AnyGap) ? 0 : Gap);
+
+          if (State.Claimed[Slot] == Step)
+          {
+            return false;
+          }
+
+          State.Claimed[Slot] = Step;
+          return true;
+        };
+
+        std::optional<std::vector<MatchRange>> Completed;
+
+        auto Advance = [&](std::size_t Index, std::vector<MatchRange>&& MatchOffsets)
+        {
+          MatchOffsets.push_back({ InstructionOffset, Decoded->length });
+
+          if (Index + 1 == Pattern.size())
+          {
+            if (!Completed)
+            {
+              Completed = std::move(MatchOffsets);
+            }
+          }
+          else if (Claim(Index + 1, 0))
+          {
+            State.NextThreads.push_back({ Index + 1, 0, std::move(MatchOffsets) });
+          }
+        };
+
+        for (Thread& Current : State.Threads)
+        {
+          const std::size_t MaxGap = State.MaxGaps[Current.PatternIndex];
+          const std::size_t Gap = (MaxGap == AnyGap) ? 0 : Current.Gap + 1;
+          const bool CanSkip = (MaxGap == AnyGap) || Current.Gap < MaxGap;
+
+          if (Matches(Current.PatternIndex))
+          {
+            // Both taking the instruction and skipping it (if the gap allows) can lead to a match,
+            // taking it goes first so the earliest instructions are preferred.
+            Advance(Current.PatternIndex, std::vector<MatchRange>(Current.MatchOffsets));
+
+            if (CanSkip && Claim(Current.PatternIndex, Gap))
+            {
+              State.NextThreads.push_back({ Current.PatternIndex, Gap, std::move(Current.MatchOffsets) });
+            }
+          }
+          else if (CanSkip && Claim(Current.PatternIndex, Gap))
+          {
+            State.NextThreads.push_back({ Current.PatternIndex, Gap, std::move(Current.MatchOffsets) });
+          }
+        }
+
+        // Every instruction can start a match
+        if (Matches(0))
         {
-          std::int64_t Immediate = static_cast<std::int64_t>(Operand.imm.value.s);
-          ResolvedOffset = static_cast<std::uint64_t>(InstructionEnd + Immediate);
+          Advance(0, {});
         }
 
-        if (ResolvedOffset == TargetOffset)
+        std::swap(State.Threads, State.NextThreads);
+        State.NextThreads.clear();
+
+        if (Completed)
         {
-          return Result<std::uint64_t>{
+          // Final instruction found, return pattern coverage range.
+          std::uint64_t Begin = Completed->front().Offset;
+
+          Results[I] = Result<std::vector<MatchRange>>{
             MatchRange{
-              InstructionStart,
-              Instruction.length,
+              Begin,
+              static_cast<std::size_t>((InstructionOffset + Decoded->length) - Begin)
             },
-            InstructionStart
+            std::move(*Completed)
           };
+
+          State.Done = true;
+          State.Threads.clear();
+          --Remaining;
         }
       }
 
-      Offset += Instruction.length;
-    }
+      if (StopAtFirst)
+      {
+        // Done once the first matcher that can still match has matched
+        for (std::size_t I = 0; I < Matchers.size(); ++I)
+        {
+          if (Results[I])
+          {
+            return false;
+          }
 
-    return std::nullopt;
+          if (!States[I].Done)
+          {
+            break;
+          }
+        }
+      }
+
+      return Remaining != 0;
+    });
+
+    return Results;
   }
 
-  // Extracts first displacement encountered.
-  std::optional<DumpAnalyzer::Result<std::uint32_t>>
-    DumpAnalyzer::ExtractDisplacement(std::uint64_t StartOffset, std::size_t Size) const
+  std::optional<DumpAnalyzer::Result<std::vector<DumpAnalyzer::MatchRange>>>
+    DumpAnalyzer::FindInstructionSequence(std::uint64_t StartOffset, std::size_t Size,
+      const std::vector<MatchInstruction>& Pattern) const
   {
-    auto Buffer = this->Read(StartOffset, Size);
+    return this->FindInstructionMatches(StartOffset, Size, { InstructionMatcher{ &Pattern, false } }).front();
+  }
 
-    if (Buffer.empty())
+  std::optional<DumpAnalyzer::Result<std::vector<DumpAnalyzer::MatchRange>>>
+    DumpAnalyzer::FindInstructionSubsequence(std::uint64_t StartOffset, std::size_t Size,
+      const std::vector<MatchInstruction>& Pattern) const
+  {
+    return this->FindInstructionMatches(StartOffset, Size, { InstructionMatcher{ &Pattern, true } }).front();
+  }
+
+  std::optional<DumpAnalyzer::Result<std::uint64_t>>
+    DumpAnalyzer::ResolveRipRelativeOffset(std::uint64_t StartOffset, std::size_t Size,
+    FilterFunction Filter, std::optional<ZydisMnemonic> Mnemonic) const
+  {
+    if (!Filter)
     {
-      return std::nullopt;
+      return this->ResolveRipRelativeOffset<std::nullptr_t>(StartOffset, Size, nullptr, Mnemonic);
     }
 
-    std::size_t Offset = 0;
-    ZydisDecoderContext Context;
+    return this->ResolveRipRelativeOffset<const FilterFunction&>(StartOffset, Size, Filter, Mnemonic);
+  }
 
-    while (Offset < Buffer.size())
+  std::optional<DumpAnalyzer::Result<std::uint64_t>>
+    DumpAnalyzer::FindRipRelativeReference(std::uint64_t StartOffset, std::size_t Size, std::uint64_t TargetOffset,
+    FilterFunction Filter, std::optional<ZydisMnemonic> Mnemonic) const
+  {
+    if (!Filter)
     {
-      ZydisDecodedInstruction Instruction;
+      return this->FindRipRelativeReference<std::nullptr_t>(StartOffset, Size, TargetOffset, nullptr, Mnemonic);
+    }
 
-      if (!ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(
-        &this->Decoder,
-        &Context,
-        Buffer.data() + Offset,
-        Buffer.size() - Offset,
-        &Instruction)))
+    return this->FindRipRelativeReference<const FilterFunction&>(StartOffset, Size, TargetOffset, Filter, Mnemonic);
+  }
+
+  // Extracts first displacement encountered.
+  std::optional<DumpAnalyzer::Result<std::uint32_t>>
+    DumpAnalyzer::ExtractDisplacement(std::uint64_t StartOffset, std::size_t Size) const
+  {
+    std::optional<Result<std::uint32_t>> Displacement;
+
+    this->WalkInstructions(StartOffset, Size,
+      [&](std::uint64_t InstructionOffset, ZydisDecodedInstruction* Decoded, LazyOperands& Lazy)
+    {
+      if (!Decoded)
       {
-        Offset += 1;
-        continue;
+        return true;
       }
 
-      ZydisDecodedOperand Operands[ZYDIS_MAX_OPERAND_COUNT];
+      const ZydisDecodedInstruction& Instruction = *Decoded;
+      ZydisDecodedOperand* Operands = (Instruction.operand_count > 0) ? Lazy.Get() : nullptr;
 
-      if (!ZYAN_SUCCESS(ZydisDecoderDecodeOperands(
-        &this->Decoder,
-        &Context,
-        &Instruction,
-        Operands,
-        Instruction.operand_count)))
+      if (!Operands)
       {
-        Offset += Instruction.length;
-        continue;
+        return true;
       }
 
       // Look for an operand with type memory that contains a displacement.
@@ -1549,20 +2329,22 @@ namespace COF
         if (Operands[i].type == ZYDIS_OPERAND_TYPE_MEMORY &&
           Operands[i].mem.disp.size > 0)
         {
-          return Result<std::uint32_t>{
+          Displacement = Result<std::uint32_t>{
             MatchRange{
-              StartOffset + Offset,
+              InstructionOffset,
               Instruction.length,
             },
             static_cast<std::uint32_t>(Operands[i].mem.disp.value)
           };
+
+          return false;
         }
       }
 
-      Offset += Instruction.length;
-    }
+      return true;
+    });
 
-    return std::nullopt;
+    return Displacement;
   }
 
   // Extracts first immediate encountered.
@@ -1570,41 +2352,22 @@ namespace COF
   std::optional<DumpAnalyzer::Result<std::uint64_t>> DumpAnalyzer::ExtractImmediate(
     std::uint64_t StartOffset, std::size_t Size) const
   {
-    auto Buffer = this->Read(StartOffset, Size);
-
-    if (Buffer.empty())
-    {
-      return std::nullopt;
-    }
-
-    std::size_t Offset = 0;
-    ZydisDecoderContext Context;
+    std::optional<Result<std::uint64_t>> Immediate;
 
-    while (Offset < Buffer.size())
+    this->WalkInstructions(StartOffset, Size,
+      [&](std::uint64_t InstructionOffset, ZydisDecodedInstruction* Decoded, LazyOperands& Lazy)
     {
-      ZydisDecodedInstruction Instruction;
-
-      if (!ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(
-        &this->Decoder,
-        &Context,
-        Buffer.data() + Offset,
-        Buffer.size() - Offset,
-        &Instruction)))
+      if (!Decoded)
       {
-        Offset += 1;
-        continue;
+        return true;
       }
 
-      ZydisDecodedOperand Operands[ZYDIS_MAX_OPERAND_COUNT];
-      if (!ZYAN_SUCCESS(ZydisDecoderDecodeOperands(
-        &this->Decoder,
-        &Context,
-        &Instruction,
-        Operands,
-        Instruction.operand_count)))
+      const ZydisDecodedInstruction& Instruction = *Decoded;
+      ZydisDecodedOperand* Operands = (Instruction.operand_count > 0) ? Lazy.Get() : nullptr;
+
+      if (!Operands)
       {
-        Offset += Instruction.length;
-        continue;
+        return true;
       }
 
       // Look for an operand with type immediate.
@@ -1612,33 +2375,28 @@ namespace COF
       {
         if (Operands[i].type == ZYDIS_OPERAND_TYPE_IMMEDIATE)
         {
-          return Result<std::uint64_t>{
+          Immediate = Result<std::uint64_t>{
             MatchRange{
-              StartOffset + Offset,
+              InstructionOffset,
               Instruction.length
             },
             Operands[i].imm.value.u
           };
+
+          return false;
         }
       }
 
-      Offset += Instruction.length;
-    }
+      return true;
+    });
 
-    return std::nullopt;
+    return Immediate;
   }
 
   template <typename XorT>
   std::optional<DumpAnalyzer::Result<std::vector<DumpAnalyzer::TslDecryption<XorT>>>>
     DumpAnalyzer::ExtractTslDecryptors(std::uint64_t StartOffset, std::size_t Size) const
   {
-    auto Buffer = this->Read(StartOffset, Size);
-
-    if (Buffer.empty())
-    {
-      return std::nullopt;
-    }
-
     bool X32Mode = false;
 
     if constexpr (std::is_same_v<XorT, std::uint32_t>)
@@ -1738,10 +2496,12 @@ namespace COF
       ChainMap[Register] = ChainIndex;
     };
 
-    auto CreateChain = [&Chains, &ChainMap](ZydisRegister Register)
+    // Only orders the chains of this call, regions are searched concurrently
+    std::uint8_t ChainID = 0;
+
+    auto CreateChain = [&Chains, &ChainMap, &ChainID](ZydisRegister Register)
       -> std::size_t
     {
-      static std::uint8_t ChainID = 0;
       Chains.push_back({ ChainID });
       std::size_t ChainIndex = Chains.size() - 1;
       ChainMap[Register] = ChainIndex;
@@ -1772,48 +2532,33 @@ namespace COF
       }
     };
 
-    //std::size_t Count = 0;
-    std::size_t Offset = 0;
     RegisterTracker<XorT> Tracker;
 
-    ZydisDecodedInstruction Instruction;
-    ZydisDecodedOperand Operands[ZYDIS_MAX_OPERAND_COUNT];
-    ZydisDecoderContext Context;
-
-    while (Offset < Buffer.size() /*&& Count < MaxInstructions*/)
+    this->WalkInstructions(StartOffset, Size,
+      [&](std::uint64_t InstructionOffset, ZydisDecodedInstruction* Decoded, LazyOperands& Lazy)
     {
-      if (!ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(
-        &this->Decoder,
-        &Context,
-        Buffer.data() + Offset,
-        Buffer.size() - Offset,
-        &Instruction)))
+      if (!Decoded)
       {
-        Offset += 1; // Skip one byte if decode failed
-        continue;
+        return true;
       }
 
-      if (!ZYAN_SUCCESS(ZydisDecoderDecodeOperands(
-        &this->Decoder,
-        &Context,
-        &Instruction,
-        Operands,
-        Instruction.operand_count)))
-      {
-        Offset += Instruction.length;
-        continue;
-      }
+      const ZydisDecodedInstruction& Instruction = *Decoded;
 
       // We only want to capture 64-bit or 32-bit operands,
       // and we arent interested in any instruction with less than two operands.
       if (Instruction.operand_width != sizeof(XorT) * CHAR_BIT
         || Instruction.operand_count < 2)
       {
-        Offset += Instruction.length;
-        continue;
+        return true;
+      }
+
+      ZydisDecodedOperand* Operands = Lazy.Get();
+
+      if (!Operands)
+      {
+        return true;
       }
 
-      std::uint64_t InstructionOffset = StartOffset + Offset;
       ZydisRegister DstRegister = Operands[0].reg.value;
       ZydisRegister SrcRegister = Operands[1].reg.value;
 
@@ -1910,8 +2655,7 @@ namespace COF
 
           if (Chain.Checklist.IsXorExtracted())
           {
-            Offset += Instruction.length;
-            continue;
+            return true;
           }
 
           if (auto DstCode = Chain.GetPseudocode(DstRegister); DstCode)
@@ -1995,8 +2739,7 @@ namespace COF
 
           if (Chain.Checklist.Rotate)
           {
-            Offset += Instruction.length;
-            continue;
+            return true;
           }
 
           bool Right = (Instruction.mnemonic == ZYDIS_MNEMONIC_ROR);
@@ -2073,8 +2816,7 @@ namespace COF
 
           if (Chain.Checklist.Shift)
           {
-            Offset += Instruction.length;
-            continue;
+            return true;
           }
 
           bool Right = (Instruction.mnemonic == ZYDIS_MNEMONIC_SHR);
@@ -2135,8 +2877,8 @@ namespace COF
         }
       }
 
-      Offset += Instruction.length;
-    }
+      return true;
+    });
 
     // Post extraction sorting etc.
     if (CompletedChains.size() > 0)
@@ -2189,12 +2931,23 @@ namespace COF
   template <Mode M>
   bool DumpAnalyzer::Analyze()
   {
-    this->InFile.open(InFilePath, std::ios::binary);
+    auto Mapping = std::make_shared<MappedFile>();
 
-    if (!this->InFile)
+    if (Mapping->Open(this->InFilePath))
     {
-      //std::cerr << "[!] Failed to open input file.\n";
-      return false;
+      this->InMapping = Mapping;
+    }
+    else
+    {
+      // Couldn't map the dump (e.g. empty or locked file),
+      // fall back to buffered reads through the file stream.
+      this->InFile.open(InFilePath, std::ios::binary);
+
+      if (!this->InFile)
+      {
+        //std::cerr << "[!] Failed to open input file.\n";
+        return false;
+      }
     }
 
     if constexpr (M == Mode::Regions)
@@ -2224,15 +2977,17 @@ namespace COF
 
       //std::cout << std::dec << "[?] Total regions loaded: " << this->InMemoryRegions.size() << std::hex << std::endl;
       this->InMetadata.DumpSectionOffset = RegionsSectionOffset + RegionsSectionSize;
+      this->BuildRegionMappings();
     }
     else
     {
       this->AnalysisMode = Mode::Sparse;
     }
 
+    // Headers and sections are cheap to parse and needed by everything else.
+    // The artifacts derived from them (functions, cross references, file version)
+    // are only computed once something asks for them.
     this->ExtractAndSavePeHeaderAndSections();
-    this->ExtractAndSaveFunctions();
-    this->ExtractAndSaveFileVersion();
     return true;
   }
 
@@ -2261,12 +3016,22 @@ namespace COF
     }
 
     this->AnalysisMode = Other.AnalysisMode;
+    this->InMapping = Other.InMapping;
     this->InFilePath = Other.InFilePath;
     this->InMetadata = Other.InMetadata;
     this->InMemoryRegions = Other.InMemoryRegions;
+    this->InRegionMappings = Other.InRegionMappings;
     this->InPeHeader = Other.InPeHeader;
     this->InPeSections = Other.InPeSections;
-    this->InFunctionOffsets = Other.InFunctionOffsets;
+    this->InExceptionDirectory = Other.InExceptionDirectory;
+    this->InFileVersion = Other.InFileVersion;
+    this->InFunctions = Other.InFunctions;
+    this->InCrossReferences = Other.InCrossReferences;
+    this->InInstructions = Other.InInstructions;
+    this->IndexEnabled = Other.IndexEnabled;
+    this->InIndex = Other.InIndex;
+    this->InThreadPool = Other.InThreadPool;
+    this->InScanCounters = Other.InScanCounters;
     this->Decoder = Other.Decoder;
 
     // Note: std::ifstream is not copyable, so InFile is not copied.
@@ -2275,12 +3040,22 @@ namespace COF
 
   DumpAnalyzer::DumpAnalyzer(const DumpAnalyzer& Other) :
     AnalysisMode(Other.AnalysisMode),
+    InMapping(Other.InMapping),
     InFilePath(Other.InFilePath),
     InMetadata(Other.InMetadata),
     InMemoryRegions(Other.InMemoryRegions),
+    InRegionMappings(Other.InRegionMappings),
     InPeHeader(Other.InPeHeader),
     InPeSections(Other.InPeSections),
-    InFunctionOffsets(Other.InFunctionOffsets),
+    InExceptionDirectory(Other.InExceptionDirectory),
+    InFileVersion(Other.InFileVersion),
+    InFunctions(Other.InFunctions),
+    InCrossReferences(Other.InCrossReferences),
+    InInstructions(Other.InInstructions),
+    IndexEnabled(Other.IndexEnabled),
+    InIndex(Other.InIndex),
+    InThreadPool(Other.InThreadPool),
+    InScanCounters(Other.InScanCounters),
     Decoder(Other.Decoder)
   {
     // Note: std::ifstream is not copyable, so InFile is not copied.
@@ -2288,6 +3063,7 @@ namespace COF
 
   DumpAnalyzer::~DumpAnalyzer()
   {
+    this->SaveIndex();
     this->InFile.close();
   }
 
@@ -2,6 +2,12 @@
 #define COF_DUMP_ANALYZER_H
 
 #include "MemoryDumper.h"
+#include "MappedFile.h"
+#include "InstructionStore.h"
+#include "PatternScanner.h"
+#include "GappedPattern.h"
+#include "AnalysisIndex.h"
+#include "ThreadPool.h"
 #include "Util.h"
 #include "CodeGeneration.h"
 
@@ -14,12 +20,18 @@
 #include <optional>
 #include <variant>
 #include <utility>
-#include <set>
 #include <cstdint>
 #include <cstddef>
 #include <functional>
+#include <type_traits>
+#include <limits>
+#include <bitset>
 #include <sstream>
 #include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstring>
 
 namespace COF
 {
@@ -35,6 +47,15 @@ namespace COF
   class DumpAnalyzer
   {
   private:
+    // Dumped region with its precomputed location in the dump file.
+    // Kept sorted by address so virtual offsets can be translated by binary search.
+    struct RegionMapping
+    {
+      std::uint64_t AddressBegin = 0;
+      std::uint64_t AddressEnd = 0; // Exclusive, unlike pmm::Region::AddressEnd
+      std::uint64_t FileOffset = 0;
+    };
+
     struct Metadata : public MemoryDumper::Metadata
     {
       struct BaseAddressInformation
@@ -96,6 +117,13 @@ namespace COF
       UTF16_LE
     };
 
+    struct StringQuery
+    {
+      std::string String;
+      StringType Type = StringType::UTF16_LE;
+      std::size_t MaxMatches = 1;
+    };
+
     // Structure to hold the extracted pseudocode parameters.
     template <typename XorT = std::uint64_t>
     struct TslDecryption
@@ -143,25 +171,50 @@ namespace COF
       }
     };
 
-    struct MemoryOperand
-    {
-      std::optional<ZydisRegister> Base;
-      std::optional<ZydisRegister> Index;
-      std::optional<std::uint8_t> Scale;
-      std::optional<std::int64_t> Disp;
-    };
+    // One bit per ZydisRegister
+    using RegisterSet = std::bitset<ZYDIS_REGISTER_MAX_VALUE + 1>;
 
+    // Operand predicate compiled from the pattern text (see AssemblyParser).
+    // Kept flat so matching an operand is a few bit tests and compares.
+    // Default constructed it matches any operand.
     struct MatchOperand
     {
-      std::optional<MemoryOperand> Mem;
-      std::optional<ZydisRegister> Reg;
-      std::optional<std::uint64_t> Imm;
+      static constexpr std::uint8_t AnyType = 0xFF;
+      static constexpr std::uint8_t NoOperand = 0xFF;
+
+      std::uint8_t Types = AnyType; // Allowed operand types, bit (1 << ZydisOperandType)
+      std::uint16_t Size = 0;       // Operand size in bits, 0 for any
+
+      // Register operands
+      RegisterSet Registers = RegisterSet().set();
+      std::uint8_t SameAs = NoOperand; // Must be the same register as this operand
+
+      // Immediate operands, signed immediates are compared at their encoded width.
+      // Matches if ImmMin <= Imm <= ImmMax and (Imm & ImmMask) == ImmValue.
+      std::uint64_t ImmMin = 0;
+      std::uint64_t ImmMax = (std::numeric_limits<std::uint64_t>::max)();
+      std::uint64_t ImmMask = 0;
+      std::uint64_t ImmValue = 0;
+
+      // Memory operands
+      RegisterSet Base = RegisterSet().set();
+      RegisterSet Index = RegisterSet().set();
+      std::uint16_t Scales = 0xFFFF; // Allowed scales, bit (1 << Scale)
+      std::int64_t DispMin = (std::numeric_limits<std::int64_t>::min)();
+      std::int64_t DispMax = (std::numeric_limits<std::int64_t>::max)();
     };
 
     struct MatchInstruction
     {
+      // MaxGap allowing any number of instructions
+      static constexpr std::size_t AnyGap = (std::numeric_limits<std::size_t>::max)();
+
       std::optional<ZydisMnemonic> Mnemonic;
-      std::vector<std::optional<MatchOperand>> Operands;
+      std::vector<MatchOperand> Operands;
+
+      // Instructions that may be skipped between the previous pattern instruction and this one.
+      // Unset uses the default of the matcher: none in sequences, AnyGap in subsequences.
+      std::optional<std::size_t> MaxGap;
     };
 
     struct MatchRange
@@ -170,6 +223,36 @@ namespace COF
       std::size_t Size = 0;
     };
 
+    // Instruction pattern for FindInstructionMatches
+    struct InstructionMatcher
+    {
+      const std::vector<MatchInstruction>* Pattern = nullptr;
+      bool Subsequence = false; // Default MaxGap of the pattern instructions, see MatchInstruction
+    };
+
+    // Read-only bytes of the dump returned by Read().
+    // Points straight into the memory mapped dump (zero-copy), unless the dump
+    // had to be read through the buffered stream fallback, in which case
+    // the view owns (shares) the buffer it points into.
+    class View : public Util::Span<const std::uint8_t>
+    {
+      std::shared_ptr<const std::vector<std::uint8_t>> Owned;
+
+    public:
+      View(const std::uint8_t* Data, std::size_t Size)
+        : Span(Data, Size)
+      {
+      }
+
+      View(std::vector<std::uint8_t>&& Buffer)
+        : Owned(std::make_shared<const std::vector<std::uint8_t>>(std::move(Buffer)))
+      {
+        static_cast<Span&>(*this) = Span(this->Owned->data(), this->Owned->size());
+      }
+
+      View() = default;
+    };
+
     // This will be returned by every scan/find instruction
     template <typename T = std::monostate>
     struct Result
@@ -184,7 +267,45 @@ namespace COF
       std::optional<T> Value;
     };
 
-    using PatternElem = std::pair<std::uint8_t /*Mask*/, std::uint8_t /*Value*/>;
+    using PatternElem = PatternScanner::PatternElem;
+    using CompiledPattern = PatternScanner::CompiledPattern;
+    using GappedPattern = PatternScanner::GappedPattern;
+
+    // Instruction in .text referencing a RIP-relative target,
+    // either through a memory operand (e.g. lea rcx, [rip+disp])
+    // or a relative immediate (e.g. call/jmp rel32).
+    struct CrossReference
+    {
+      std::uint64_t Target = 0;      // Resolved target offset
+      std::uint64_t Instruction = 0; // Offset of the referencing instruction
+      ZydisMnemonic Mnemonic = ZYDIS_MNEMONIC_INVALID;
+      std::uint8_t Length = 0;       // Length of the referencing instruction
+    };
+
+    // Entry of the function table
+    struct Function
+    {
+      enum : std::uint32_t
+      {
+        CallTarget = 1 << 0,     // Target of a direct call in .text
+        RuntimeFunction = 1 << 1 // Listed in the exception directory, End is exact
+      };
+
+      std::uint64_t Begin = 0;
+      std::uint64_t End = 0; // Exclusive. Without an exact end, the next function's begin.
+      std::uint32_t Flags = 0;
+
+      std::size_t GetSize() const;
+      bool HasExactEnd() const;
+      bool Contains(std::uint64_t Offset) const;
+    };
+
+    // Counters of the instruction scanners (see WalkInstructions), summed over all searches so far
+    struct ScanStatistics
+    {
+      std::uint64_t Instructions = 0;   // Instructions visited
+      std::uint64_t OperandDecodes = 0; // Instructions whose operands had to be decoded
+    };
 
   private:
     // A simple register tracker.
@@ -238,84 +359,496 @@ namespace COF
     };
 
     Mode AnalysisMode = Mode::Regions;
+
+    // Dump is memory mapped when possible, InFile is only used as a fallback.
+    // Mapping is shared so copies of the analyzer don't have to remap the dump.
+    std::shared_ptr<MappedFile> InMapping;
     mutable std::ifstream InFile;
+    mutable std::mutex InFileMutex;
     std::string InFilePath;
     Metadata InMetadata;
     std::vector<pmm::Region> InMemoryRegions;
-    std::optional <std::string> InFileVersion;
+    std::vector<RegionMapping> InRegionMappings;
     std::optional<PeHeader> InPeHeader;
     std::optional<PeSections> InPeSections;
-    std::set<std::uint64_t> InFunctionOffsets;
+    std::optional<PeSection> InExceptionDirectory;
+
+    // Artifacts derived from the sections, each computed on first access (or loaded from the index file).
+    // Searches that don't need one never pay for it.
+    Util::Lazy<std::optional<std::string>> InFileVersion;
+    Util::Lazy<std::vector<Function>> InFunctions;             // Sorted by Begin
+    Util::Lazy<std::vector<CrossReference>> InCrossReferences; // Sorted by target (then instruction) for range lookups
+
+    // Pre-decoded .text, only built on request (see BuildInstructionStore).
+    // Shared for the same reason as InMapping, it's immutable once built.
+    std::shared_ptr<const InstructionStore> InInstructions;
+
+    // Index file of the dump (see AnalysisIndex.h), opened when the first artifact is needed.
+    // Shared by copies of the analyzer, like the artifacts it caches.
+    struct IndexFile
+    {
+      std::once_flag Opened;
+      std::mutex Mutex;
+      std::optional<std::uint64_t> ContentHash;
+      std::optional<AnalysisIndex::Header> Header; // Set while Mapping holds an index matching the dump
+      std::unique_ptr<MappedFile> Mapping;
+      bool Dirty = false; // Artifacts were computed that the index file doesn't hold
+    };
+
+    bool IndexEnabled = true;
+    std::shared_ptr<IndexFile> InIndex = std::make_shared<IndexFile>();
+
+    // Used by the analysis stages that can run in parallel, serial without one
+    std::shared_ptr<ThreadPool> InThreadPool;
+
+    // Shared by copies of the analyzer, searches running on copies count towards the same totals
+    struct ScanCounters
+    {
+      std::atomic<std::uint64_t> Instructions{ 0 };
+      std::atomic<std::uint64_t> OperandDecodes{ 0 };
+    };
+
+    std::shared_ptr<ScanCounters> InScanCounters = std::make_shared<ScanCounters>();
 
     ZydisDecoder Decoder;
     ZydisMachineMode MachineMode = ZYDIS_MACHINE_MODE_LONG_64;
     ZydisStackWidth StackWidth = ZYDIS_STACK_WIDTH_64;
 
+    std::uint64_t GetFileSize() const;
+    void BuildRegionMappings();
+    const RegionMapping* FindRegionMapping(std::uint64_t VirtualAddress) const;
     std::optional<std::uint64_t> TranslateVirtualOffsetToFileOffset(std::uint64_t VirtualOffset) const;
-    std::vector<std::uint8_t> _Read(std::uint64_t Offset, std::size_t Size) const;
-    std::vector<std::uint8_t> Read(std::uint64_t Offset, std::size_t Size) const;
+    View _Read(std::uint64_t Offset, std::size_t Size) const;
 
     template <typename T>
     T _Read(std::uint64_t Offset) const
     {
       T Result{};
-      this->InFile.clear();
-      this->InFile.seekg(Offset, std::ios::beg);
-      this->InFile.read(reinterpret_cast<char*>(&Result), sizeof(T));
+      auto Bytes = this->_Read(Offset, sizeof(T));
+
+      if (!Bytes.empty())
+      {
+        std::memcpy(&Result, Bytes.data(), Bytes.size());
+      }
+
       return Result;
     }
 
+    // Goes through Read(Offset, Size), so a T straddling the end of a region continues
+    // in the virtually adjacent one. Bytes that couldn't be read are left zeroed.
     template <typename T>
     T Read(std::uint64_t Offset) const
     {
-      if (this->AnalysisMode == Mode::Regions)
+      T Result{};
+      auto Bytes = this->Read(Offset, sizeof(T));
+
+      if (!Bytes.empty())
+      {
+        std::memcpy(&Result, Bytes.data(), (std::min)(Bytes.size(), sizeof(T)));
+      }
+
+      return Result;
+    }
+
+    // Operands of the instruction WalkInstructions is visiting, decoded on the first Get().
+    // Scanners reject most instructions on their mnemonic or operand count alone,
+    // only the ones passing those checks pay for decoding (or materializing) operands.
+    class LazyOperands
+    {
+      const ZydisDecoder* Decoder = nullptr;
+      ScanCounters* Counters = nullptr;
+
+      // Where the visited instruction came from, the store or an on the fly decode
+      const InstructionStore* Store = nullptr;
+      std::size_t StoreIndex = 0;
+      const ZydisDecoderContext* Context = nullptr;
+      const ZydisDecodedInstruction* Instruction = nullptr;
+
+      ZydisDecodedOperand Operands[ZYDIS_MAX_OPERAND_COUNT];
+      bool Decoded = false;
+      bool Failed = false;
+
+      // Counted locally, added to Counters once the walk is done
+      std::uint64_t Visited = 0;
+      std::uint64_t Decodes = 0;
+
+    public:
+      // nullptr if the operands could not be decoded
+      ZydisDecodedOperand* Get();
+
+      void SetStored(const InstructionStore* Store, std::size_t Index, bool Failed);
+      void SetDecoded(const ZydisDecoderContext* Context, const ZydisDecodedInstruction* Instruction);
+
+      LazyOperands& operator=(const LazyOperands& Other) = delete;
+      LazyOperands(const LazyOperands& Other) = delete;
+      LazyOperands(const ZydisDecoder* Decoder, ScanCounters* Counters);
+      ~LazyOperands();
+    };
+
+    // Calls Visit(InstructionOffset, Instruction, Operands) for every instruction in [StartOffset, StartOffset + Size).
+    // Instruction is nullptr where nothing could be decoded, scanners tracking sequences reset on it.
+    // Operands is a LazyOperands, Operands.Get() returning nullptr counts as a failed decode too.
+    // Instructions are taken from the pre-decoded store whenever the walk is on an instruction boundary
+    // known to it, everything else (or everything, without a store) is decoded on the fly.
+    // Visit returns false to stop walking.
+    template <typename Visitor>
+    void WalkInstructions(std::uint64_t StartOffset, std::size_t Size, Visitor&& Visit) const
+    {
+      const InstructionStore* Store = this->InInstructions.get();
+      const std::size_t Count = Store ? Store->GetCount() : 0;
+      std::size_t Index = Store ? Store->LowerBound(StartOffset) : 0;
+
+      const std::uint64_t EndOffset = StartOffset + Size;
+      std::uint64_t Offset = StartOffset;
+
+      View Buffer;
+      bool BufferRead = false;
+      ZydisDecoderContext Context;
+      ZydisDecodedInstruction Instruction;
+      LazyOperands Operands(&this->Decoder, this->InScanCounters.get());
+
+      while (Offset < EndOffset)
       {
-        auto FileOffset = this->TranslateVirtualOffsetToFileOffset(Offset);
+        while (Index < Count && Store->GetOffset(Index) < Offset)
+        {
+          ++Index;
+        }
 
-        if (FileOffset)
+        if (Index < Count && Store->GetOffset(Index) == Offset)
         {
-          return this->_Read<T>(*FileOffset);
+          std::uint8_t Length = Store->GetLength(Index);
+
+          if (Offset + Length > EndOffset)
+          {
+            // Instruction crosses the end of the window
+            return;
+          }
+
+          Store->Materialize(Index, Instruction);
+          Operands.SetStored(Store, Index, (Store->GetFlags(Index) & InstructionStore::InstructionOperandsFailed) != 0);
+
+          if (!Visit(Offset, &Instruction, Operands))
+          {
+            return;
+          }
+
+          Offset += Length;
+          ++Index;
+          continue;
         }
 
-        return T{};
-      }
-      else if (this->AnalysisMode == Mode::Sparse)
-      {
-        return this->_Read<T>(Offset);
-      }
+        // Not on a known boundary (or no store), decode from the dump directly
+        if (!BufferRead)
+        {
+          Buffer = this->Read(StartOffset, Size);
+          BufferRead = true;
+        }
+
+        std::size_t BufferOffset = static_cast<std::size_t>(Offset - StartOffset);
+
+        if (BufferOffset >= Buffer.size())
+        {
+          return;
+        }
+
+        if (!ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(
+          &this->Decoder,
+          &Context,
+          Buffer.data() + BufferOffset,
+          Buffer.size() - BufferOffset,
+          &Instruction)))
+        {
+          if (!Visit(Offset, static_cast<ZydisDecodedInstruction*>(nullptr), Operands))
+          {
+            return;
+          }
+
+          ++Offset;
+          continue;
+        }
+
+        Operands.SetDecoded(&Context, &Instruction);
 
-      return T{};
+        if (!Visit(Offset, &Instruction, Operands))
+        {
+          return;
+        }
+
+        Offset += Instruction.length;
+      }
     }
 
+    // Mnemonic, operand count and operand checks of a single pattern instruction
+    static bool MatchesInstruction(const MatchInstruction& MIInstruction, const ZydisDecodedInstruction& Instruction, LazyOperands& Lazy);
+
     std::optional<std::string> GetFileVersionInternal() const;
 
     void ExtractAndSavePeHeaderAndSections();
-    void ExtractAndSaveFunctions();
-    void ExtractAndSaveFileVersion();
+    void ExtractCallTargets(std::vector<Function>& Functions) const;
+    void ExtractRuntimeFunctions(std::vector<Function>& Functions) const;
+    void BuildFunctionTable(std::vector<Function>& Functions) const;
+    std::vector<CrossReference> ExtractCrossReferences() const;
 
-    std::vector<PatternElem> ParsePattern(const std::string& PatternStr) const;
-    std::optional<std::uint64_t> FindPattern(const std::vector<uint8_t>& Buffer, const std::vector<PatternElem>& Pattern) const;
+    std::optional<std::string> ComputeFileVersion() const;
+    std::vector<Function> ComputeFunctions() const;
+    std::vector<CrossReference> ComputeCrossReferences() const;
+
+    std::optional<std::uint64_t> ComputeContentHash() const;
+    IndexFile& OpenIndex() const;
+    void MarkIndexDirty() const;
+
+    // Calls Load with a reader over the section if the index file holds it
+    template <typename Loader>
+    bool LoadFromIndex(AnalysisIndex::Section Section, Loader&& Load) const;
+
+    static std::vector<std::uint8_t> EncodeString(const std::string& Str, StringType Type);
+    std::optional<std::uint64_t> FindPattern(const View& Buffer, const CompiledPattern& Pattern) const;
 
   public:
+    // Zero-copy read of dump memory at a (virtual) offset.
+    // The returned view may be shorter than Size if the read runs past the end of the dump.
+    View Read(std::uint64_t Offset, std::size_t Size) const;
+
     const std::vector<pmm::Region>& GetMemoryRegions() const;
     const std::optional<std::string>& GetFileVersion() const;
     const std::optional<PeHeader>& GetPeHeader() const;
     const std::optional<PeSections>& GetPeSections() const;
-    const std::set<std::uint64_t>& GetFunctions() const;
+    const std::vector<Function>& GetFunctions() const;
+
+    // Function whose extent contains Offset, nullptr if none does. O(log n).
+    const Function* FindContainingFunction(std::uint64_t Offset) const;
+    const std::vector<CrossReference>& GetCrossReferences() const;
+
+    // Optional analysis stage, pre-decodes .text once so the instruction scanners
+    // don't re-decode the same code for every search. Costs a few hundred MB on large games.
+    bool BuildInstructionStore();
+
+    // All instructions in .text referencing TargetOffset, in ascending instruction order.
+    Util::Span<const CrossReference> FindCrossReferences(std::uint64_t TargetOffset) const;
+
+    // Resolves all strings in a single pass over .rdata.
+    // Returns the (up to MaxMatches, ascending) match offsets of each query, in query order.
+    std::vector<std::vector<std::uint64_t>> FindStrings(const std::vector<StringQuery>& Queries) const;
 
     template<StringType T = StringType::UTF16_LE>
     std::optional<Result<std::vector<std::uint64_t>>> FindString(const std::string& Str, std::size_t MaxMatches = 1) const;
 
-    std::optional<Result<>> FindPattern(std::uint64_t StartOffset, std::size_t Size, const std::string& IdaPattern) const;
-    std::optional<Result<std::vector<MatchRange>>> FindPatternSubsequence(std::uint64_t StartOffset, std::size_t Size, const std::vector<std::string>& IdaPatterns) const;
+    // Patterns are compiled with CompiledPattern::Parse(), ideally once when the config is loaded.
+    std::optional<Result<>> FindPattern(std::uint64_t StartOffset, std::size_t Size, const CompiledPattern& Pattern) const;
+
+    // Best match of Pattern with at most MaxMismatches mismatching elements (see PatternScanner::FindApproximate),
+    // Value holds its number of mismatches. Same as FindPattern (Value 0) if Pattern matches exactly.
+    std::optional<Result<std::size_t>> FindApproximatePattern(std::uint64_t StartOffset, std::size_t Size,
+      const CompiledPattern& Pattern, std::size_t MaxMismatches) const;
+
+    // Single pass over the window (see GappedPattern), Value holds the range of each element.
+    std::optional<Result<std::vector<MatchRange>>> FindPatternSubsequence(std::uint64_t StartOffset, std::size_t Size, const GappedPattern& Patterns) const;
+
+    // Value of the first capture of Pattern (e.g. "{rel32}") in its match at MatchOffset,
+    // read and resolved straight from the match bytes, nothing is decoded.
+    // Range is the captured bytes. nullopt if Pattern has no captures.
+    std::optional<Result<std::uint64_t>> ExtractCapture(std::uint64_t MatchOffset, const CompiledPattern& Pattern) const;
+
+    // Offsets of all (possibly overlapping) matches in ascending order.
+    // Meant for scanning a whole section once instead of many small windows.
+    std::vector<std::uint64_t> FindPatternMatches(std::uint64_t StartOffset, std::size_t Size, const CompiledPattern& Pattern) const;
     
     std::optional<Result<std::vector<MatchRange>>> FindInstructionSequence(std::uint64_t StartOffset, std::size_t Size, const std::vector<MatchInstruction>& Pattern) const;
     std::optional<Result<std::vector<MatchRange>>> FindInstructionSubsequence(std::uint64_t StartOffset, std::size_t Size, const std::vector<MatchInstruction>& Pattern) const;
 
+    // Runs several instruction (sub)sequence matchers over the same window in a single walk,
+    // each instruction is decoded once for all of them. Results are in matcher order and identical
+    // to calling FindInstructionSequence/FindInstructionSubsequence per matcher.
+    // A match is the one ending first (then starting first), overlapping candidates included.
+    // StopAtFirst ends the walk once the first matcher (in order) that can still match has matched,
+    // the ones after it may then be left unmatched.
+    std::vector<std::optional<Result<std::vector<MatchRange>>>> FindInstructionMatches(std::uint64_t StartOffset, std::size_t Size,
+      const std::vector<InstructionMatcher>& Matchers, bool StopAtFirst = false) const;
+
+    using FilterFunction = std::function<bool(ZydisDecodedInstruction*, ZydisDecodedOperand*)>;
+
+    // Mnemonic (if set) is checked before decoding operands, prefer it over checking the mnemonic in Filter.
+    // Filter only sees instructions with the right mnemonic and at least one operand.
+    // Any callable works as Filter (inlined into the walk), these overloads are kept for std::function callers.
     std::optional<Result<std::uint64_t>> ResolveRipRelativeOffset(std::uint64_t StartOffset, std::size_t Size,
-      std::function<bool(ZydisDecodedInstruction*, ZydisDecodedOperand*)> Filter = nullptr) const;
+      FilterFunction Filter = nullptr, std::optional<ZydisMnemonic> Mnemonic = std::nullopt) const;
     std::optional<Result<std::uint64_t>> FindRipRelativeReference(std::uint64_t StartOffset, std::size_t Size, std::uint64_t TargetDataOffset,
-      std::function<bool(ZydisDecodedInstruction*, ZydisDecodedOperand*)> Filter = nullptr) const;
+      FilterFunction Filter = nullptr, std::optional<ZydisMnemonic> Mnemonic = std::nullopt) const;
+
+    // Resolves the RIP relative address of the first instruction
+    // it encounters that matches the conditions (i.e. RIP + DISP).
+    // InstructionSize should be large enough to hold the full instruction (e.g., 10-15 bytes for x64).
+    template <typename FilterT>
+    std::optional<Result<std::uint64_t>> ResolveRipRelativeOffset(std::uint64_t StartOffset, std::size_t Size,
+      FilterT&& Filter, std::optional<ZydisMnemonic> Mnemonic = std::nullopt) const
+    {
+      std::optional<Result<std::uint64_t>> Resolved;
+
+      this->WalkInstructions(StartOffset, Size,
+        [&](std::uint64_t InstructionOffset, ZydisDecodedInstruction* Decoded, LazyOperands& Lazy)
+      {
+        if (!Decoded)
+        {
+          return true;
+        }
+
+        const ZydisDecodedInstruction& Instruction = *Decoded;
+
+        // Nothing to resolve without operands, skip those (and other mnemonics) before decoding any
+        if (Instruction.operand_count == 0 || (Mnemonic && Instruction.mnemonic != *Mnemonic))
+        {
+          return true;
+        }
+
+        ZydisDecodedOperand* Operands = Lazy.Get();
+
+        if (!Operands)
+        {
+          return true;
+        }
+
+        // Called directly, no std::function in the loop. nullptr means no filter.
+        if constexpr (!std::is_same_v<std::decay_t<FilterT>, std::nullptr_t>)
+        {
+          if (!Filter(Decoded, Operands))
+          {
+            // Filtering out
+            return true;
+          }
+        }
+
+        std::int64_t InstructionEnd = static_cast<std::int64_t>(InstructionOffset + Instruction.length);
+
+        Result<std::uint64_t> Out = {
+          MatchRange{
+            InstructionOffset,
+            Instruction.length
+          }
+        };
+
+        // For now, in 64-bit assembly, only one operand can use RIP relative addressing.
+        // So enumerate over all operands to find it.
+        for (int I = 0; I < Instruction.operand_count; ++I)
+        {
+          const auto& Operand = Operands[I];
+
+          // Displacement relative value
+          if (Operand.type == ZYDIS_OPERAND_TYPE_MEMORY &&
+            Operand.mem.base == ZYDIS_REGISTER_RIP &&
+            Operand.mem.disp.size > 0)
+          {
+            // Do some casting to avoid negative wraparound due to integer promotion (in std::uint64_t)
+            std::int64_t Displacement = static_cast<std::int64_t>(Operand.mem.disp.value);
+            std::uint64_t ResolvedOffset = static_cast<std::uint64_t>(InstructionEnd + Displacement);
+            Out.Value = ResolvedOffset;
+            Resolved = Out;
+            return false;
+          }
+          // Immediate relative value
+          else if (Operand.type == ZYDIS_OPERAND_TYPE_IMMEDIATE &&
+            Operand.imm.is_signed)
+          {
+            std::int64_t Immediate = static_cast<std::int64_t>(Operand.imm.value.s);
+            std::uint64_t ResolvedOffset = static_cast<std::uint64_t>(InstructionEnd + Immediate);
+            Out.Value = ResolvedOffset;
+            Resolved = Out;
+            return false;
+          }
+        }
+
+        return true;
+      });
+
+      // Nullopt if unable to resolve RIP relative address for some reason
+      return Resolved;
+    }
+
+    // TODO:
+    //  Handle negative offsets, for now this is fine since
+    //  we're working mainly with .Text and .Rdata sections.
+    template <typename FilterT>
+    std::optional<Result<std::uint64_t>> FindRipRelativeReference(std::uint64_t StartOffset, std::size_t Size, std::uint64_t TargetOffset,
+      FilterT&& Filter, std::optional<ZydisMnemonic> Mnemonic = std::nullopt) const
+    {
+      std::optional<Result<std::uint64_t>> Reference;
+
+      this->WalkInstructions(StartOffset, Size,
+        [&](std::uint64_t InstructionOffset, ZydisDecodedInstruction* Decoded, LazyOperands& Lazy)
+      {
+        if (!Decoded)
+        {
+          return true;
+        }
+
+        const ZydisDecodedInstruction& Instruction = *Decoded;
+
+        // Nothing to resolve without operands, skip those (and other mnemonics) before decoding any
+        if (Instruction.operand_count == 0 || (Mnemonic && Instruction.mnemonic != *Mnemonic))
+        {
+          return true;
+        }
+
+        ZydisDecodedOperand* Operands = Lazy.Get();
+
+        if (!Operands)
+        {
+          return true;
+        }
+
+        // Called directly, no std::function in the loop. nullptr means no filter.
+        if constexpr (!std::is_same_v<std::decay_t<FilterT>, std::nullptr_t>)
+        {
+          if (!Filter(Decoded, Operands))
+          {
+            // Filtering out
+            return true;
+          }
+        }
+
+        std::int64_t InstructionEnd = static_cast<std::int64_t>(InstructionOffset + Instruction.length);
+
+        // For now, in 64-bit assembly, only one operand can use RIP relative addressing.
+        // So enumerate over all operands to find it.
+        for (int I = 0; I < Instruction.operand_count; ++I)
+        {
+          const auto& Operand = Operands[I];
+          std::uint64_t ResolvedOffset = 0;
+
+          // Displacement relative value
+          if (Operand.type == ZYDIS_OPERAND_TYPE_MEMORY &&
+            Operand.mem.base == ZYDIS_REGISTER_RIP &&
+            Operand.mem.disp.size > 0)
+          {
+            std::int64_t Displacement = static_cast<std::int64_t>(Operand.mem.disp.value);
+            ResolvedOffset = static_cast<std::uint64_t>(InstructionEnd + Displacement);
+          }
+          // Immediate relative value
+          else if (Operand.type == ZYDIS_OPERAND_TYPE_IMMEDIATE &&
+            Operand.imm.is_signed)
+          {
+            std::int64_t Immediate = static_cast<std::int64_t>(Operand.imm.value.s);
+            ResolvedOffset = static_cast<std::uint64_t>(InstructionEnd + Immediate);
+          }
+
+          if (ResolvedOffset == TargetOffset)
+          {
+            Reference = Result<std::uint64_t>{
+              MatchRange{
+                InstructionOffset,
+                Instruction.length,
+              },
+              InstructionOffset
+            };
+
+            return false;
+          }
+        }
+
+        return true;
+      });
+
+      return Reference;
+    }
 
     std::optional<Result<std::uint32_t>> ExtractDisplacement(std::uint64_t StartOffset, std::size_t Size) const;
     std::optional<Result<std::uint64_t>> ExtractImmediate(std::uint64_t StartOffset, std::size_t Size) const;
@@ -323,6 +856,19 @@ namespace COF
     template <typename XorT = std::uint64_t>
     std::optional<Result<std::vector<TslDecryption<XorT>>>> ExtractTslDecryptors(std::uint64_t StartOffset, std::size_t Size = 512) const;
 
+    // Analysis artifacts are cached in <dump>.cofidx and loaded from there
+    // on later runs over the same dump. Enabled by default, set before Analyze().
+    void UseIndex(bool Enable);
+
+    // Adds the artifacts computed so far to the index file, if it lacks any of them.
+    // Called on destruction too.
+    bool SaveIndex();
+
+    // Thread pool for the analysis stages (e.g. the function sweep), shared with the searches
+    void UseThreadPool(std::shared_ptr<ThreadPool> Pool);
+
+    ScanStatistics GetScanStatistics() const;
+
     template <Mode M = Mode::Regions>
     bool Analyze();
     bool Open(const std::string& FilePath);
@@ -0,0 +1,503 @@
+#include "GappedPattern.h"
+
+#include <algorithm>
+#include <sstream>
+#include <cstdlib>
+#include <cctype>
+
+namespace COF
+{
+  namespace PatternScanner
+  {
+    namespace
+    {
+      std::bitset<256> ToSet(PatternElem Elem)
+      {
+        std::bitset<256> Set;
+
+        for (std::size_t Byte = 0; Byte < 256; ++Byte)
+        {
+          if ((Byte & Elem.first) == Elem.second)
+          {
+            Set.set(Byte);
+          }
+        }
+
+        return Set;
+      }
+
+      // Mask of the bits every byte of Set agrees on
+      PatternElem ToElem(const std::bitset<256>& Set)
+      {
+        std::uint8_t And = 0xFF;
+        std::uint8_t Or = 0x00;
+
+        for (std::size_t Byte = 0; Byte < 256; ++Byte)
+        {
+          if (Set.test(Byte))
+          {
+            And &= static_cast<std::uint8_t>(Byte);
+            Or |= static_cast<std::uint8_t>(Byte);
+          }
+        }
+
+        std::uint8_t Mask = static_cast<std::uint8_t>(~(And ^ Or));
+        return { Mask, static_cast<std::uint8_t>(And & Mask) };
+      }
+
+      std::optional<std::uint8_t> ParseByte(const std::string& Token)
+      {
+        auto Elem = ParseElem(Token);
+
+        if (!Elem || Elem->first != 0xFF)
+        {
+          return std::nullopt;
+        }
+
+        return Elem->second;
+      }
+
+      // "(E8|E9)", "(40-4F|E8)", "(4?|E8)"
+      std::optional<std::bitset<256>> ParseSet(const std::string& Token)
+      {
+        if (Token.size() < 3 || Token.front() != '(' || Token.back() != ')')
+        {
+          return std::nullopt;
+        }
+
+        std::bitset<256> Set;
+        std::string Items = Token.substr(1, Token.size() - 2);
+
+        for (std::size_t Start = 0, Bar = 0; Bar != std::string::npos; Start = Bar + 1)
+        {
+          Bar = Items.find('|', Start);
+          std::string Item = Items.substr(Start, (Bar == std::string::npos) ? std::string::npos : Bar - Start);
+          auto Dash = Item.find('-');
+
+          if (Dash != std::string::npos)
+          {
+            // Byte range
+            auto Low = ParseByte(Item.substr(0, Dash));
+            auto High = ParseByte(Item.substr(Dash + 1));
+
+            if (!Low || !High || *Low > *High)
+            {
+              return std::nullopt;
+            }
+
+            for (std::size_t Byte = *Low; Byte <= *High; ++Byte)
+            {
+              Set.set(Byte);
+            }
+          }
+          else if (auto Elem = ParseElem(Item))
+          {
+            Set |= ToSet(*Elem);
+          }
+          else
+          {
+            return std::nullopt;
+          }
+        }
+
+        return Set;
+      }
+
+      std::optional<std::size_t> ParseCount(const std::string& Count)
+      {
+        if (Count.empty() || !std::all_of(Count.begin(), Count.end(), [](unsigned char C) { return std::isdigit(C); }))
+        {
+          return std::nullopt;
+        }
+
+        return static_cast<std::size_t>(std::strtoull(Count.c_str(), nullptr, 10));
+      }
+
+      // "[8]", "[4-16]", "[4-]"
+      std::optional<GappedPattern::Gap> ParseGap(const std::string& Token)
+      {
+        if (Token.size() < 3 || Token.front() != '[' || Token.back() != ']')
+        {
+          return std::nullopt;
+        }
+
+        std::string Body = Token.substr(1, Token.size() - 2);
+        auto Dash = Body.find('-');
+        GappedPattern::Gap Out;
+
+        auto Min = ParseCount(Body.substr(0, Dash));
+
+        if (!Min)
+        {
+          return std::nullopt;
+        }
+
+        Out.Min = *Min;
+        Out.Max = *Min;
+
+        if (Dash != std::string::npos)
+        {
+          std::string MaxString = Body.substr(Dash + 1);
+          auto Max = MaxString.empty() ? std::optional<std::size_t>(GappedPattern::Unbounded) : ParseCount(MaxString);
+
+          if (!Max || *Max < *Min)
+          {
+            return std::nullopt;
+          }
+
+          Out.Max = *Max;
+        }
+
+        return Out;
+      }
+    }
+
+    std::optional<GappedPattern> GappedPattern::Parse(const std::vector<std::string>& ElementPatterns)
+    {
+      GappedPattern Out;
+      std::vector<std::vector<std::bitset<256>>> ElementSets;
+
+      for (std::size_t Element = 0; Element < ElementPatterns.size(); ++Element)
+      {
+        std::istringstream Stream(ElementPatterns[Element]);
+        std::string Token;
+
+        std::vector<std::bitset<256>> Sets;
+        std::vector<PatternElem> Plain;
+        std::vector<Capture> Captures;
+        Gap Before;
+
+        while (Stream >> Token)
+        {
+          if (Token.front() == '[')
+          {
+            // Gap to the previous element, so only leading and not before the first element
+            auto Parsed = ParseGap(Token);
+
+            if (!Parsed || !Element || !Sets.empty())
+            {
+              return std::nullopt;
+            }
+
+            Before = *Parsed;
+          }
+          else if (Token.front() == '{')
+          {
+            // Capture, its bytes are wildcards
+            auto Parsed = Capture::Parse(Token);
+
+            if (!Parsed)
+            {
+              return std::nullopt;
+            }
+
+            Parsed->Offset = Sets.size();
+            Captures.push_back(*Parsed);
+            Sets.insert(Sets.end(), Parsed->Size, std::bitset<256>().set());
+            Plain.insert(Plain.end(), Parsed->Size, PatternElem{ 0x00, 0x00 });
+          }
+          else if (Token.front() == '(')
+          {
+            auto Set = ParseSet(Token);
+
+            if (!Set)
+            {
+              return std::nullopt;
+            }
+
+            Sets.push_back(*Set);
+            Plain.push_back(ToElem(*Set));
+          }
+          else
+          {
+            auto Elem = ParseElem(Token);
+
+            if (!Elem)
+            {
+              return std::nullopt;
+            }
+
+            Sets.push_back(ToSet(*Elem));
+            Plain.push_back(*Elem);
+          }
+        }
+
+        if (Sets.empty())
+        {
+          return std::nullopt;
+        }
+
+        Out.Elements.emplace_back(Plain, std::move(Captures));
+        Out.Gaps.push_back(Before);
+        ElementSets.push_back(std::move(Sets));
+      }
+
+      Out.Build(ElementSets);
+      return Out;
+    }
+
+    void GappedPattern::Build(const std::vector<std::vector<std::bitset<256>>>& ElementSets)
+    {
+      const std::bitset<256> Any = std::bitset<256>().set();
+
+      for (std::size_t Element = 0; Element < ElementSets.size(); ++Element)
+      {
+        if (Element)
+        {
+          const Gap& Before = this->Gaps[Element];
+
+          // Bytes the gap needs at least
+          this->States.insert(this->States.end(), Before.Min, Any);
+          this->Loops.resize(this->States.size(), 0);
+          this->Optional.resize(this->States.size(), 0);
+
+          if (Before.Max == Unbounded)
+          {
+            this->Loops.back() = 1;
+          }
+          else
+          {
+            // Bytes it may have on top of that
+            this->States.insert(this->States.end(), Before.Max - Before.Min, Any);
+            this->Loops.resize(this->States.size(), 0);
+            this->Optional.resize(this->States.size(), 1);
+          }
+        }
+
+        this->ElementStates.push_back(this->States.size());
+        this->States.insert(this->States.end(), ElementSets[Element].begin(), ElementSets[Element].end());
+        this->Loops.resize(this->States.size(), 0);
+        this->Optional.resize(this->States.size(), 0);
+      }
+
+      const std::size_t Count = this->States.size();
+      this->BitParallel = Count > 0 && Count <= 64;
+
+      if (!this->BitParallel)
+      {
+        return;
+      }
+
+      for (std::size_t State = 0; State < Count; ++State)
+      {
+        const std::uint64_t Bit = std::uint64_t{ 1 } << State;
+
+        for (std::size_t Byte = 0; Byte < 256; ++Byte)
+        {
+          if (this->States[State].test(Byte))
+          {
+            this->ByteMasks[Byte] |= Bit;
+          }
+        }
+
+        if (this->Loops[State])
+        {
+          this->LoopMask |= Bit;
+        }
+
+        // Optional states never come first, they always follow an element or mandatory gap byte
+        if (this->Optional[State])
+        {
+          this->OptionalMask |= Bit;
+
+          if (!this->Optional[State - 1])
+          {
+            this->BlockStarts |= Bit >> 1;
+          }
+
+          if (State + 1 == Count || !this->Optional[State + 1])
+          {
+            this->BlockEnds |= Bit;
+          }
+        }
+      }
+
+      this->FinalMask = std::uint64_t{ 1 } << (Count - 1);
+    }
+
+    bool GappedPattern::ElementMatches(std::size_t Element, const std::uint8_t* Data) const
+    {
+      const std::size_t First = this->ElementStates[Element];
+      const std::size_t Size = this->Elements[Element].GetSize();
+
+      for (std::size_t I = 0; I < Size; ++I)
+      {
+        if (!this->States[First + I].test(Data[I]))
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    std::optional<std::size_t> GappedPattern::FindEndBitParallel(const std::uint8_t* Data, std::size_t Size) const
+    {
+      std::uint64_t Active = 0;
+
+      for (std::size_t I = 0; I < Size; ++I)
+      {
+        // Advance every state by one byte (state 0 can start anywhere), unbounded gaps stay active
+        Active = (((Active << 1) | 1) & this->ByteMasks[Data[I]]) | (Active & this->LoopMask);
+
+        if (this->OptionalMask)
+        {
+          // Skip optional states: an active state activates every state after it up to the end of
+          // its optional block. The subtraction only borrows through the inactive states of a block
+          // (BlockEnds stops it), so the xor marks exactly the states after the first active one.
+          std::uint64_t WithEnds = Active | this->BlockEnds;
+          Active |= this->OptionalMask & (~(WithEnds - this->BlockStarts) ^ WithEnds);
+        }
+
+        if (Active & this->FinalMask)
+        {
+          return I + 1;
+        }
+      }
+
+      return std::nullopt;
+    }
+
+    std::optional<std::size_t> GappedPattern::FindEndStates(const std::uint8_t* Data, std::size_t Size) const
+    {
+      const std::size_t Count = this->States.size();
+      std::vector<std::uint8_t> Active(Count, 0);
+      std::vector<std::uint8_t> Next(Count, 0);
+
+      for (std::size_t I = 0; I < Size; ++I)
+      {
+        const std::uint8_t Byte = Data[I];
+
+        for (std::size_t State = 0; State < Count; ++State)
+        {
+          bool Previous = !State || Active[State - 1];
+          Next[State] = (Previous && this->States[State].test(Byte)) || (this->Loops[State] && Active[State]);
+        }
+
+        for (std::size_t State = 1; State < Count; ++State)
+        {
+          if (this->Optional[State] && Next[State - 1])
+          {
+            Next[State] = 1;
+          }
+        }
+
+        if (Next[Count - 1])
+        {
+          return I + 1;
+        }
+
+        std::swap(Active, Next);
+      }
+
+      return std::nullopt;
+    }
+
+    std::optional<GappedPattern::Match> GappedPattern::Align(const std::uint8_t* Data, std::size_t End) const
+    {
+      const std::size_t Last = this->Elements.size() - 1;
+      const std::size_t LastSize = this->Elements[Last].GetSize();
+
+      if (End < LastSize || !this->ElementMatches(Last, Data + End - LastSize))
+      {
+        return std::nullopt;
+      }
+
+      // Going backwards, offsets at which each element matches and the rest can still follow to End
+      std::vector<std::vector<std::size_t>> Candidates(this->Elements.size());
+      Candidates[Last].push_back(End - LastSize);
+
+      for (std::size_t Element = Last; Element-- > 0;)
+      {
+        const auto& Following = Candidates[Element + 1];
+        const Gap& Between = this->Gaps[Element + 1];
+        const std::size_t Size = this->Elements[Element].GetSize();
+
+        if (Following.back() < Size + Between.Min)
+        {
+          return std::nullopt;
+        }
+
+        std::size_t Highest = Following.back() - Size - Between.Min;
+        std::size_t Lowest = (Between.Max == Unbounded || Following.front() < Size + Between.Max)
+          ? 0 : Following.front() - Size - Between.Max;
+
+        for (std::size_t Offset = Lowest; Offset <= Highest; ++Offset)
+        {
+          if (!this->ElementMatches(Element, Data + Offset))
+          {
+            continue;
+          }
+
+          // First following offset past the minimum gap has to be within the maximum one
+          auto It = std::lower_bound(Following.begin(), Following.end(), Offset + Size + Between.Min);
+
+          if (It != Following.end() && (Between.Max == Unbounded || *It - (Offset + Size) <= Between.Max))
+          {
+            Candidates[Element].push_back(Offset);
+          }
+        }
+
+        if (Candidates[Element].empty())
+        {
+          return std::nullopt;
+        }
+      }
+
+      // Going forwards, take the earliest candidate each time
+      Match Out;
+      Out.emplace_back(Candidates[0].front(), this->Elements[0].GetSize());
+
+      for (std::size_t Element = 1; Element <= Last; ++Element)
+      {
+        std::size_t PreviousEnd = Out.back().first + Out.back().second;
+        auto It = std::lower_bound(Candidates[Element].begin(), Candidates[Element].end(), PreviousEnd + this->Gaps[Element].Min);
+        Out.emplace_back(*It, this->Elements[Element].GetSize());
+      }
+
+      return Out;
+    }
+
+    bool GappedPattern::IsEmpty() const
+    {
+      return this->Elements.empty();
+    }
+
+    std::size_t GappedPattern::GetSize() const
+    {
+      return this->Elements.size();
+    }
+
+    bool GappedPattern::IsBitParallel() const
+    {
+      return this->BitParallel;
+    }
+
+    const std::vector<CompiledPattern>& GappedPattern::GetElements() const
+    {
+      return this->Elements;
+    }
+
+    const std::vector<GappedPattern::Gap>& GappedPattern::GetGaps() const
+    {
+      return this->Gaps;
+    }
+
+    std::optional<GappedPattern::Match> GappedPattern::Find(const std::uint8_t* Data, std::size_t Size) const
+    {
+      if (this->IsEmpty())
+      {
+        return std::nullopt;
+      }
+
+      auto End = this->BitParallel ? this->FindEndBitParallel(Data, Size) : this->FindEndStates(Data, Size);
+
+      if (!End)
+      {
+        return std::nullopt;
+      }
+
+      return this->Align(Data, *End);
+    }
+  } // !namespace PatternScanner
+} // !namespace COF
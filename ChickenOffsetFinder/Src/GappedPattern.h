@@ -0,0 +1,95 @@
+#ifndef COF_GAPPED_PATTERN_H
+#define COF_GAPPED_PATTERN_H
+
+#include "PatternScanner.h"
+
+#include <array>
+#include <bitset>
+#include <vector>
+#include <string>
+#include <utility>
+#include <optional>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+
+namespace COF
+{
+  namespace PatternScanner
+  {
+    // Sequence of patterns (elements) with gaps between them, matched in a single pass.
+    // Elements are IDA style patterns (captures included) that may also contain byte sets,
+    // e.g. "(E8|E9)" or "(40-4F|E8)" (no spaces inside the parentheses).
+    // An element may start with a gap bounding its distance to the previous element,
+    // "[4-16]", "[8]" or "[4-]" (at least 4), without one any distance is allowed.
+    //
+    // Compiled to a Shift-And automaton with one state per element byte and bounded gap byte.
+    // Unbounded gaps are self-loops, the bytes of a bounded gap beyond its minimum are optional states.
+    // Up to 64 states run bit-parallel, longer patterns run the same automaton a state at a time.
+    class GappedPattern
+    {
+    public:
+      static constexpr std::size_t Unbounded = (std::numeric_limits<std::size_t>::max)();
+
+      struct Gap
+      {
+        std::size_t Min = 0;
+        std::size_t Max = Unbounded;
+      };
+
+      // Offset and size of each element in a match, relative to the searched data
+      using Match = std::vector<std::pair<std::size_t, std::size_t>>;
+
+    private:
+      // Byte sets approximated by their common bits, for prefiltering and captures
+      std::vector<CompiledPattern> Elements;
+      std::vector<Gap> Gaps;                  // Before each element, Gaps[0] is unused
+      std::vector<std::size_t> ElementStates; // First state of each element
+
+      std::vector<std::bitset<256>> States;   // Bytes accepted by each state
+      std::vector<std::uint8_t> Loops;        // State accepts any number of bytes after it
+      std::vector<std::uint8_t> Optional;     // State can be skipped
+
+      // Shift-And form, only if there are at most 64 states
+      bool BitParallel = false;
+      std::array<std::uint64_t, 256> ByteMasks{};
+      std::uint64_t LoopMask = 0;
+      std::uint64_t OptionalMask = 0;
+      std::uint64_t BlockStarts = 0; // State before each block of optional states
+      std::uint64_t BlockEnds = 0;   // Last state of each block of optional states
+      std::uint64_t FinalMask = 0;
+
+      void Build(const std::vector<std::vector<std::bitset<256>>>& ElementSets);
+
+      bool ElementMatches(std::size_t Element, const std::uint8_t* Data) const;
+
+      std::optional<std::size_t> FindEndBitParallel(const std::uint8_t* Data, std::size_t Size) const;
+      std::optional<std::size_t> FindEndStates(const std::uint8_t* Data, std::size_t Size) const;
+
+      // Element offsets of the earliest starting match ending at End
+      std::optional<Match> Align(const std::uint8_t* Data, std::size_t End) const;
+
+    public:
+      GappedPattern() = default;
+
+      // One string per element, nullopt on invalid tokens, empty elements
+      // or a gap before the first element
+      static std::optional<GappedPattern> Parse(const std::vector<std::string>& ElementPatterns);
+
+      bool IsEmpty() const;
+      std::size_t GetSize() const;
+      bool IsBitParallel() const;
+
+      // Elements as plain patterns, byte sets widened to the bits all their bytes share.
+      // Every match of an element matches its plain pattern, not necessarily the other way around.
+      const std::vector<CompiledPattern>& GetElements() const;
+      const std::vector<Gap>& GetGaps() const;
+
+      // Match ending first in Data, of those the one starting first
+      // (with each element as early as possible).
+      std::optional<Match> Find(const std::uint8_t* Data, std::size_t Size) const;
+    };
+  } // !namespace PatternScanner
+} // !namespace COF
+
+#endif // !COF_GAPPED_PATTERN_H
@@ -0,0 +1,323 @@
+#include "InstructionStore.h"
+#include "AnalysisIndex.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace COF
+{
+  std::size_t InstructionStore::GetCount() const
+  {
+    return this->Offsets.size();
+  }
+
+  std::uint64_t InstructionStore::GetBaseOffset() const
+  {
+    return this->BaseOffset;
+  }
+
+  std::uint64_t InstructionStore::GetEndOffset() const
+  {
+    if (this->Offsets.empty())
+    {
+      return this->BaseOffset;
+    }
+
+    return this->BaseOffset + this->Offsets.back() + this->Lengths.back();
+  }
+
+  bool InstructionStore::IsEmpty() const
+  {
+    return this->Offsets.empty();
+  }
+
+  std::uint64_t InstructionStore::GetOffset(std::size_t Index) const
+  {
+    return this->BaseOffset + this->Offsets[Index];
+  }
+
+  std::uint8_t InstructionStore::GetLength(std::size_t Index) const
+  {
+    return this->Lengths[Index];
+  }
+
+  ZydisMnemonic InstructionStore::GetMnemonic(std::size_t Index) const
+  {
+    return static_cast<ZydisMnemonic>(this->Mnemonics[Index]);
+  }
+
+  std::uint8_t InstructionStore::GetFlags(std::size_t Index) const
+  {
+    return this->Flags[Index];
+  }
+
+  std::size_t InstructionStore::LowerBound(std::uint64_t Offset) const
+  {
+    if (Offset <= this->BaseOffset)
+    {
+      return 0;
+    }
+
+    if (Offset - this->BaseOffset > UINT32_MAX)
+    {
+      return this->Offsets.size();
+    }
+
+    auto It = std::lower_bound(
+      this->Offsets.begin(),
+      this->Offsets.end(),
+      static_cast<std::uint32_t>(Offset - this->BaseOffset)
+    );
+
+    return static_cast<std::size_t>(It - this->Offsets.begin());
+  }
+
+  void InstructionStore::Materialize(std::size_t Index, ZydisDecodedInstruction& Instruction) const
+  {
+    Instruction.mnemonic = static_cast<ZydisMnemonic>(this->Mnemonics[Index]);
+    Instruction.length = this->Lengths[Index];
+    Instruction.operand_count = this->OperandCounts[Index];
+    Instruction.operand_count_visible = this->VisibleCounts[Index];
+    Instruction.operand_width = static_cast<ZyanU8>(this->OperandWidths[Index]);
+    Instruction.attributes = (this->Flags[Index] & InstructionRelative) ? ZYDIS_ATTRIB_IS_RELATIVE : 0;
+    Instruction.machine_mode = ZYDIS_MACHINE_MODE_LONG_64;
+  }
+
+  void InstructionStore::MaterializeOperands(std::size_t Index, ZydisDecodedOperand* Operands) const
+  {
+    const std::uint8_t Count = this->OperandCounts[Index];
+    const std::uint8_t Visible = this->VisibleCounts[Index];
+    const std::uint32_t First = this->FirstOperands[Index];
+    const std::uint8_t Stored = this->StoredCounts[Index];
+
+    for (std::uint8_t I = 0; I < Count; ++I)
+    {
+      ZydisDecodedOperand& Out = Operands[I];
+      std::memset(&Out, 0, sizeof(Out));
+      Out.id = I;
+
+      if (I >= Stored)
+      {
+        Out.type = ZYDIS_OPERAND_TYPE_UNUSED;
+        continue;
+      }
+
+      const Operand& In = this->Operands[First + I];
+
+      Out.type = static_cast<ZydisOperandType>(In.Type);
+      Out.size = In.Width;
+      Out.visibility = (I < Visible)
+        ? ZYDIS_OPERAND_VISIBILITY_EXPLICIT
+        : ZYDIS_OPERAND_VISIBILITY_HIDDEN;
+
+      switch (Out.type)
+      {
+      case ZYDIS_OPERAND_TYPE_REGISTER:
+        Out.reg.value = static_cast<ZydisRegister>(In.Reg);
+        break;
+
+      case ZYDIS_OPERAND_TYPE_MEMORY:
+        Out.mem.type = ZYDIS_MEMOP_TYPE_MEM;
+        Out.mem.base = static_cast<ZydisRegister>(In.Reg);
+        Out.mem.index = static_cast<ZydisRegister>(In.Index);
+        Out.mem.scale = In.Scale;
+        Out.mem.disp.value = In.Value;
+        Out.mem.disp.size = In.ValueSize;
+        break;
+
+      case ZYDIS_OPERAND_TYPE_IMMEDIATE:
+        Out.imm.is_signed = (In.Flags & OperandImmSigned) != 0;
+        Out.imm.is_relative = (In.Flags & OperandImmRelative) != 0;
+        Out.imm.value.s = In.Value;
+        Out.imm.size = In.ValueSize;
+        break;
+
+      default:
+        break;
+      }
+    }
+  }
+
+  void InstructionStore::Build(const ZydisDecoder& Decoder, std::uint64_t BaseOffset, const std::uint8_t* Code, std::size_t Size)
+  {
+    this->Clear();
+    this->BaseOffset = BaseOffset;
+
+    // Offsets are stored as 32-bit deltas, no code section gets anywhere near 4GB.
+    Size = (std::min)(Size, static_cast<std::size_t>(UINT32_MAX));
+
+    // Rough estimate of average instruction length, saves a few reallocations.
+    const std::size_t Estimate = Size / 4;
+    this->Offsets.reserve(Estimate);
+    this->Lengths.reserve(Estimate);
+    this->Mnemonics.reserve(Estimate);
+    this->OperandCounts.reserve(Estimate);
+    this->VisibleCounts.reserve(Estimate);
+    this->OperandWidths.reserve(Estimate);
+    this->Flags.reserve(Estimate);
+    this->FirstOperands.reserve(Estimate);
+    this->StoredCounts.reserve(Estimate);
+    this->Operands.reserve(Estimate * 2);
+
+    ZydisDecodedInstruction Instruction;
+    ZydisDecodedOperand Operands[ZYDIS_MAX_OPERAND_COUNT];
+    std::size_t Offset = 0;
+
+    while (Offset < Size)
+    {
+      if (!ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(&Decoder, nullptr, Code + Offset, Size - Offset, &Instruction)))
+      {
+        // Bytes that don't decode simply leave a gap in the store
+        ++Offset;
+        continue;
+      }
+
+      std::uint8_t InstructionFlags = 0;
+      std::uint8_t Stored = 0;
+
+      if (Instruction.attributes & ZYDIS_ATTRIB_IS_RELATIVE)
+      {
+        InstructionFlags |= InstructionRelative;
+      }
+
+      if (ZYAN_SUCCESS(ZydisDecoderDecodeOperands(&Decoder, nullptr, &Instruction, Operands, Instruction.operand_count)))
+      {
+        // Trailing hidden register operands (flags, implicit stack pointer, etc.)
+        // aren't interesting to any scanner, hidden operands always come last.
+        std::uint8_t Keep = Instruction.operand_count_visible;
+
+        for (std::uint8_t I = Keep; I < Instruction.operand_count; ++I)
+        {
+          if (Operands[I].type == ZYDIS_OPERAND_TYPE_MEMORY
+            || Operands[I].type == ZYDIS_OPERAND_TYPE_IMMEDIATE)
+          {
+            Keep = I + 1;
+          }
+        }
+
+        for (std::uint8_t I = 0; I < Keep; ++I)
+        {
+          const ZydisDecodedOperand& In = Operands[I];
+          Operand Out;
+          Out.Type = static_cast<std::uint8_t>(In.type);
+          Out.Width = In.size;
+
+          switch (In.type)
+          {
+          case ZYDIS_OPERAND_TYPE_REGISTER:
+            Out.Reg = static_cast<std::uint16_t>(In.reg.value);
+            break;
+
+          case ZYDIS_OPERAND_TYPE_MEMORY:
+            Out.Reg = static_cast<std::uint16_t>(In.mem.base);
+            Out.Index = static_cast<std::uint16_t>(In.mem.index);
+            Out.Scale = In.mem.scale;
+            Out.Value = In.mem.disp.value;
+            Out.ValueSize = In.mem.disp.size;
+            break;
+
+          case ZYDIS_OPERAND_TYPE_IMMEDIATE:
+            Out.Value = In.imm.value.s;
+            Out.ValueSize = In.imm.size;
+            Out.Flags = static_cast<std::uint8_t>(
+              (In.imm.is_signed ? OperandImmSigned : 0) |
+              (In.imm.is_relative ? OperandImmRelative : 0)
+            );
+            break;
+
+          default:
+            break;
+          }
+
+          this->Operands.push_back(Out);
+          ++Stored;
+        }
+      }
+      else
+      {
+        InstructionFlags |= InstructionOperandsFailed;
+      }
+
+      this->Offsets.push_back(static_cast<std::uint32_t>(Offset));
+      this->Lengths.push_back(Instruction.length);
+      this->Mnemonics.push_back(static_cast<std::uint16_t>(Instruction.mnemonic));
+      this->OperandCounts.push_back(Instruction.operand_count);
+      this->VisibleCounts.push_back(Instruction.operand_count_visible);
+      this->OperandWidths.push_back(Instruction.operand_width);
+      this->Flags.push_back(InstructionFlags);
+      this->FirstOperands.push_back(static_cast<std::uint32_t>(this->Operands.size() - Stored));
+      this->StoredCounts.push_back(Stored);
+
+      Offset += Instruction.length;
+    }
+
+    this->Operands.shrink_to_fit();
+  }
+
+  void InstructionStore::Clear()
+  {
+    this->BaseOffset = 0;
+    this->Offsets.clear();
+    this->Lengths.clear();
+    this->Mnemonics.clear();
+    this->OperandCounts.clear();
+    this->VisibleCounts.clear();
+    this->OperandWidths.clear();
+    this->Flags.clear();
+    this->FirstOperands.clear();
+    this->StoredCounts.clear();
+    this->Operands.clear();
+  }
+
+  void InstructionStore::Save(AnalysisIndex::Writer& Out) const
+  {
+    Out.Write(this->BaseOffset);
+    Out.WriteArray(this->Offsets);
+    Out.WriteArray(this->Lengths);
+    Out.WriteArray(this->Mnemonics);
+    Out.WriteArray(this->OperandCounts);
+    Out.WriteArray(this->VisibleCounts);
+    Out.WriteArray(this->OperandWidths);
+    Out.WriteArray(this->Flags);
+    Out.WriteArray(this->FirstOperands);
+    Out.WriteArray(this->StoredCounts);
+    Out.WriteArray(this->Operands);
+  }
+
+  bool InstructionStore::Load(AnalysisIndex::Reader& In)
+  {
+    In.Read(this->BaseOffset);
+    In.ReadArray(this->Offsets);
+    In.ReadArray(this->Lengths);
+    In.ReadArray(this->Mnemonics);
+    In.ReadArray(this->OperandCounts);
+    In.ReadArray(this->VisibleCounts);
+    In.ReadArray(this->OperandWidths);
+    In.ReadArray(this->Flags);
+    In.ReadArray(this->FirstOperands);
+    In.ReadArray(this->StoredCounts);
+    In.ReadArray(this->Operands);
+
+    const std::size_t Count = this->Offsets.size();
+
+    // Materialize() trusts the arrays, so don't accept anything inconsistent
+    bool Consistent = In.Good() &&
+      this->Lengths.size() == Count && this->Mnemonics.size() == Count &&
+      this->OperandCounts.size() == Count && this->VisibleCounts.size() == Count &&
+      this->OperandWidths.size() == Count && this->Flags.size() == Count &&
+      this->FirstOperands.size() == Count && this->StoredCounts.size() == Count;
+
+    for (std::size_t I = 0; Consistent && I < Count; ++I)
+    {
+      Consistent = this->StoredCounts[I] <= ZYDIS_MAX_OPERAND_COUNT &&
+        static_cast<std::size_t>(this->FirstOperands[I]) + this->StoredCounts[I] <= this->Operands.size();
+    }
+
+    if (!Consistent)
+    {
+      this->Clear();
+    }
+
+    return Consistent;
+  }
+} // !namespace COF
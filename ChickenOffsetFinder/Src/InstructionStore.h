@@ -0,0 +1,97 @@
+#ifndef COF_INSTRUCTION_STORE_H
+#define COF_INSTRUCTION_STORE_H
+
+#include <Zydis/Zydis.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace COF
+{
+  namespace AnalysisIndex
+  {
+    class Writer;
+    class Reader;
+  }
+
+  // Compact struct-of-arrays store of pre-decoded instructions.
+  // A code section is decoded once (linear sweep) and the scanners in DumpAnalyzer
+  // iterate the store instead of re-decoding the same bytes for every region.
+  class InstructionStore
+  {
+  public:
+    // Packed summary of a decoded operand (16 bytes instead of ~80)
+    struct Operand
+    {
+      std::int64_t Value = 0;   // Immediate value or memory displacement
+      std::uint16_t Reg = 0;    // Register, or base register of memory operands
+      std::uint16_t Index = 0;  // Index register of memory operands
+      std::uint16_t Width = 0;  // Operand size in bits
+      std::uint8_t Type = 0;    // ZydisOperandType
+      std::uint8_t Scale = 0;   // Scale of memory operands
+      std::uint8_t Flags = 0;   // See Operand* flags below
+      std::uint8_t ValueSize = 0; // Size of Value (immediate or displacement) in bits
+    };
+
+    enum : std::uint8_t
+    {
+      OperandImmSigned = 1 << 0,
+      OperandImmRelative = 1 << 1
+    };
+
+    enum : std::uint8_t
+    {
+      InstructionRelative = 1 << 0,     // ZYDIS_ATTRIB_IS_RELATIVE
+      InstructionOperandsFailed = 1 << 1 // Operands could not be decoded
+    };
+
+  private:
+    std::uint64_t BaseOffset = 0;
+
+    // Per instruction arrays
+    std::vector<std::uint32_t> Offsets;     // Relative to BaseOffset
+    std::vector<std::uint8_t> Lengths;
+    std::vector<std::uint16_t> Mnemonics;
+    std::vector<std::uint8_t> OperandCounts; // All operands (incl. hidden)
+    std::vector<std::uint8_t> VisibleCounts;
+    std::vector<std::uint16_t> OperandWidths;
+    std::vector<std::uint8_t> Flags;
+    std::vector<std::uint32_t> FirstOperands; // Index into Operands
+    std::vector<std::uint8_t> StoredCounts;   // Operands actually stored
+
+    // Visible operands, plus hidden operands up to the last hidden memory/immediate one
+    // (trailing hidden register operands are dropped to save space).
+    std::vector<Operand> Operands;
+
+  public:
+    std::size_t GetCount() const;
+    std::uint64_t GetBaseOffset() const;
+    std::uint64_t GetEndOffset() const;
+    bool IsEmpty() const;
+
+    std::uint64_t GetOffset(std::size_t Index) const;
+    std::uint8_t GetLength(std::size_t Index) const;
+    ZydisMnemonic GetMnemonic(std::size_t Index) const;
+    std::uint8_t GetFlags(std::size_t Index) const;
+
+    // Index of the first instruction at or after Offset (GetCount() if none)
+    std::size_t LowerBound(std::uint64_t Offset) const;
+
+    // Rebuild the Zydis structures (the fields the scanners use) of an instruction.
+    // Operands are separate, scanners only need them for instructions passing their mnemonic checks.
+    // Dropped hidden register operands are reported as ZYDIS_OPERAND_TYPE_UNUSED.
+    void Materialize(std::size_t Index, ZydisDecodedInstruction& Instruction) const;
+    void MaterializeOperands(std::size_t Index, ZydisDecodedOperand* Operands) const;
+
+    // Decodes Size bytes of Code located at (virtual) BaseOffset
+    void Build(const ZydisDecoder& Decoder, std::uint64_t BaseOffset, const std::uint8_t* Code, std::size_t Size);
+    void Clear();
+
+    // Persistence in the analysis index file (see AnalysisIndex.h)
+    void Save(AnalysisIndex::Writer& Out) const;
+    bool Load(AnalysisIndex::Reader& In);
+  };
+} // !namespace COF
+
+#endif // !COF_INSTRUCTION_STORE_H
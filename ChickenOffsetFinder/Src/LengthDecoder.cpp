@@ -0,0 +1,447 @@
+#include "LengthDecoder.h"
+
+#include <array>
+#include <algorithm>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+
+namespace COF
+{
+  namespace LengthDecoder
+  {
+    namespace
+    {
+      // One-byte opcode map flags
+      enum : std::uint8_t
+      {
+        ImmNone,
+        ImmByte,
+        ImmWord,
+        ImmFull,  // Iz: 16 or 32 bits
+        ImmMov,   // Iv of mov r, imm: 16, 32 or 64 bits
+        ImmEnter, // Iw, Ib
+        ImmRel8,
+        ImmRel32,
+        ImmMask = 0x0F,
+
+        HasModRM = 1 << 4,
+        Supported = 1 << 5,
+        Grouped = 1 << 6, // Validity (or immediate) depends on ModRM, see IsValidGroup()
+        AllowRep = 1 << 7 // Valid with F2/F3 prefixes
+      };
+
+      // Two-byte (0F) opcode map flags.
+      // The prefix bits list the mandatory prefixes (66/F3/F2, or none) the opcode is decoded with.
+      enum : std::uint8_t
+      {
+        Imm0FNone,
+        Imm0FByte,
+        Imm0FRel32,
+        Imm0FMask = 0x03,
+
+        HasModRM0F = 1 << 2,
+        Grouped0F = 1 << 3,
+
+        PrefixNone = 1 << 4,
+        Prefix66 = 1 << 5,
+        PrefixF3 = 1 << 6,
+        PrefixF2 = 1 << 7,
+        PrefixNone66 = PrefixNone | Prefix66,
+        PrefixAll = PrefixNone | Prefix66 | PrefixF3 | PrefixF2
+      };
+
+      using Table = std::array<std::uint8_t, 256>;
+
+      constexpr void Set(Table& Entries, unsigned First, unsigned Last, std::uint8_t Flags)
+      {
+        for (unsigned Opcode = First; Opcode <= Last; ++Opcode)
+        {
+          Entries[Opcode] = Flags;
+        }
+      }
+
+      constexpr Table BuildOneByteTable()
+      {
+        Table Entries{};
+
+        // add, or, adc, sbb, and, sub, xor, cmp
+        for (unsigned Base = 0x00; Base <= 0x38; Base += 0x08)
+        {
+          Set(Entries, Base, Base + 3, Supported | HasModRM);
+          Set(Entries, Base + 4, Base + 4, Supported | ImmByte);
+          Set(Entries, Base + 5, Base + 5, Supported | ImmFull);
+        }
+
+        Set(Entries, 0x50, 0x5F, Supported);                     // push, pop
+        Set(Entries, 0x63, 0x63, Supported | HasModRM);          // movsxd
+        Set(Entries, 0x68, 0x68, Supported | ImmFull);           // push Iz
+        Set(Entries, 0x69, 0x69, Supported | HasModRM | ImmFull);// imul Iz
+        Set(Entries, 0x6A, 0x6A, Supported | ImmByte);           // push Ib
+        Set(Entries, 0x6B, 0x6B, Supported | HasModRM | ImmByte);// imul Ib
+        Set(Entries, 0x6C, 0x6F, Supported | AllowRep);          // ins, outs
+        Set(Entries, 0x70, 0x7F, Supported | ImmRel8);           // jcc rel8
+        Set(Entries, 0x80, 0x80, Supported | HasModRM | ImmByte);
+        Set(Entries, 0x81, 0x81, Supported | HasModRM | ImmFull);
+        Set(Entries, 0x83, 0x83, Supported | HasModRM | ImmByte);
+        Set(Entries, 0x84, 0x8B, Supported | HasModRM);          // test, xchg, mov
+        Set(Entries, 0x8D, 0x8D, Supported | HasModRM | Grouped);// lea
+        Set(Entries, 0x8F, 0x8F, Supported | HasModRM | Grouped);// pop Ev
+        Set(Entries, 0x90, 0x99, Supported);                     // nop, xchg, cwde, cdq
+        Set(Entries, 0x9C, 0x9D, Supported);                     // pushf, popf
+        Set(Entries, 0xA4, 0xA7, Supported | AllowRep);          // movs, cmps
+        Set(Entries, 0xA8, 0xA8, Supported | ImmByte);           // test al
+        Set(Entries, 0xA9, 0xA9, Supported | ImmFull);           // test eax
+        Set(Entries, 0xAA, 0xAF, Supported | AllowRep);          // stos, lods, scas
+        Set(Entries, 0xB0, 0xB7, Supported | ImmByte);           // mov r8, imm8
+        Set(Entries, 0xB8, 0xBF, Supported | ImmMov);            // mov r, imm
+        Set(Entries, 0xC0, 0xC1, Supported | HasModRM | Grouped | ImmByte); // shift Ib
+        Set(Entries, 0xC2, 0xC2, Supported | ImmWord);           // ret Iw
+        Set(Entries, 0xC3, 0xC3, Supported);                     // ret
+        Set(Entries, 0xC6, 0xC6, Supported | HasModRM | Grouped | ImmByte); // mov Eb, Ib
+        Set(Entries, 0xC7, 0xC7, Supported | HasModRM | Grouped | ImmFull); // mov Ev, Iz
+        Set(Entries, 0xC8, 0xC8, Supported | ImmEnter);          // enter
+        Set(Entries, 0xC9, 0xC9, Supported);                     // leave
+        Set(Entries, 0xCA, 0xCA, Supported | ImmWord);           // retf Iw
+        Set(Entries, 0xCB, 0xCC, Supported);                     // retf, int3
+        Set(Entries, 0xCD, 0xCD, Supported | ImmByte);           // int Ib
+        Set(Entries, 0xCF, 0xCF, Supported);                     // iret
+        Set(Entries, 0xD0, 0xD3, Supported | HasModRM | Grouped);// shift 1/cl
+        Set(Entries, 0xD7, 0xD7, Supported);                     // xlat
+        Set(Entries, 0xE0, 0xE3, Supported | ImmRel8);           // loop*, jrcxz
+        Set(Entries, 0xE4, 0xE7, Supported | ImmByte);           // in, out Ib
+        Set(Entries, 0xE8, 0xE9, Supported | ImmRel32);          // call, jmp rel32
+        Set(Entries, 0xEB, 0xEB, Supported | ImmRel8);           // jmp rel8
+        Set(Entries, 0xEC, 0xEF, Supported);                     // in, out dx
+        Set(Entries, 0xF1, 0xF1, Supported);                     // int1
+        Set(Entries, 0xF4, 0xF5, Supported);                     // hlt, cmc
+        Set(Entries, 0xF6, 0xF7, Supported | HasModRM | Grouped);// test/not/neg/mul/div (test has an immediate)
+        Set(Entries, 0xF8, 0xFD, Supported);                     // clc .. std
+        Set(Entries, 0xFE, 0xFF, Supported | HasModRM | Grouped);// inc/dec/call/jmp/push
+
+        // Left unsupported: opcodes invalid in 64-bit mode, VEX/EVEX/XOP (C4, C5, 62, 8F /1-7),
+        // x87 (D8-DF, fwait), moffs movs (A0-A3), segment register movs (8C, 8E), lahf/sahf, prefixes.
+        return Entries;
+      }
+
+      constexpr Table BuildTwoByteTable()
+      {
+        Table Entries{};
+
+        Set(Entries, 0x05, 0x05, PrefixNone);                    // syscall
+        Set(Entries, 0x0B, 0x0B, PrefixNone);                    // ud2
+        Set(Entries, 0x10, 0x11, PrefixAll | HasModRM0F);        // movups/upd/ss/sd
+        Set(Entries, 0x14, 0x15, PrefixNone66 | HasModRM0F);     // unpcklps/pd, unpckhps/pd
+        Set(Entries, 0x1F, 0x1F, PrefixNone66 | HasModRM0F);     // nop Ev
+        Set(Entries, 0x28, 0x29, PrefixNone66 | HasModRM0F);     // movaps/pd
+        Set(Entries, 0x2A, 0x2A, PrefixAll | HasModRM0F);        // cvt*2ps/pd/ss/sd
+        Set(Entries, 0x2C, 0x2D, PrefixAll | HasModRM0F);        // cvt(t)*
+        Set(Entries, 0x2E, 0x2F, PrefixNone66 | HasModRM0F);     // (u)comiss/sd
+        Set(Entries, 0x31, 0x31, PrefixNone);                    // rdtsc
+        Set(Entries, 0x40, 0x4F, PrefixNone66 | HasModRM0F);     // cmovcc
+        Set(Entries, 0x51, 0x51, PrefixAll | HasModRM0F);        // sqrt
+        Set(Entries, 0x52, 0x53, PrefixNone | PrefixF3 | HasModRM0F); // rsqrt, rcp
+        Set(Entries, 0x54, 0x57, PrefixNone66 | HasModRM0F);     // and, andn, or, xor
+        Set(Entries, 0x58, 0x5A, PrefixAll | HasModRM0F);        // add, mul, cvt
+        Set(Entries, 0x5B, 0x5B, PrefixNone66 | PrefixF3 | HasModRM0F); // cvtdq2ps, cvt(t)ps2dq
+        Set(Entries, 0x5C, 0x5F, PrefixAll | HasModRM0F);        // sub, min, div, max
+        Set(Entries, 0x60, 0x6B, PrefixNone66 | HasModRM0F);     // punpck*, pack*, pcmpgt*
+        Set(Entries, 0x6C, 0x6D, Prefix66 | HasModRM0F);         // punpckl/hqdq
+        Set(Entries, 0x6E, 0x6E, PrefixNone66 | HasModRM0F);     // movd/q
+        Set(Entries, 0x6F, 0x6F, PrefixNone66 | PrefixF3 | HasModRM0F); // movq, movdqa, movdqu
+        Set(Entries, 0x70, 0x70, PrefixAll | HasModRM0F | Imm0FByte);   // pshufw/d/hw/lw
+        Set(Entries, 0x74, 0x76, PrefixNone66 | HasModRM0F);     // pcmpeq*
+        Set(Entries, 0x7E, 0x7F, PrefixNone66 | PrefixF3 | HasModRM0F); // movd/q, movq, movdqa, movdqu
+        Set(Entries, 0x80, 0x8F, PrefixNone | Imm0FRel32);       // jcc rel32
+        Set(Entries, 0x90, 0x9F, PrefixNone | HasModRM0F | Grouped0F);  // setcc
+        Set(Entries, 0xA2, 0xA2, PrefixNone);                    // cpuid
+        Set(Entries, 0xA3, 0xA3, PrefixNone66 | HasModRM0F);     // bt
+        Set(Entries, 0xA4, 0xA4, PrefixNone66 | HasModRM0F | Imm0FByte); // shld Ib
+        Set(Entries, 0xA5, 0xA5, PrefixNone66 | HasModRM0F);     // shld cl
+        Set(Entries, 0xAB, 0xAB, PrefixNone66 | HasModRM0F);     // bts
+        Set(Entries, 0xAC, 0xAC, PrefixNone66 | HasModRM0F | Imm0FByte); // shrd Ib
+        Set(Entries, 0xAD, 0xAD, PrefixNone66 | HasModRM0F);     // shrd cl
+        Set(Entries, 0xAF, 0xAF, PrefixNone66 | HasModRM0F);     // imul
+        Set(Entries, 0xB0, 0xB1, PrefixNone66 | HasModRM0F);     // cmpxchg
+        Set(Entries, 0xB3, 0xB3, PrefixNone66 | HasModRM0F);     // btr
+        Set(Entries, 0xB6, 0xB7, PrefixNone66 | HasModRM0F);     // movzx
+        Set(Entries, 0xB8, 0xB8, PrefixF3 | HasModRM0F);         // popcnt
+        Set(Entries, 0xBA, 0xBA, PrefixNone66 | HasModRM0F | Grouped0F | Imm0FByte); // bt* Ib
+        Set(Entries, 0xBB, 0xBB, PrefixNone66 | HasModRM0F);     // btc
+        Set(Entries, 0xBC, 0xBD, PrefixNone66 | PrefixF3 | HasModRM0F); // bsf/bsr, tzcnt/lzcnt
+        Set(Entries, 0xBE, 0xBF, PrefixNone66 | HasModRM0F);     // movsx
+        Set(Entries, 0xC0, 0xC1, PrefixNone66 | HasModRM0F);     // xadd
+        Set(Entries, 0xC2, 0xC2, PrefixAll | HasModRM0F | Imm0FByte); // cmpps/pd/ss/sd
+        Set(Entries, 0xC6, 0xC6, PrefixNone66 | HasModRM0F | Imm0FByte); // shufps/pd
+        Set(Entries, 0xC8, 0xCF, PrefixNone);                    // bswap
+        Set(Entries, 0xD1, 0xD5, PrefixNone66 | HasModRM0F);     // psrl*, paddq, pmullw
+        Set(Entries, 0xD6, 0xD6, Prefix66 | HasModRM0F);         // movq
+        Set(Entries, 0xD8, 0xDF, PrefixNone66 | HasModRM0F);     // psubus*, pminub, pand, paddus*, pmaxub, pandn
+        Set(Entries, 0xE0, 0xE5, PrefixNone66 | HasModRM0F);     // pavg*, psra*, pmulh*
+        Set(Entries, 0xE8, 0xEF, PrefixNone66 | HasModRM0F);     // psubs*, pminsw, por, padds*, pmaxsw, pxor
+        Set(Entries, 0xF1, 0xF6, PrefixNone66 | HasModRM0F);     // psll*, pmuludq, pmaddwd, psadbw
+        Set(Entries, 0xF8, 0xFE, PrefixNone66 | HasModRM0F);     // psub*, padd*
+
+        return Entries;
+      }
+
+      constexpr Table OneByteTable = BuildOneByteTable();
+      constexpr Table TwoByteTable = BuildTwoByteTable();
+
+      bool IsPrefix(std::uint8_t Byte)
+      {
+        switch (Byte)
+        {
+        case 0x26: case 0x2E: case 0x36: case 0x3E: case 0x64: case 0x65:
+        case 0x66: case 0x67: case 0xF0: case 0xF2: case 0xF3:
+          return true;
+        default:
+          return (Byte & 0xF0) == 0x40; // REX
+        }
+      }
+
+      // Opcodes whose validity (or immediate) depends on ModRM, as Zydis decodes them
+      bool IsValidGroup(bool TwoByte, std::uint8_t Opcode, std::uint8_t Mod, std::uint8_t Reg)
+      {
+        if (TwoByte)
+        {
+          if (Opcode >= 0x90 && Opcode <= 0x9F)
+          {
+            return Reg == 0; // setcc
+          }
+
+          return Opcode == 0xBA && Reg >= 4; // bt, bts, btr, btc Ib
+        }
+
+        switch (Opcode)
+        {
+        case 0x8D: return Mod != 3;  // lea needs a memory operand
+        case 0x8F: return Reg == 0;  // Otherwise XOP
+        case 0xC0: case 0xC1:
+        case 0xD0: case 0xD1: case 0xD2: case 0xD3:
+          return Reg != 6;           // Undocumented sal alias
+        case 0xC6: case 0xC7:
+          return Reg == 0;           // xabort, xbegin otherwise
+        case 0xF6: case 0xF7:
+          return Reg != 1;           // Undocumented test alias
+        case 0xFE:
+          return Reg < 2;            // inc, dec
+        case 0xFF:
+          return Reg != 3 && Reg != 5 && Reg != 7; // No far call/jmp
+        default:
+          return false;
+        }
+      }
+    }
+
+    std::optional<Instruction> Decode(const std::uint8_t* Code, std::size_t Size)
+    {
+      constexpr std::size_t MaxLength = 15;
+      const std::size_t Limit = (std::min)(Size, MaxLength);
+
+      std::size_t Offset = 0;
+      bool OperandSize = false;
+      bool RepF2 = false;
+      bool RepF3 = false;
+      std::uint8_t Rex = 0;
+
+      // Legacy prefixes. LOCK is left to Zydis, it validates lockable instructions.
+      for (; Offset < Limit; ++Offset)
+      {
+        const std::uint8_t Byte = Code[Offset];
+
+        if (Byte == 0x66)
+        {
+          OperandSize = true;
+        }
+        else if (Byte == 0xF2)
+        {
+          RepF2 = true;
+        }
+        else if (Byte == 0xF3)
+        {
+          RepF3 = true;
+        }
+        else if (Byte != 0x67 && Byte != 0x26 && Byte != 0x2E && Byte != 0x36 &&
+          Byte != 0x3E && Byte != 0x64 && Byte != 0x65)
+        {
+          break;
+        }
+      }
+
+      if (Offset < Limit && (Code[Offset] & 0xF0) == 0x40)
+      {
+        Rex = Code[Offset++];
+      }
+
+      // A REX followed by another prefix is ignored, leave that to Zydis too
+      if (Offset >= Limit || IsPrefix(Code[Offset]))
+      {
+        return std::nullopt;
+      }
+
+      const bool RexW = (Rex & 0x08) != 0;
+      const bool TwoByte = Code[Offset] == 0x0F;
+
+      if (TwoByte && ++Offset >= Limit)
+      {
+        return std::nullopt;
+      }
+
+      const std::uint8_t Opcode = Code[Offset++];
+
+      Instruction Result;
+      bool ModRMPresent = false;
+      bool IsGrouped = false;
+      std::size_t ImmSize = 0;
+      bool Branch = false;
+
+      if (!TwoByte)
+      {
+        const std::uint8_t Flags = OneByteTable[Opcode];
+
+        if (!(Flags & Supported))
+        {
+          return std::nullopt;
+        }
+
+        if ((RepF2 || RepF3) && !(Flags & AllowRep) && !(Opcode == 0x90 && RepF3 && !RepF2))
+        {
+          return std::nullopt; // Mandatory prefix (pause is fine), bnd or plain invalid
+        }
+
+        ModRMPresent = (Flags & HasModRM) != 0;
+        IsGrouped = (Flags & Grouped) != 0;
+
+        switch (Flags & ImmMask)
+        {
+        case ImmByte: ImmSize = 1; break;
+        case ImmWord: ImmSize = 2; break;
+        case ImmFull: ImmSize = (OperandSize && !RexW) ? 2 : 4; break;
+        case ImmMov: ImmSize = RexW ? 8 : (OperandSize ? 2 : 4); break;
+        case ImmEnter: ImmSize = 3; break;
+        case ImmRel8: ImmSize = 1; Branch = true; break;
+        case ImmRel32: ImmSize = 4; Branch = true; break;
+        default: break;
+        }
+
+        if (Opcode == 0xE8)
+        {
+          Result.OpcodeClass = Class::CallRel32;
+        }
+        else if (Opcode == 0xE9 || Opcode == 0xEB)
+        {
+          Result.OpcodeClass = Class::JmpRel;
+        }
+        else if (Branch)
+        {
+          Result.OpcodeClass = Class::CondRel;
+        }
+      }
+      else
+      {
+        const std::uint8_t Flags = TwoByteTable[Opcode];
+
+        if ((RepF2 && RepF3) || (OperandSize && (RepF2 || RepF3)))
+        {
+          return std::nullopt; // Competing mandatory prefixes
+        }
+
+        const std::uint8_t Prefix = RepF3 ? PrefixF3 : RepF2 ? PrefixF2 : OperandSize ? Prefix66 : PrefixNone;
+
+        if (!(Flags & Prefix))
+        {
+          return std::nullopt;
+        }
+
+        ModRMPresent = (Flags & HasModRM0F) != 0;
+        IsGrouped = (Flags & Grouped0F) != 0;
+
+        switch (Flags & Imm0FMask)
+        {
+        case Imm0FByte: ImmSize = 1; break;
+        case Imm0FRel32: ImmSize = 4; Branch = true; Result.OpcodeClass = Class::CondRel; break;
+        default: break;
+        }
+      }
+
+      // Operand size overrides on branches differ between vendors (and decoders)
+      if (Branch && OperandSize)
+      {
+        return std::nullopt;
+      }
+
+      if (ModRMPresent)
+      {
+        if (Offset >= Limit)
+        {
+          return std::nullopt;
+        }
+
+        const std::uint8_t ModRM = Code[Offset++];
+        const std::uint8_t Mod = ModRM >> 6;
+        const std::uint8_t Reg = (ModRM >> 3) & 7;
+        const std::uint8_t Rm = ModRM & 7;
+
+        if (IsGrouped && !IsValidGroup(TwoByte, Opcode, Mod, Reg))
+        {
+          return std::nullopt;
+        }
+
+        // test is the only one of its group with an immediate
+        if (!TwoByte && (Opcode == 0xF6 || Opcode == 0xF7) && Reg == 0)
+        {
+          ImmSize = (Opcode == 0xF6) ? 1 : ((OperandSize && !RexW) ? 2 : 4);
+        }
+
+        if (Mod != 3)
+        {
+          if (Rm == 4)
+          {
+            if (Offset >= Limit)
+            {
+              return std::nullopt;
+            }
+
+            const std::uint8_t Sib = Code[Offset++];
+
+            if (Mod == 0 && (Sib & 7) == 5)
+            {
+              Offset += 4; // disp32, no base
+            }
+          }
+          else if (Mod == 0 && Rm == 5)
+          {
+            Result.RipRelative = true;
+            Result.DispOffset = static_cast<std::uint8_t>(Offset);
+            Offset += 4;
+          }
+
+          if (Mod == 1)
+          {
+            Offset += 1;
+          }
+          else if (Mod == 2)
+          {
+            Offset += 4;
+          }
+        }
+      }
+
+      if (Branch)
+      {
+        Result.BranchOffset = static_cast<std::uint8_t>(Offset);
+      }
+
+      Offset += ImmSize;
+
+      if (Offset > Limit)
+      {
+        return std::nullopt;
+      }
+
+      Result.Length = static_cast<std::uint8_t>(Offset);
+      return Result;
+    }
+  } // !namespace LengthDecoder
+} // !namespace COF
@@ -0,0 +1,47 @@
+#ifndef COF_LENGTH_DECODER_H
+#define COF_LENGTH_DECODER_H
+
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+
+namespace COF
+{
+  // Table driven x86-64 instruction length decoder for linear sweeps that only need
+  // instruction boundaries and a few opcode classes, not operands.
+  // Only covers encodings it can decode with certainty (the bulk of compiled code):
+  // legacy/REX prefixed one-byte and common two-byte opcodes. Everything else
+  // (VEX/EVEX/XOP, x87, 0F38/0F3A maps, LOCK, rare or partially invalid opcodes) is left to Zydis,
+  // so a sweep falling back to Zydis on nullopt walks exactly the same boundaries as a Zydis sweep.
+  namespace LengthDecoder
+  {
+    enum class Class : std::uint8_t
+    {
+      Other,
+      CallRel32, // call rel32
+      JmpRel,    // jmp rel8/rel32
+      CondRel    // jcc rel8/rel32, loop*, jrcxz
+    };
+
+    struct Instruction
+    {
+      std::uint8_t Length = 0;
+      Class OpcodeClass = Class::Other;
+      bool RipRelative = false;       // Memory operand is [rip+disp32]
+      std::uint8_t DispOffset = 0;    // Offset of disp32 if RipRelative
+      std::uint8_t BranchOffset = 0;  // Offset of the relative immediate of branches
+
+      // Same meaning as ZYDIS_ATTRIB_IS_RELATIVE
+      bool IsRelative() const
+      {
+        return this->RipRelative || this->OpcodeClass != Class::Other;
+      }
+    };
+
+    // Decodes the instruction at Code (Size bytes available).
+    // nullopt if the encoding isn't covered (or invalid), decode it with Zydis then.
+    std::optional<Instruction> Decode(const std::uint8_t* Code, std::size_t Size);
+  } // !namespace LengthDecoder
+} // !namespace COF
+
+#endif // !COF_LENGTH_DECODER_H
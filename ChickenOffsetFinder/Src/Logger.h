@@ -15,6 +15,7 @@
 #include <fstream>
 #include <stdarg.h>
 #include <cstdio>
+#include <mutex>
 
 inline void WriteLog(const char* Format, ...)
 {
@@ -24,6 +25,10 @@ inline void WriteLog(const char* Format, ...)
   std::vsnprintf(Buffer, sizeof(Buffer), Format, Args);
   va_end(Args);
 
+  // Searches log from multiple threads
+  static std::mutex LogMutex;
+  std::lock_guard<std::mutex> Lock(LogMutex);
+
   std::ofstream OutFile(COF_LOGGER_FILE_PATH, std::ios::app);
 
   if (OutFile)
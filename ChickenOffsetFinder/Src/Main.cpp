@@ -26,6 +26,8 @@
 #include <iomanip>
 #include <unordered_map>
 #include <vector>
+#include <thread>
+#include <algorithm>
 
 // Helpers: usage + filename generators
 static void PrintUsage()
@@ -44,6 +46,11 @@ static void PrintUsage()
     << "    -out      <OutOffsetsFile> File to which found offsets will be printed.\n"
     << "    -sync                      Synchronizes the match ranges in the search configuration file\n"
     << "                               with the ranges at which the target offsets were found.\n"
+    << "    -predecode                 Pre-decodes the .text section once before searching.\n"
+    << "                               Speeds up instruction searches at the cost of extra memory.\n"
+    << "    -threads  <Count>          Number of threads used to search. Default is all hardware threads.\n"
+    << "    -noindex                   Ignores the analysis index file (<DumpFile>.cofidx) and doesn't write one.\n"
+    << "                               By default the analysis of a dump is cached in it and reused on later runs.\n"
     << "    -profile  <ProfileName>    Name of profile listed in the profile configuration file.\n"
     << "                               The search and print configuration files associated with the\n"
     << "                               specified profile will be used to search for and print offsets.\n"
@@ -91,7 +98,9 @@ static std::unordered_map<std::string, std::string> ParseFlags(int ArgC, char* A
     std::string Arg = ArgV[I];
 
     // Recognized valueless flags
-    if (Arg == "-sync")
+    if (Arg == "-sync" ||
+        Arg == "-predecode" ||
+        Arg == "-noindex")
     {
       Flags[Arg] = "";
       continue;
@@ -104,7 +113,8 @@ static std::unordered_map<std::string, std::string> ParseFlags(int ArgC, char* A
         Arg == "-profile" ||
         Arg == "-profiles" ||
         Arg == "-sc" ||
-        Arg == "-pc")
+        Arg == "-pc" ||
+        Arg == "-threads")
     {
       if (I + 1 >= ArgC)
       {
@@ -129,6 +139,9 @@ struct FindOptions
   std::string InDumpFile;           // Either from -file or generated from PID
   std::string OutOffsetsFile;       // -out or timestamped default
   bool SyncSearchConfig = false;    // Whether to synchronize current search config file with found offsets
+  bool PreDecode = false;           // Whether to pre-decode .text before searching
+  std::size_t Threads = 0;          // Search threads, 0 = all hardware threads
+  bool NoIndex = false;             // Whether to ignore (and not write) the dump's analysis index file
   bool ProfileMode = false;         // true if -profile was used
   std::string ProfileName;          // Profile name within Profiles configuration
   std::string ProfilesConfig;       // Custom profile file
@@ -268,6 +281,49 @@ static FindOptions ParseFindOptions(const std::unordered_map<std::string, std::s
     ? true
     : false;
 
+  // Whether to pre-decode .text before searching
+  Opts.PreDecode = Flags.count("-predecode")
+    ? true
+    : false;
+
+  // Whether to skip the analysis index file of the dump
+  Opts.NoIndex = Flags.count("-noindex")
+    ? true
+    : false;
+
+  // Optional thread count, at least 1 and capped at a few times the hardware threads
+  if (Flags.count("-threads"))
+  {
+    const std::string& Value = Flags.at("-threads");
+    long long Threads = 0;
+    std::size_t Parsed = 0;
+
+    try
+    {
+      Threads = std::stoll(Value, &Parsed);
+    }
+    catch (const std::exception&)
+    {
+      Parsed = 0;
+    }
+
+    if (!Parsed || Parsed != Value.size() || Threads < 1)
+    {
+      std::cerr << "Error: -threads must be a number of at least 1 (got '" << Value << "')\n";
+      std::exit(EXIT_FAILURE);
+    }
+
+    const long long MaxThreads = static_cast<long long>((std::max)(std::thread::hardware_concurrency(), 1u)) * 4;
+
+    if (Threads > MaxThreads)
+    {
+      std::cerr << "Warning: -threads " << Threads << " capped at " << MaxThreads << "\n";
+      Threads = MaxThreads;
+    }
+
+    Opts.Threads = static_cast<std::size_t>(Threads);
+  }
+
   return Opts;
 }
 
@@ -279,6 +335,11 @@ static void HandleFind(const FindOptions& Opts)
   {
     COF::OffsetFinder Finder;
 
+    if (Opts.NoIndex)
+    {
+      Finder.UseIndexFile(false);
+    }
+
     if (Opts.PID)
     {
       Finder.Init(*Opts.PID, Opts.InDumpFile);
@@ -288,6 +349,13 @@ static void HandleFind(const FindOptions& Opts)
       Finder.Init(Opts.InDumpFile);
     }
 
+    if (Opts.PreDecode)
+    {
+      Finder.UseInstructionStore();
+    }
+
+    Finder.UseThreads(Opts.Threads);
+
     Finder.UseRegionHandler(COF::SearchHandlers::RegionHandler);
 
     // Declare usage of user defined handlers before actually attempting to find!
@@ -0,0 +1,105 @@
+#include "MappedFile.h"
+
+#include <Windows.h>
+
+#include <string>
+#include <cstdint>
+
+namespace COF
+{
+  const std::uint8_t* MappedFile::GetData() const
+  {
+    return this->Data;
+  }
+
+  std::uint64_t MappedFile::GetSize() const
+  {
+    return this->Size;
+  }
+
+  bool MappedFile::IsOpen() const
+  {
+    return this->Data != nullptr;
+  }
+
+  bool MappedFile::Open(const std::string& FilePath)
+  {
+    this->Close();
+
+    HANDLE File = CreateFileA(
+      FilePath.c_str(),
+      GENERIC_READ,
+      FILE_SHARE_READ,
+      nullptr,
+      OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL,
+      nullptr
+    );
+
+    if (File == INVALID_HANDLE_VALUE)
+    {
+      return false;
+    }
+
+    LARGE_INTEGER FileSize{};
+
+    // Empty files can't be mapped, caller should fall back to regular file reading.
+    if (!GetFileSizeEx(File, &FileSize) || FileSize.QuadPart <= 0)
+    {
+      CloseHandle(File);
+      return false;
+    }
+
+    HANDLE Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (!Mapping)
+    {
+      CloseHandle(File);
+      return false;
+    }
+
+    // Map the whole file, we're 64-bit only so address space isn't a concern.
+    const void* View = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (!View)
+    {
+      CloseHandle(Mapping);
+      CloseHandle(File);
+      return false;
+    }
+
+    this->FileHandle = File;
+    this->MappingHandle = Mapping;
+    this->Data = static_cast<const std::uint8_t*>(View);
+    this->Size = static_cast<std::uint64_t>(FileSize.QuadPart);
+    return true;
+  }
+
+  void MappedFile::Close()
+  {
+    if (this->Data)
+    {
+      UnmapViewOfFile(this->Data);
+      this->Data = nullptr;
+    }
+
+    if (this->MappingHandle)
+    {
+      CloseHandle(this->MappingHandle);
+      this->MappingHandle = nullptr;
+    }
+
+    if (this->FileHandle)
+    {
+      CloseHandle(this->FileHandle);
+      this->FileHandle = nullptr;
+    }
+
+    this->Size = 0;
+  }
+
+  MappedFile::~MappedFile()
+  {
+    this->Close();
+  }
+} // !namespace COF
@@ -0,0 +1,38 @@
+#ifndef COF_MAPPED_FILE_H
+#define COF_MAPPED_FILE_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace COF
+{
+  // Read-only memory mapping of an entire file.
+  // Used by DumpAnalyzer so scanners can work directly on the dump
+  // without seeking/copying through a stream for every read.
+  class MappedFile
+  {
+    // Kept as void* so Windows.h doesn't leak into every includer
+    void* FileHandle = nullptr;
+    void* MappingHandle = nullptr;
+
+    const std::uint8_t* Data = nullptr;
+    std::uint64_t Size = 0;
+
+  public:
+    const std::uint8_t* GetData() const;
+    std::uint64_t GetSize() const;
+    bool IsOpen() const;
+
+    bool Open(const std::string& FilePath);
+    void Close();
+
+    // Mappings are owned, share them through a (smart) pointer instead of copying.
+    MappedFile& operator=(const MappedFile& Other) = delete;
+    MappedFile(const MappedFile& Other) = delete;
+    MappedFile() = default;
+    ~MappedFile();
+  };
+} // !namespace COF
+
+#endif // !COF_MAPPED_FILE_H
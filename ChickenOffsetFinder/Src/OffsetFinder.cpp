@@ -8,6 +8,7 @@
 #include <iostream>
 #include <fstream>
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <vector>
 #include <functional>
@@ -16,9 +17,18 @@
 #include <cstddef>
 #include <iterator>
 #include <iomanip>
+#include <algorithm>
+#include <atomic>
 
 namespace COF
 {
+  namespace
+  {
+    // Serial order path (region index, find index, next region find index, ...)
+    // of the find currently being handled on this thread.
+    thread_local std::vector<std::size_t> CurrentOrder;
+  }
+
   bool SearchHandler::Call(OffsetFinder* Finder, TSearchRegion& Function, TSearchFor& ToFind) const
   {
     return this->Function(Finder, Function, ToFind);
@@ -44,44 +54,6 @@ namespace COF
       return std::nullopt;
     }
 
-    // Each found anchor's offset will be added to this list.
-    // This list will then be used to verify that the anchors
-    // actually belong to the current function address space.
-    std::vector<std::uint64_t> AnchorOffsets;
-    std::size_t AnchorsFound = 0;
-    std::uint64_t FoundFunctionBase = 0;
-
-    auto ResetTrackers = [&]()
-    {
-      AnchorsFound = 0;
-      FoundFunctionBase = 0;
-      AnchorOffsets.clear();
-    };
-
-    // Called when anchor is found
-    auto AnchorFound = [&](std::uint64_t FunctionBase,
-      std::uint64_t AnchorOffset)
-    {
-      ++AnchorsFound;
-      FoundFunctionBase = FunctionBase;
-      AnchorOffsets.push_back(AnchorOffset);
-    };
-
-    auto AllAnchorsFound = [&]()
-      -> bool
-    {
-      if (AnchorsFound == Function.Anchors.size())
-      {
-        // All anchors found,
-        // return indicator to break from loop.
-        return true;
-      }
-
-      // Reset for next try
-      ResetTrackers();
-      return false;
-    };
-
     // We must first find string offsets so we can later
     // match the instructions that reference said string offsets.
     // We keep track of the Anchors (Type: String) index
@@ -95,17 +67,15 @@ namespace COF
 
       if (Anchor.Type == SearchCriteria::AnchorType::String)
       {
-        // UTF-16LE search
-        auto StringMatches = this->Analyzer.FindString<
-          COF::DumpAnalyzer::StringType::UTF16_LE>(Anchor.String, Anchor.Index + 1);
+        auto StringOffset = this->FindStringAnchor(Anchor);
 
-        if (!StringMatches)
+        if (!StringOffset)
         {
           COF_LOG("[!] No anchor (string) matches found!");
           return std::nullopt;
         }
 
-        StringRefOffsets[I] = (*StringMatches->Value)[Anchor.Index];
+        StringRefOffsets[I] = *StringOffset;
       }
     }
 
@@ -114,182 +84,387 @@ namespace COF
     // The function whose address space contains all defined anchors
     // is the function we're looking for.
 
-    // TODO:
-    //  Currently we're parsing all CALL instructions for our list of functions,
-    //  so its possible we're missing some functions.
-    //  We should probably also parse the .PDATA section for functions.
+    // Function list is made up of direct CALL targets and
+    // the functions listed in the exception directory (.pdata).
+
+    auto& Functions = this->Analyzer.GetFunctions();
+
+    // Functions listed in the exception directory have an exact extent,
+    // scanning past it would only read into the next function.
+    auto GetFunctionWindow = [&](const DumpAnalyzer::Function& Candidate)
+      -> std::size_t
+    {
+      if (Candidate.HasExactEnd())
+      {
+        return (std::min)(FunctionSize, Candidate.GetSize());
+      }
+
+      return FunctionSize;
+    };
 
-    auto& FunctionBases = this->Analyzer.GetFunctions();
+    // String anchors don't need the per-function scan at all.
+    // Every LEA referencing the string is looked up in the cross-reference index
+    // and mapped to the function containing it (function base -> anchor offset).
+    std::unordered_map<std::size_t, std::unordered_map<std::uint64_t, std::uint64_t>> StringRefFunctions;
 
-    for (auto It = FunctionBases.begin(); It != FunctionBases.end(); ++It)
+    for (const auto& [I, StringRef] : StringRefOffsets)
     {
-      std::uint64_t FunctionBase = *It;
-      auto NextIt = std::next(It);
+      auto& RefFunctions = StringRefFunctions[I];
 
+      // References are sorted by instruction offset,
+      // so the first reference inside a function wins (like the scan did).
+      for (const auto& Reference : this->Analyzer.FindCrossReferences(StringRef))
+      {
+        // Only allow LEA instructions through to
+        // narrow down scan to string references.
+        // This might need updating later...
+        if (Reference.Mnemonic != ZYDIS_MNEMONIC_LEA)
+        {
+          continue;
+        }
+
+        auto Containing = this->Analyzer.FindContainingFunction(Reference.Instruction);
+
+        if (!Containing)
+        {
+          continue; // Not inside any known function
+        }
+
+        // Reference must lie within the function (search) window
+        if (Reference.Instruction + Reference.Length > Containing->Begin + GetFunctionWindow(*Containing))
+        {
+          continue;
+        }
+
+        RefFunctions.emplace(Containing->Begin, Reference.Instruction);
+      }
+    }
+
+    // Without string anchors every function would be a candidate and each pattern anchor
+    // scanned window by window (with neighbouring windows overlapping).
+    // Instead, each pattern (the leading one of a subsequence) is scanned once over .text
+    // and the hits are mapped to the functions containing them.
+    // Approximate pattern anchors ('MaxMismatches') can't be narrowed down by exact hits
+    // and are scanned window by window.
+    std::unordered_map<std::size_t, std::vector<std::uint64_t>> PatternHits;
+    std::vector<std::unordered_set<std::uint64_t>> PatternHitFunctions;
+
+    if (StringRefOffsets.empty())
+    {
       for (std::size_t I = 0; I < Function.Anchors.size(); ++I)
       {
         const auto& Anchor = Function.Anchors[I];
+        const CompiledPattern* Leading = nullptr;
 
-        if (Anchor.Type == SearchCriteria::AnchorType::String)
+        if (Anchor.Type == SearchCriteria::AnchorType::Pattern && !Anchor.MaxMismatches)
         {
-          std::uint64_t StringRef = StringRefOffsets[I];
+          Leading = &Anchor.Pattern;
+        }
+        else if (Anchor.Type == SearchCriteria::AnchorType::PatternSubsequence && !Anchor.PatternSubsequence.IsEmpty())
+        {
+          // Byte sets of the leading element are widened here, the hits are candidates only
+          Leading = &Anchor.PatternSubsequence.GetElements().front();
+        }
+
+        if (!Leading)
+        {
+          continue;
+        }
 
-          auto Found = this->Analyzer.FindRipRelativeReference(FunctionBase, FunctionSize, StringRef,
-            [](ZydisDecodedInstruction* Instruction, ZydisDecodedOperand* Operands) -> bool
+        auto& Hits = PatternHits[I];
+        Hits = this->Analyzer.FindPatternMatches(this->Sections.Text.GetOffset(), this->Sections.Text.GetSize(), *Leading);
+
+        auto& HitFunctions = PatternHitFunctions.emplace_back();
+
+        for (std::uint64_t Hit : Hits)
+        {
+          if (auto Containing = this->Analyzer.FindContainingFunction(Hit))
           {
-            // Only allow LEA instructions through to
-            // narrow down scan to string references.
-            // This might need updating later...
-            if (Instruction->mnemonic == ZYDIS_MNEMONIC_LEA &&
-              Instruction->operand_count >= 2)
-            {
-              return true;
-            }
+            HitFunctions.insert(Containing->Begin);
+          }
+        }
+      }
 
-            return false;
-          });
+      if (!PatternHits.empty())
+      {
+        COF_LOG("[?] Scanned (%d) pattern anchors over .text.", PatternHits.size());
+      }
+    }
 
-          if (!Found)
+    // First hit of a section-wide scanned pattern anchor within the function window,
+    // the same match the window scan would have found.
+    // Windows reaching outside of .text are scanned the regular way.
+    auto FindPatternHit = [&](std::size_t AnchorIndex, std::uint64_t FunctionBase,
+      std::size_t FunctionWindow, std::size_t PatternSize, std::optional<std::uint64_t>& Out)
+      -> bool
+    {
+      auto Found = PatternHits.find(AnchorIndex);
+
+      if (Found == PatternHits.end())
+      {
+        return false;
+      }
+
+      const auto& Text = this->Sections.Text;
+      std::uint64_t WindowEnd = FunctionBase + (std::max)(FunctionWindow, PatternSize);
+
+      if (FunctionBase < Text.GetOffset() || WindowEnd > Text.GetOffset() + Text.GetSize())
+      {
+        return false;
+      }
+
+      const auto& Hits = Found->second;
+      auto It = std::lower_bound(Hits.begin(), Hits.end(), FunctionBase);
+
+      Out = (It != Hits.end() && *It + PatternSize <= WindowEnd)
+        ? std::optional<std::uint64_t>(*It)
+        : std::nullopt;
+
+      return true;
+    };
+
+    // With string anchors, only functions referencing all of the strings are candidates.
+    // With section-wide scanned pattern anchors, only functions containing hits of all of them.
+    // Otherwise every function is.
+    std::vector<const DumpAnalyzer::Function*> Candidates;
+
+    if (!PatternHitFunctions.empty())
+    {
+      for (std::uint64_t FunctionBase : PatternHitFunctions.front())
+      {
+        bool HitsAll = std::all_of(PatternHitFunctions.begin(), PatternHitFunctions.end(),
+          [FunctionBase](const auto& HitFunctions)
+        {
+          return HitFunctions.count(FunctionBase) > 0;
+        });
+
+        if (HitsAll)
+        {
+          Candidates.push_back(this->Analyzer.FindContainingFunction(FunctionBase));
+        }
+      }
+
+      std::sort(Candidates.begin(), Candidates.end(), [](const auto& A, const auto& B)
+      {
+        return A->Begin < B->Begin;
+      });
+    }
+    else if (!StringRefFunctions.empty())
+    {
+      for (const auto& [FunctionBase, AnchorOffset] : StringRefFunctions.begin()->second)
+      {
+        bool ReferencesAll = std::all_of(StringRefFunctions.begin(), StringRefFunctions.end(),
+          [FunctionBase = FunctionBase](const auto& Entry)
+        {
+          return Entry.second.count(FunctionBase) > 0;
+        });
+
+        if (ReferencesAll)
+        {
+          Candidates.push_back(this->Analyzer.FindContainingFunction(FunctionBase));
+        }
+      }
+
+      // Keep the lowest address first order of the full scan
+      std::sort(Candidates.begin(), Candidates.end(), [](const auto& A, const auto& B)
+      {
+        return A->Begin < B->Begin;
+      });
+    }
+    else
+    {
+      Candidates.reserve(Functions.size());
+
+      for (const auto& Candidate : Functions)
+      {
+        Candidates.push_back(&Candidate);
+      }
+    }
+
+    // Checks a single candidate, true if all anchors are found within it.
+    // Candidates don't depend on each other, so they are checked in parallel.
+    auto CheckCandidate = [&](const DumpAnalyzer::Function* Candidate)
+      -> bool
+    {
+      std::uint64_t FunctionBase = Candidate->Begin;
+      std::size_t FunctionWindow = GetFunctionWindow(*Candidate);
+
+      // Each found anchor's offset will be added to this list.
+      // This list will then be used to verify that the anchors
+      // actually belong to the current function address space.
+      std::vector<std::uint64_t> AnchorOffsets;
+
+      for (std::size_t I = 0; I < Function.Anchors.size(); ++I)
+      {
+        const auto& Anchor = Function.Anchors[I];
+
+        if (Anchor.Type == SearchCriteria::AnchorType::String)
+        {
+          const auto& RefFunctions = StringRefFunctions.at(I);
+          auto Found = RefFunctions.find(FunctionBase);
+
+          if (Found == RefFunctions.end())
           {
-            break;
+            return false;
           }
 
-          std::uint64_t AnchorOffset = Found->Range.Offset;
-          AnchorFound(FunctionBase, AnchorOffset);
+          std::uint64_t AnchorOffset = Found->second;
+          AnchorOffsets.push_back(AnchorOffset);
 
           //Function.AnchorInstructionBase = *InstructionBase->Value;
           //COF_LOG("[+] Found instruction at offset: 0x%016llX", *InstructionBase->Value);
         }
         else if (Anchor.Type == SearchCriteria::AnchorType::Pattern)
         {
+          std::optional<std::uint64_t> Hit;
 
-          auto Found =
-            this->Analyzer.FindPattern(FunctionBase, FunctionSize, Anchor.Pattern);
+          if (Anchor.MaxMismatches)
+          {
+            if (auto Found = this->Analyzer.FindApproximatePattern(FunctionBase, FunctionWindow, Anchor.Pattern, Anchor.MaxMismatches))
+            {
+              Hit = Found->Range.Offset;
 
-          if (!Found)
+              if (*Found->Value)
+              {
+                COF_LOG("[?] Pattern anchor matched with (%d) mismatching byte(s) at (0x%X)", *Found->Value, *Hit);
+              }
+            }
+          }
+          else if (!FindPatternHit(I, FunctionBase, FunctionWindow, Anchor.Pattern.GetSize(), Hit))
           {
-            break;
+            if (auto Found = this->Analyzer.FindPattern(FunctionBase, FunctionWindow, Anchor.Pattern))
+            {
+              Hit = Found->Range.Offset;
+            }
           }
 
-          std::uint64_t AnchorOffset = Found->Range.Offset;
-          AnchorFound(FunctionBase, AnchorOffset);
-          COF_LOG("[+] Found function (0x%X) with anchor (0x%X) (Type: Pattern)", FunctionBase, AnchorOffset);
-        }
-        else if (Anchor.Type == SearchCriteria::AnchorType::PatternSubsequence)
-        {
-          auto Found = this->Analyzer.FindPatternSubsequence(FunctionBase, FunctionSize, Anchor.PatternSubsequence);
-
-          if (!Found)
+          if (!Hit)
           {
-            break;
+            return false;
           }
 
-          std::uint64_t AnchorOffset = Found->Range.Offset;
-          AnchorFound(FunctionBase, AnchorOffset);
-          COF_LOG("[+] Found function (0x%X) with anchor (0x%X) (Type: PatternSubsequence)", FunctionBase, AnchorOffset);
+          std::uint64_t AnchorOffset = *Hit;
+          AnchorOffsets.push_back(AnchorOffset);
+          COF_LOG("[+] Found function (0x%X) with anchor (0x%X) (Type: Pattern)", FunctionBase, AnchorOffset);
         }
-        else if (Anchor.Type == SearchCriteria::AnchorType::InstructionSequence)
+        else if (Anchor.Type == SearchCriteria::AnchorType::PatternSubsequence)
         {
-          std::vector<AssemblyParser::ParsedInstruction> ParsedInstructions;
+          std::uint64_t SearchBase = FunctionBase;
+          std::size_t SearchWindow = FunctionWindow;
+          std::optional<std::uint64_t> Hit;
 
-          for (const auto& AsmText : Anchor.InstructionSequence)
+          if (!Anchor.PatternSubsequence.IsEmpty()
+            && FindPatternHit(I, FunctionBase, FunctionWindow, Anchor.PatternSubsequence.GetElements().front().GetSize(), Hit))
           {
-            auto Instruction = COF::AssemblyParser::ParseInstruction(AsmText);
-
-            if (!Instruction)
+            if (!Hit)
             {
-              COF_LOG("[!] Parsing instruction (%s) in sequence failed!", AsmText.c_str());
-
-              // Return instead of break here because
-              // we have a malformed instruction that should be fixed.
-              return std::nullopt;
+              return false;
             }
 
-            ParsedInstructions.push_back(*Instruction);
+            // Nothing of the subsequence can start before the first leading pattern hit,
+            // so the scan starts there.
+            SearchBase = *Hit;
+            SearchWindow = FunctionWindow - static_cast<std::size_t>(*Hit - FunctionBase);
           }
 
-          auto Found = this->Analyzer.FindInstructionSequence(FunctionBase, FunctionSize, ParsedInstructions);
+          auto Found = this->Analyzer.FindPatternSubsequence(SearchBase, SearchWindow, Anchor.PatternSubsequence);
 
           if (!Found)
           {
-            break;
+            return false;
           }
 
           std::uint64_t AnchorOffset = Found->Range.Offset;
-          AnchorFound(FunctionBase, AnchorOffset);
-          COF_LOG("[+] Found function (0x%X) with anchor (0x%X) (Type: InstructionSequence)", FunctionBase, AnchorOffset);
+          AnchorOffsets.push_back(AnchorOffset);
+          COF_LOG("[+] Found function (0x%X) with anchor (0x%X) (Type: PatternSubsequence)", FunctionBase, AnchorOffset);
         }
-        else if (Anchor.Type == SearchCriteria::AnchorType::InstructionSubsequence)
+        else if (Anchor.Type == SearchCriteria::AnchorType::InstructionSequence)
         {
-          std::vector<AssemblyParser::ParsedInstruction> ParsedInstructions;
+          auto Found = this->Analyzer.FindInstructionSequence(FunctionBase, FunctionWindow, Anchor.InstructionSequence);
 
-          for (const auto& AsmText : Anchor.InstructionSubsequence)
+          if (!Found)
           {
-            auto Instruction = COF::AssemblyParser::ParseInstruction(AsmText);
-
-            if (!Instruction)
-            {
-              COF_LOG("[!] Parsing instruction (%s) in subsequence failed!", AsmText.c_str());
-
-              // Return instead of break here because
-              // we have a malformed instruction that should be fixed.
-              return std::nullopt;
-            }
-
-            ParsedInstructions.push_back(*Instruction);
+            return false;
           }
 
-          auto Found = this->Analyzer.FindInstructionSubsequence(FunctionBase, FunctionSize, ParsedInstructions);
+          std::uint64_t AnchorOffset = Found->Range.Offset;
+          AnchorOffsets.push_back(AnchorOffset);
+          COF_LOG("[+] Found function (0x%X) with anchor (0x%X) (Type: InstructionSequence)", FunctionBase, AnchorOffset);
+        }
+        else if (Anchor.Type == SearchCriteria::AnchorType::InstructionSubsequence)
+        {
+          auto Found = this->Analyzer.FindInstructionSubsequence(FunctionBase, FunctionWindow, Anchor.InstructionSubsequence);
 
           if (!Found)
           {
-            break;
+            return false;
           }
 
           std::uint64_t AnchorOffset = Found->Range.Offset;
-          AnchorFound(FunctionBase, AnchorOffset);
+          AnchorOffsets.push_back(AnchorOffset);
           COF_LOG("[+] Found function (0x%X) with anchor (0x%X) (Type: InstructionSubsequence)", FunctionBase, AnchorOffset);
         }
       }
 
-      if (!AllAnchorsFound())
+      // Anchors were searched for within the exact function extent,
+      // nothing left to verify.
+      if (Candidate->HasExactEnd())
       {
-        continue;
+        return true;
       }
 
-      std::size_t VerifiedAnchors = 0;
-
       for (const auto& AnchorOffset : AnchorOffsets)
       {
-        if (NextIt != FunctionBases.end())
+        // End is the next function's begin here
+        if (!Candidate->Contains(AnchorOffset))
         {
-          std::uint64_t NextFunctionBase = *NextIt;
+          return false;
+        }
 
-          if (AnchorOffset <= FunctionBase || AnchorOffset >= NextFunctionBase)
-          {
-            break;
-          }
+        COF_LOG("[?] Verified that anchor (0x%X) is within function boundaries: [Begin: 0x%X, End: 0x%X]",
+          AnchorOffset, FunctionBase, Candidate->End);
+      }
 
-          COF_LOG("[?] Verified that anchor (0x%X) is within function boundaries: [Begin: 0x%X, End: 0x%X]",
-            AnchorOffset, FunctionBase, FunctionBase + FunctionSize);
+      return true;
+    };
 
-          ++VerifiedAnchors;
-        }
-      }
+    // The lowest address verified candidate wins, exactly like a serial scan.
+    // Chunks are handed out in ascending order and everything above a verified
+    // candidate is skipped, so the scan stops early just like the serial one did.
+    std::atomic<std::size_t> Winner = Candidates.size();
+    const std::size_t ChunkSize = (std::max)(Candidates.size() / (this->GetThreadPool().GetThreadCount() * 16),
+      static_cast<std::size_t>(64));
 
-      if (VerifiedAnchors == AnchorOffsets.size())
+    this->GetThreadPool().ParallelFor(Candidates.size(), ChunkSize, [&](std::size_t Begin, std::size_t End)
+    {
+      for (std::size_t I = Begin; I < End; ++I)
       {
-        // Anchor boundaries verified, finally exit loop
-        break;
-      }
+        std::size_t Current = Winner.load(std::memory_order_relaxed);
 
-      // Anchor out of function boundaries,
-      // reset and retry with next FunctionBase.
-      ResetTrackers();
-    }
+        if (I >= Current)
+        {
+          return;
+        }
 
-    if (FoundFunctionBase)
+        if (!CheckCandidate(Candidates[I]))
+        {
+          continue;
+        }
+
+        // Another worker may have verified a candidate meanwhile, keep the lower one
+        while (I < Current && !Winner.compare_exchange_weak(Current, I, std::memory_order_relaxed))
+        {
+          // Current is reloaded on failure
+        }
+
+        return;
+      }
+    });
+
+    if (Winner < Candidates.size())
     {
+      std::uint64_t FoundFunctionBase = Candidates[Winner]->Begin;
+
       // We got correct function base, save it and return
       COF_LOG("[+] Function base has been set: 0x%X", FoundFunctionBase);
       return (Function.RegionRange.Offset = FoundFunctionBase);
@@ -299,6 +474,79 @@ namespace COF
     return std::nullopt;
   }
 
+  // Collects the String anchors of all regions and resolves them
+  // with a single scan over .rdata, instead of one scan per anchor.
+  void OffsetFinder::ResolveStringAnchors(const std::vector<TSearchRegion>& Regions)
+  {
+    std::map<std::pair<SearchCriteria::StringEncoding, std::string>, std::size_t> MaxMatches;
+
+    for (const auto& Region : Regions)
+    {
+      for (const auto& Anchor : Region.Anchors)
+      {
+        if (Anchor.Type != SearchCriteria::AnchorType::String)
+        {
+          continue;
+        }
+
+        std::size_t& Matches = MaxMatches[{ Anchor.Encoding, Anchor.String }];
+        Matches = (std::max)(Matches, Anchor.Index + 1);
+      }
+    }
+
+    if (MaxMatches.empty())
+    {
+      return;
+    }
+
+    std::vector<DumpAnalyzer::StringQuery> Queries;
+
+    for (const auto& [Key, Matches] : MaxMatches)
+    {
+      auto Type = (Key.first == SearchCriteria::StringEncoding::ASCII)
+        ? DumpAnalyzer::StringType::ASCII
+        : DumpAnalyzer::StringType::UTF16_LE;
+
+      Queries.push_back({ Key.second, Type, Matches });
+    }
+
+    auto Results = this->Analyzer.FindStrings(Queries);
+    std::size_t I = 0;
+
+    for (const auto& Entry : MaxMatches)
+    {
+      this->StringAnchorMatches[Entry.first] = std::move(Results[I++]);
+    }
+
+    COF_LOG("[?] Resolved (%d) string anchors in a single pass.", Queries.size());
+  }
+
+  std::optional<std::uint64_t> OffsetFinder::FindStringAnchor(const TAnchor& Anchor)
+  {
+    std::lock_guard<std::mutex> Lock(this->StringAnchorMutex);
+    auto It = this->StringAnchorMatches.find({ Anchor.Encoding, Anchor.String });
+
+    // Anchors that weren't part of the batch (e.g. regions added later) are resolved on their own.
+    // A batched string with too few matches is final (missing or rarer than expected),
+    // scanning .rdata again would only find the same matches.
+    if (It == this->StringAnchorMatches.end())
+    {
+      auto Type = (Anchor.Encoding == SearchCriteria::StringEncoding::ASCII)
+        ? DumpAnalyzer::StringType::ASCII
+        : DumpAnalyzer::StringType::UTF16_LE;
+
+      auto Results = this->Analyzer.FindStrings({ { Anchor.String, Type, Anchor.Index + 1 } });
+      It = this->StringAnchorMatches.insert_or_assign({ Anchor.Encoding, Anchor.String }, std::move(Results[0])).first;
+    }
+
+    if (It->second.size() <= Anchor.Index)
+    {
+      return std::nullopt;
+    }
+
+    return It->second[Anchor.Index];
+  }
+
   // Actually this only saves the .text section,
   // since it's currently the only section we need...
   bool OffsetFinder::SavePESections()
@@ -358,6 +606,7 @@ namespace COF
       return;
     }
 
+    std::lock_guard<std::mutex> Lock(this->JSONMutex);
     JSON& RegionsJson = this->JSON_SearchRegions;
 
     for (auto& RegionJson : RegionsJson)
@@ -388,16 +637,33 @@ namespace COF
 
   void OffsetFinder::AddFind(const TFound& FoundItem)
   {
+    std::lock_guard<std::mutex> Lock(this->FoundMutex);
     this->FoundList.push_back(FoundItem);
+    this->FoundOrder.push_back(CurrentOrder);
   }
 
   void OffsetFinder::HandleExpectedFinds(TSearchRegion& Region)
   {
     // Pass search targets to the defined search handlers.
     // All finds will (should) be added to FoundList by the handlers.
-    for (auto& ToFind : Region.SearchFor)
+    for (std::size_t I = 0; I < Region.SearchFor.size(); ++I)
     {
-      if (!this->SearchHandlers[ToFind.SearchType](this, Region, ToFind))
+      auto& ToFind = Region.SearchFor[I];
+      const auto& Handler = this->SearchHandlers[static_cast<std::size_t>(ToFind.SearchType)];
+
+      if (!Handler)
+      {
+        COF_LOG("[!] No handler registered for find (ID: %s)! Skipping...", ToFind.SearchID.c_str());
+        continue;
+      }
+
+      // XReference handlers recurse into their next region from here,
+      // which extends the order path of the finds added on the way.
+      CurrentOrder.push_back(I);
+      bool Handled = Handler(this, Region, ToFind);
+      CurrentOrder.pop_back();
+
+      if (!Handled)
       {
         // Probably failed search query,
         // move to next search item in list.
@@ -406,25 +672,220 @@ namespace COF
     }
   }
 
-  void OffsetFinder::Find(std::vector<TSearchRegion>& Regions, bool ShouldSyncSearchConfig)
+  // Resolves the references between regions and finds (by ID in the config)
+  // to direct pointers, so the handlers don't have to scan all regions for them.
+  // Regions must not be resized afterwards.
+  void OffsetFinder::BuildSearchPlan(std::vector<TSearchRegion>& Regions)
   {
+    this->GroupMembers.clear();
+    std::unordered_map<std::string, TSearchRegion*> RegionsByID;
+
+    for (auto& Region : Regions)
+    {
+      // Next regions are only reachable through X-References,
+      // prefer the first region that allows it (like the handler lookup did).
+      auto [It, Inserted] = RegionsByID.emplace(Region.RegionID, &Region);
+
+      if (!Inserted && It->second->AccessType != SearchCriteria::AccessType::XReference
+        && Region.AccessType == SearchCriteria::AccessType::XReference)
+      {
+        It->second = &Region;
+      }
+
+      for (auto& ToFind : Region.SearchFor)
+      {
+        if (ToFind.Group)
+        {
+          this->GroupMembers[ToFind.Group->ID].push_back(&ToFind);
+        }
+      }
+    }
+
     for (auto& Region : Regions)
     {
-      // The main finder loop directly handles
-      // only regions marked AccessType::Normal.
-      if (Region.AccessType != SearchCriteria::AccessType::Normal)
+      for (auto& ToFind : Region.SearchFor)
+      {
+        if (ToFind.Group)
+        {
+          ToFind.Group->Members = &this->GroupMembers[ToFind.Group->ID];
+        }
+
+        if (ToFind.NextRegion)
+        {
+          auto It = RegionsByID.find(ToFind.NextRegion->ID);
+          ToFind.NextRegion->Region = (It != RegionsByID.end()) ? It->second : nullptr;
+        }
+      }
+    }
+
+    // Normal regions are independent unless they reach the same region through
+    // X-References, or contain members of the same group anywhere along the way.
+    // Dependent regions are merged into one schedule entry (union-find over region indices),
+    // everything else can be searched concurrently.
+    std::vector<std::size_t> Parent(Regions.size());
+    std::unordered_map<const TSearchRegion*, std::size_t> RegionOwner;
+    std::unordered_map<std::string, std::size_t> GroupOwner;
+
+    for (std::size_t I = 0; I < Parent.size(); ++I)
+    {
+      Parent[I] = I;
+    }
+
+    auto FindRoot = [&Parent](std::size_t I)
+    {
+      while (Parent[I] != I)
+      {
+        Parent[I] = Parent[Parent[I]];
+        I = Parent[I];
+      }
+
+      return I;
+    };
+
+    auto Merge = [&](std::size_t A, std::size_t B)
+    {
+      A = FindRoot(A);
+      B = FindRoot(B);
+
+      // Keep the earliest region as root, so entries stay in config order
+      if (A != B)
+      {
+        Parent[(std::max)(A, B)] = (std::min)(A, B);
+      }
+    };
+
+    for (std::size_t I = 0; I < Regions.size(); ++I)
+    {
+      if (Regions[I].AccessType != SearchCriteria::AccessType::Normal)
       {
         continue;
       }
 
-      if (!this->RegionHandler(this, Region))
+      std::vector<const TSearchRegion*> Pending{ &Regions[I] };
+      std::unordered_set<const TSearchRegion*> Visited;
+
+      while (!Pending.empty())
+      {
+        const TSearchRegion* Current = Pending.back();
+        Pending.pop_back();
+
+        if (!Visited.insert(Current).second)
+        {
+          continue;
+        }
+
+        Merge(I, RegionOwner.emplace(Current, I).first->second);
+
+        for (const auto& ToFind : Current->SearchFor)
+        {
+          if (ToFind.Group)
+          {
+            Merge(I, GroupOwner.emplace(ToFind.Group->ID, I).first->second);
+          }
+
+          if (ToFind.NextRegion && ToFind.NextRegion->Region)
+          {
+            Pending.push_back(ToFind.NextRegion->Region);
+          }
+        }
+      }
+    }
+
+    this->RegionSchedule.clear();
+    std::unordered_map<std::size_t, std::size_t> ScheduleIndex;
+
+    for (std::size_t I = 0; I < Regions.size(); ++I)
+    {
+      if (Regions[I].AccessType != SearchCriteria::AccessType::Normal)
       {
-        // Probably failed pre- configuration of Region,
-        // move to next region in list.
         continue;
       }
 
-      this->HandleExpectedFinds(Region);
+      auto [It, Inserted] = ScheduleIndex.emplace(FindRoot(I), this->RegionSchedule.size());
+
+      if (Inserted)
+      {
+        this->RegionSchedule.emplace_back();
+      }
+
+      this->RegionSchedule[It->second].push_back(&Regions[I]);
+    }
+  }
+
+  void OffsetFinder::Find(std::vector<TSearchRegion>& Regions, bool ShouldSyncSearchConfig)
+  {
+    this->BuildSearchPlan(Regions);
+    this->ResolveStringAnchors(Regions);
+
+    std::size_t FirstNewFind = this->FoundList.size();
+
+    // The main finder loop directly handles only regions marked AccessType::Normal.
+    // Each schedule entry is searched in config order on one thread,
+    // X-Referenced regions are handled right after their parent find resolves them.
+    auto SearchEntry = [this, &Regions](std::size_t Entry)
+    {
+      // ParallelFor only runs tasks of its own call on the waiting thread,
+      // so entries never nest and each one starts a fresh order path.
+      for (TSearchRegion* Region : this->RegionSchedule[Entry])
+      {
+        CurrentOrder.assign(1, static_cast<std::size_t>(Region - Regions.data()));
+
+        if (!this->RegionHandler(this, *Region))
+        {
+          // Probably failed pre- configuration of Region,
+          // move to next region in list.
+          continue;
+        }
+
+        this->HandleExpectedFinds(*Region);
+      }
+
+      CurrentOrder.clear();
+    };
+
+    this->GetThreadPool().ParallelFor(this->RegionSchedule.size(), 1, [&SearchEntry](std::size_t Begin, std::size_t End)
+    {
+      for (std::size_t Entry = Begin; Entry < End; ++Entry)
+      {
+        SearchEntry(Entry);
+      }
+    });
+
+    // Finds arrive in completion order, restore the order of a serial search
+    // so printing and -sync don't depend on thread timing.
+    std::vector<std::size_t> Order(this->FoundList.size() - FirstNewFind);
+
+    for (std::size_t I = 0; I < Order.size(); ++I)
+    {
+      Order[I] = FirstNewFind + I;
+    }
+
+    std::stable_sort(Order.begin(), Order.end(), [this](std::size_t A, std::size_t B)
+    {
+      return this->FoundOrder[A] < this->FoundOrder[B];
+    });
+
+    std::vector<TFound> SortedFinds;
+    std::vector<std::vector<std::size_t>> SortedOrder;
+    SortedFinds.reserve(Order.size());
+    SortedOrder.reserve(Order.size());
+
+    for (std::size_t I : Order)
+    {
+      SortedFinds.push_back(std::move(this->FoundList[I]));
+      SortedOrder.push_back(std::move(this->FoundOrder[I]));
+    }
+
+    std::move(SortedFinds.begin(), SortedFinds.end(), this->FoundList.begin() + FirstNewFind);
+    std::move(SortedOrder.begin(), SortedOrder.end(), this->FoundOrder.begin() + FirstNewFind);
+
+    auto Statistics = this->Analyzer.GetScanStatistics();
+
+    if (Statistics.Instructions)
+    {
+      COF_LOG("[?] Decoded operands of (%llu/%llu) scanned instructions (%.1f%% avoided).",
+        Statistics.OperandDecodes, Statistics.Instructions,
+        100.0 * static_cast<double>(Statistics.Instructions - Statistics.OperandDecodes) / static_cast<double>(Statistics.Instructions));
     }
 
     this->ShouldSyncSearchConfig = ShouldSyncSearchConfig;
@@ -469,6 +930,85 @@ namespace COF
       }
     };
 
+    // Patterns are compiled once here instead of on every search
+    auto CompilePatterns = [](const std::vector<std::string>& IdaPatterns, std::vector<CompiledPattern>& Out)
+    {
+      Out.clear();
+
+      for (const auto& IdaPattern : IdaPatterns)
+      {
+        auto Compiled = CompiledPattern::Parse(IdaPattern);
+
+        if (!Compiled)
+        {
+          COF_LOG("[!] Invalid pattern specified (%s)! Skipping...", IdaPattern.c_str());
+          return false;
+        }
+
+        Out.push_back(std::move(*Compiled));
+      }
+
+      return true;
+    };
+
+    auto CompileSubsequence = [](const std::vector<std::string>& IdaPatterns, GappedPattern& Out)
+    {
+      auto Compiled = GappedPattern::Parse(IdaPatterns);
+
+      if (!Compiled)
+      {
+        COF_LOG("[!] Invalid pattern subsequence specified! Skipping...");
+        return false;
+      }
+
+      Out = std::move(*Compiled);
+      return true;
+    };
+
+    // Same for instructions, the search loops only see parsed instructions
+    auto ParseInstructions = [](const std::vector<std::string>& AsmTexts, std::vector<DumpAnalyzer::MatchInstruction>& Out)
+    {
+      Out.clear();
+
+      // Gap marker applying to the next instruction
+      std::optional<std::size_t> Gap;
+
+      for (const auto& AsmText : AsmTexts)
+      {
+        if (auto ParsedGap = AssemblyParser::ParseGap(AsmText))
+        {
+          Gap = ParsedGap;
+          continue;
+        }
+
+        auto Instruction = AssemblyParser::ParseInstruction(AsmText);
+
+        if (!Instruction)
+        {
+          COF_LOG("[!] Parsing instruction (%s) failed! Skipping...", AsmText.c_str());
+          return false;
+        }
+
+        Instruction->MaxGap = Gap;
+        Gap.reset();
+        Out.push_back(*Instruction);
+      }
+
+      if (Out.empty())
+      {
+        COF_LOG("[!] No instructions were specified! Skipping...");
+        return false;
+      }
+
+      if (Gap)
+      {
+        COF_LOG("[!] Gap marker must be followed by an instruction! Skipping...");
+        return false;
+      }
+
+      return true;
+    };
+
     try
     {
       // TODO:
@@ -548,25 +1088,58 @@ namespace COF
               {
                 CppAnchor.Index = Anchor.at("Index").get<std::size_t>();
               }
+
+              // Optional, defaults to UTF16LE
+              if (Anchor.contains("Encoding") && !Anchor.at("Encoding").is_null())
+              {
+                std::string Encoding = Anchor.at("Encoding").get<std::string>();
+
+                if (!SearchCriteria::StringEncodings.count(Encoding))
+                {
+                  COF_LOG("[!] Invalid 'Encoding' specified (%s)! Skipping...", Encoding.c_str());
+                  continue;
+                }
+
+                CppAnchor.Encoding = SearchCriteria::StringEncodings[Encoding];
+              }
             }
             else if (CppType == SearchCriteria::AnchorType::Pattern)
             {
-              CppAnchor.Pattern = Anchor.at("Value").get<std::string>();
+              std::vector<CompiledPattern> Compiled;
+
+              if (!CompilePatterns({ Anchor.at("Value").get<std::string>() }, Compiled))
+              {
+                continue;
+              }
+
+              CppAnchor.Pattern = std::move(Compiled.front());
+
+              // Optional, defaults to 0 (exact match)
+              if (Anchor.contains("MaxMismatches") && !Anchor.at("MaxMismatches").is_null())
+              {
+                CppAnchor.MaxMismatches = Anchor.at("MaxMismatches").get<std::size_t>();
+              }
             }
             else if (CppType == SearchCriteria::AnchorType::PatternSubsequence)
             {
-              CppAnchor.PatternSubsequence =
-                Anchor.at("Value").get<std::vector<std::string>>();
+              if (!CompileSubsequence(Anchor.at("Value").get<std::vector<std::string>>(), CppAnchor.PatternSubsequence))
+              {
+                continue;
+              }
             }
             else if (CppType == SearchCriteria::AnchorType::InstructionSequence)
             {
-              CppAnchor.InstructionSequence =
-                Anchor.at("Value").get<std::vector<std::string>>();
+              if (!ParseInstructions(Anchor.at("Value").get<std::vector<std::string>>(), CppAnchor.InstructionSequence))
+              {
+                continue;
+              }
             }
             else if (CppType == SearchCriteria::AnchorType::InstructionSubsequence)
             {
-              CppAnchor.InstructionSubsequence =
-                Anchor.at("Value").get<std::vector<std::string>>();
+              if (!ParseInstructions(Anchor.at("Value").get<std::vector<std::string>>(), CppAnchor.InstructionSubsequence))
+              {
+                continue;
+              }
             }
 
             CppAnchor.Type = CppType;
@@ -644,19 +1217,41 @@ namespace COF
 
               if (CppMatcher.Type == SearchCriteria::MatcherType::Pattern)
               {
-                CppMatcher.Pattern = Matcher.at("Value").get<std::string>();
+                std::vector<CompiledPattern> Compiled;
+
+                if (!CompilePatterns({ Matcher.at("Value").get<std::string>() }, Compiled))
+                {
+                  continue;
+                }
+
+                CppMatcher.Pattern = std::move(Compiled.front());
+
+                // Optional, defaults to 0 (exact match)
+                if (Matcher.contains("MaxMismatches") && !Matcher.at("MaxMismatches").is_null())
+                {
+                  CppMatcher.MaxMismatches = Matcher.at("MaxMismatches").get<std::size_t>();
+                }
               }
               else if (CppMatcher.Type == SearchCriteria::MatcherType::PatternSubsequence)
               {
-                CppMatcher.PatternSubsequence = Matcher.at("Value").get<std::vector<std::string>>();
+                if (!CompileSubsequence(Matcher.at("Value").get<std::vector<std::string>>(), CppMatcher.PatternSubsequence))
+                {
+                  continue;
+                }
               }
               else if (CppMatcher.Type == SearchCriteria::MatcherType::InstructionSequence)
               {
-                CppMatcher.InstructionSequence = Matcher.at("Value").get<std::vector<std::string>>();
+                if (!ParseInstructions(Matcher.at("Value").get<std::vector<std::string>>(), CppMatcher.InstructionSequence))
+                {
+                  continue;
+                }
               }
               else if (CppMatcher.Type == SearchCriteria::MatcherType::InstructionSubsequence)
               {
-                CppMatcher.InstructionSubsequence = Matcher.at("Value").get<std::vector<std::string>>();
+                if (!ParseInstructions(Matcher.at("Value").get<std::vector<std::string>>(), CppMatcher.InstructionSubsequence))
+                {
+                  continue;
+                }
               }
 
               if (Matcher.contains("Offset") && !Matcher.at("Offset").is_null())
@@ -765,7 +1360,7 @@ namespace COF
   {
     for (auto& Handler : SearchHandlers)
     {
-      this->SearchHandlers[Handler.Type] = Handler.Function;
+      this->SearchHandlers[static_cast<std::size_t>(Handler.Type)] = Handler.Function;
     }
   }
 
@@ -775,6 +1370,42 @@ namespace COF
     this->RegionHandler = RegionHandler;
   }
 
+  void OffsetFinder::UseThreads(std::size_t ThreadCount)
+  {
+    this->Pool = std::make_shared<ThreadPool>(ThreadCount);
+    this->Analyzer.UseThreadPool(this->Pool);
+    COF_LOG("[?] Searching with (%d) threads.", this->Pool->GetThreadCount());
+  }
+
+  void OffsetFinder::UseIndexFile(bool Enable)
+  {
+    this->Analyzer.UseIndex(Enable);
+  }
+
+  ThreadPool& OffsetFinder::GetThreadPool()
+  {
+    if (!this->Pool)
+    {
+      this->Pool = std::make_shared<ThreadPool>();
+      this->Analyzer.UseThreadPool(this->Pool);
+    }
+
+    return *this->Pool;
+  }
+
+  bool OffsetFinder::UseInstructionStore()
+  {
+    // Pre-decode .text once, instruction searches will iterate it instead of re-decoding
+    if (!this->Analyzer.BuildInstructionStore())
+    {
+      COF_LOG("[!] Failed to pre-decode .text section, falling back to on the fly decoding.");
+      return false;
+    }
+
+    COF_LOG("[?] Pre-decoded .text section.");
+    return true;
+  }
+
   bool OffsetFinder::Init(const std::string& FilePath)
   {
     COF_LOG("[>] Opening memory dump (File): %s", FilePath.c_str());
@@ -4,10 +4,15 @@
 #include "MemoryDumper.h"
 #include "DumpAnalyzer.h"
 #include "SearchCriteria.h"
+#include "ThreadPool.h"
 
 #include "nlohmann/json.hpp"
 
 #include <set>
+#include <memory>
+#include <mutex>
+#include <array>
+#include <map>
 #include <cstdint>
 #include <functional>
 #include <any>
@@ -24,6 +29,8 @@
 namespace COF
 {
   using JSON = nlohmann::ordered_json;
+  using CompiledPattern = PatternScanner::CompiledPattern;
+  using GappedPattern = PatternScanner::GappedPattern;
 
   struct TRange;
   struct TSearchFor;
@@ -47,6 +54,9 @@ namespace COF
   {
     std::string ID;
     std::optional<std::size_t> Index;
+
+    // All finds of the group, resolved by OffsetFinder::BuildSearchPlan()
+    const std::vector<TSearchFor*>* Members = nullptr;
   };
 
   struct TRange
@@ -66,10 +76,10 @@ namespace COF
 
     // For semantic reasons we define a member for each type.
     // Probably better to define getters instead to save a few bytes?
-    std::string Pattern;
-    std::vector<std::string> PatternSubsequence;
-    std::vector<std::string> InstructionSequence;
-    std::vector<std::string> InstructionSubsequence;
+    CompiledPattern Pattern;
+    GappedPattern PatternSubsequence;
+    std::vector<DumpAnalyzer::MatchInstruction> InstructionSequence;
+    std::vector<DumpAnalyzer::MatchInstruction> InstructionSubsequence;
 
     // This decides from which index in the subsequence list we match our target.
     // E.g. If we specify Index = 2 and item at Index 2 has
@@ -82,6 +92,10 @@ namespace COF
     // from the Index of item in subsequence list.
     // By default match the very start of the pattern.
     std::uint64_t Offset = 0;
+
+    // Pattern bytes that may differ from the match ('Pattern' only).
+    // The match with the fewest differing bytes is used, by default only exact matches.
+    std::size_t MaxMismatches = 0;
   };
 
   // Next region to handle in reference chain.
@@ -89,6 +103,9 @@ namespace COF
   struct TNextRegion
   {
     std::string ID;
+
+    // Resolved by OffsetFinder::BuildSearchPlan()
+    TSearchRegion* Region = nullptr;
   };
 
   struct TPrintGroup
@@ -145,15 +162,21 @@ namespace COF
     // For semantic reasons we define a member for each type.
     // Probably better to define getters instead to save a few bytes?
     std::string String;
-    std::string Pattern;
-    std::vector<std::string> PatternSubsequence;
-    std::vector<std::string> InstructionSubsequence;
-    std::vector<std::string> InstructionSequence;
+    CompiledPattern Pattern;
+    GappedPattern PatternSubsequence;
+    std::vector<DumpAnalyzer::MatchInstruction> InstructionSubsequence;
+    std::vector<DumpAnalyzer::MatchInstruction> InstructionSequence;
 
     // There could be multiple anchor matches,
     // this chooses which match to use.
     // Currently only 'String' is supported.
     std::size_t Index = 0;
+
+    // Pattern bytes that may differ from the match ('Pattern' only), see TMatcher
+    std::size_t MaxMismatches = 0;
+
+    // Encoding of 'String' anchors
+    SearchCriteria::StringEncoding Encoding = SearchCriteria::StringEncoding::UTF16LE;
   };
 
   struct TSearchRegion
@@ -184,11 +207,37 @@ namespace COF
     std::string SearchConfigPath;
     bool ShouldSyncSearchConfig = false;
 
+    // Match offsets of every String anchor in the search configuration,
+    // resolved together in a single pass (see ResolveStringAnchors).
+    std::map<std::pair<SearchCriteria::StringEncoding, std::string>, std::vector<std::uint64_t>> StringAnchorMatches;
+
     std::function<bool(OffsetFinder*, TSearchRegion&)> RegionHandler;
-    std::unordered_map<SearchCriteria::SearchType,
-      std::function<bool(OffsetFinder*, TSearchRegion&, TSearchFor&)>> SearchHandlers;
+    std::array<std::function<bool(OffsetFinder*, TSearchRegion&, TSearchFor&)>,
+      SearchCriteria::SearchTypeCount> SearchHandlers;
+
+    // Shared so copies of the finder use the same workers, created on first use
+    std::shared_ptr<ThreadPool> Pool;
+
+    // Members of each find group (see TGroup::Members)
+    std::unordered_map<std::string, std::vector<TSearchFor*>> GroupMembers;
+
+    // Normal regions grouped by shared state (XReference targets, find groups).
+    // Each entry runs serially in config order, entries run concurrently. See BuildSearchPlan().
+    std::vector<std::vector<TSearchRegion*>> RegionSchedule;
+
+    // Position of each FoundList entry in the serial search order,
+    // used to restore that order after a concurrent search.
+    std::vector<std::vector<std::size_t>> FoundOrder;
+
+    std::mutex FoundMutex;
+    std::mutex JSONMutex;
+    std::mutex StringAnchorMutex;
 
     bool SavePESections();
+    void BuildSearchPlan(std::vector<TSearchRegion>& Regions);
+    ThreadPool& GetThreadPool();
+    void ResolveStringAnchors(const std::vector<TSearchRegion>& Regions);
+    std::optional<std::uint64_t> FindStringAnchor(const TAnchor& Anchor);
 
   public:
     // These are used by SearchHandlers
@@ -216,6 +265,13 @@ namespace COF
 
     void UseSearchHandlers(std::vector<SearchHandler> SearchHandlers);
     void UseRegionHandler(const std::function<bool(OffsetFinder*, TSearchRegion&)>& RegionHandler);
+    bool UseInstructionStore();
+
+    // Threads used by the searches, including the calling thread (0 = all hardware threads, 1 = serial)
+    void UseThreads(std::size_t ThreadCount);
+
+    // Whether Init() may load/save the analysis index file of the dump (default true)
+    void UseIndexFile(bool Enable);
 
     bool Init(const std::string& FilePath);
     bool Init(std::uint32_t PID, const std::string& FilePath);
@@ -0,0 +1,844 @@
+#include "PatternScanner.h"
+
+#include <array>
+#include <algorithm>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define COF_TARGET_AVX2
+#else
+#define COF_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace COF
+{
+  namespace PatternScanner
+  {
+    namespace
+    {
+      // Bytes that are very common in x64 code, most common first.
+      // Every other byte is considered equally rare.
+      constexpr std::uint8_t CommonBytes[] = {
+        0x00, 0xFF, 0xCC, 0x48, 0x8B, 0x89, 0x24, 0x0F, 0xE8, 0x4C,
+        0x01, 0x44, 0x8D, 0x85, 0x45, 0x20, 0x08, 0x10, 0x74, 0x83,
+        0xC0, 0x41, 0x49, 0x75, 0x4D, 0xC3, 0x40, 0x28, 0x30, 0x18,
+        0x38, 0x84, 0x33, 0xEB, 0xC7, 0x90, 0x02, 0x03, 0x04, 0x80,
+        0x50, 0x58, 0x5C, 0x54, 0x15, 0x05, 0x0D, 0x1D, 0x25, 0x35
+      };
+
+      // Lower is rarer
+      constexpr std::array<std::uint8_t, 256> MakeByteRanks()
+      {
+        std::array<std::uint8_t, 256> Ranks{};
+        constexpr std::size_t Count = sizeof(CommonBytes);
+
+        for (std::size_t I = 0; I < Count; ++I)
+        {
+          Ranks[CommonBytes[I]] = static_cast<std::uint8_t>(Count - I);
+        }
+
+        return Ranks;
+      }
+
+      constexpr std::array<std::uint8_t, 256> ByteRanks = MakeByteRanks();
+
+      constexpr std::size_t MaxVectorSize = 32;
+
+      int PopCount(std::uint8_t Byte)
+      {
+        int Count = 0;
+
+        for (; Byte; Byte &= Byte - 1)
+        {
+          ++Count;
+        }
+
+        return Count;
+      }
+
+      // Higher is rarer, fully specified bytes rank above any partially specified one
+      int ElementScore(std::uint8_t Mask, std::uint8_t Value)
+      {
+        return (Mask == 0xFF)
+          ? 0x100 + (0xFF - ByteRanks[Value])
+          : PopCount(Mask);
+      }
+
+      unsigned CountTrailingZeros(std::uint32_t Value)
+      {
+#if defined(_MSC_VER)
+        unsigned long Index;
+        _BitScanForward(&Index, Value);
+        return static_cast<unsigned>(Index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(Value));
+#endif
+      }
+
+      std::optional<std::uint8_t> ParseNibble(char Char)
+      {
+        if (Char >= '0' && Char <= '9')
+        {
+          return static_cast<std::uint8_t>(Char - '0');
+        }
+
+        if (Char >= 'a' && Char <= 'f')
+        {
+          return static_cast<std::uint8_t>(Char - 'a' + 10);
+        }
+
+        if (Char >= 'A' && Char <= 'F')
+        {
+          return static_cast<std::uint8_t>(Char - 'A' + 10);
+        }
+
+        return std::nullopt;
+      }
+
+      bool VerifyScalar(const CompiledPattern& P, const std::uint8_t* Candidate, std::size_t From)
+      {
+        for (std::size_t I = From; I < P.GetSize(); ++I)
+        {
+          if ((Candidate[I] & P.GetMasks()[I]) != P.GetValues()[I])
+          {
+            return false;
+          }
+        }
+
+        return true;
+      }
+
+      // Horspool over masked elements, used when there is nothing to anchor the vector kernels on
+      std::optional<std::size_t> FindScalar(const CompiledPattern& P, const std::uint8_t* Data, std::size_t Size)
+      {
+        const std::size_t PatternSize = P.GetSize();
+
+        if (!PatternSize)
+        {
+          return 0;
+        }
+
+        for (std::size_t Index = 0; Index <= Size - PatternSize; Index += P.GetSkip(Data[Index + PatternSize - 1]))
+        {
+          if (VerifyScalar(P, Data + Index, 0))
+          {
+            return Index;
+          }
+        }
+
+        return std::nullopt;
+      }
+
+      // Available is the number of readable bytes at Candidate
+      bool VerifySse2(const CompiledPattern& P, const std::uint8_t* Candidate, std::size_t From, std::size_t Available)
+      {
+        std::size_t I = From;
+
+        // Padding bytes have a zero mask and value and always match
+        for (; I < P.GetSize() && I + 16 <= Available; I += 16)
+        {
+          __m128i Bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Candidate + I));
+          __m128i Masks = _mm_loadu_si128(reinterpret_cast<const __m128i*>(P.GetMasks() + I));
+          __m128i Values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(P.GetValues() + I));
+          __m128i Equal = _mm_cmpeq_epi8(_mm_and_si128(Bytes, Masks), Values);
+
+          if (_mm_movemask_epi8(Equal) != 0xFFFF)
+          {
+            return false;
+          }
+        }
+
+        return VerifyScalar(P, Candidate, I);
+      }
+
+      std::optional<std::size_t> FindSse2(const CompiledPattern& P, const std::uint8_t* Data, std::size_t Size)
+      {
+        const std::size_t Last = Size - P.GetSize();
+        const __m128i AnchorMask = _mm_set1_epi8(static_cast<char>(P.GetAnchorMask()));
+        const __m128i AnchorValue = _mm_set1_epi8(static_cast<char>(P.GetAnchorValue()));
+        std::size_t Start = 0;
+
+        for (; Start <= Last && Start + P.GetAnchor() + 16 <= Size; Start += 16)
+        {
+          __m128i Bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data + Start + P.GetAnchor()));
+          __m128i Equal = _mm_cmpeq_epi8(_mm_and_si128(Bytes, AnchorMask), AnchorValue);
+          std::uint32_t Hits = static_cast<std::uint32_t>(_mm_movemask_epi8(Equal));
+
+          for (; Hits; Hits &= Hits - 1)
+          {
+            std::size_t Candidate = Start + CountTrailingZeros(Hits);
+
+            if (Candidate > Last)
+            {
+              break;
+            }
+
+            if (VerifySse2(P, Data + Candidate, 0, Size - Candidate))
+            {
+              return Candidate;
+            }
+          }
+        }
+
+        for (; Start <= Last; ++Start)
+        {
+          if (VerifyScalar(P, Data + Start, 0))
+          {
+            return Start;
+          }
+        }
+
+        return std::nullopt;
+      }
+
+      COF_TARGET_AVX2
+      bool VerifyAvx2(const CompiledPattern& P, const std::uint8_t* Candidate, std::size_t Available)
+      {
+        std::size_t I = 0;
+
+        for (; I < P.GetSize() && I + 32 <= Available; I += 32)
+        {
+          __m256i Bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Candidate + I));
+          __m256i Masks = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(P.GetMasks() + I));
+          __m256i Values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(P.GetValues() + I));
+          __m256i Equal = _mm256_cmpeq_epi8(_mm256_and_si256(Bytes, Masks), Values);
+
+          if (static_cast<std::uint32_t>(_mm256_movemask_epi8(Equal)) != 0xFFFFFFFF)
+          {
+            return false;
+          }
+        }
+
+        return VerifySse2(P, Candidate, I, Available);
+      }
+
+      COF_TARGET_AVX2
+      std::optional<std::size_t> FindAvx2(const CompiledPattern& P, const std::uint8_t* Data, std::size_t Size)
+      {
+        const std::size_t Last = Size - P.GetSize();
+        const __m256i AnchorMask = _mm256_set1_epi8(static_cast<char>(P.GetAnchorMask()));
+        const __m256i AnchorValue = _mm256_set1_epi8(static_cast<char>(P.GetAnchorValue()));
+        std::size_t Start = 0;
+
+        for (; Start <= Last && Start + P.GetAnchor() + 32 <= Size; Start += 32)
+        {
+          __m256i Bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Data + Start + P.GetAnchor()));
+          __m256i Equal = _mm256_cmpeq_epi8(_mm256_and_si256(Bytes, AnchorMask), AnchorValue);
+          std::uint32_t Hits = static_cast<std::uint32_t>(_mm256_movemask_epi8(Equal));
+
+          for (; Hits; Hits &= Hits - 1)
+          {
+            std::size_t Candidate = Start + CountTrailingZeros(Hits);
+
+            if (Candidate > Last)
+            {
+              break;
+            }
+
+            if (VerifyAvx2(P, Data + Candidate, Size - Candidate))
+            {
+              return Candidate;
+            }
+          }
+        }
+
+        // Less than a full vector left, finish with SSE2 (which handles its own tail)
+        if (Start <= Last)
+        {
+          if (auto Found = FindSse2(P, Data + Start, Size - Start))
+          {
+            return Start + *Found;
+          }
+        }
+
+        return std::nullopt;
+      }
+
+      // Counts mismatching elements at Candidate, gives up once Budget is exceeded
+      std::size_t CountMismatches(const CompiledPattern& P, const std::uint8_t* Candidate, std::size_t Budget)
+      {
+        std::size_t Mismatches = 0;
+
+        for (std::uint32_t I : P.GetRarestFirst())
+        {
+          if ((Candidate[I] & P.GetMasks()[I]) != P.GetValues()[I] && ++Mismatches > Budget)
+          {
+            break;
+          }
+        }
+
+        return Mismatches;
+      }
+
+      // Best match starting at or after From, a position only counts if it beats the previous best
+      std::optional<ApproximateMatch> FindApproximateScalar(const CompiledPattern& P, const std::uint8_t* Data, std::size_t Size,
+        std::size_t From, std::size_t Budget)
+      {
+        std::optional<ApproximateMatch> Best;
+
+        for (std::size_t Start = From; Start <= Size - P.GetSize(); ++Start)
+        {
+          std::size_t Mismatches = CountMismatches(P, Data + Start, Budget);
+
+          if (Mismatches > Budget)
+          {
+            continue;
+          }
+
+          Best = ApproximateMatch{ Start, Mismatches };
+
+          if (!Mismatches)
+          {
+            break;
+          }
+
+          Budget = Mismatches - 1;
+        }
+
+        return Best;
+      }
+
+      // Lane with the fewest mismatches (lowest one on ties) of those within Budget,
+      // Counts are the per lane mismatch counts of a block.
+      std::optional<ApproximateMatch> PickLane(const std::uint8_t* Counts, std::size_t Lanes, std::size_t Budget)
+      {
+        std::optional<ApproximateMatch> Best;
+
+        for (std::size_t Lane = 0; Lane < Lanes; ++Lane)
+        {
+          if (Counts[Lane] <= Budget && (!Best || Counts[Lane] < Best->Mismatches))
+          {
+            Best = ApproximateMatch{ Lane, Counts[Lane] };
+          }
+        }
+
+        return Best;
+      }
+
+      // Mismatch counts of 16 consecutive positions are kept in the lanes of one vector (saturating at 0xFF).
+      // Budget must be below 0xFF.
+      std::optional<ApproximateMatch> FindApproximateSse2(const CompiledPattern& P, const std::uint8_t* Data, std::size_t Size,
+        std::size_t Budget)
+      {
+        const std::size_t Last = Size - P.GetSize();
+        const __m128i One = _mm_set1_epi8(1);
+        __m128i Limit = _mm_set1_epi8(static_cast<char>(Budget + 1));
+        std::optional<ApproximateMatch> Best;
+        std::size_t Start = 0;
+
+        // Only whole blocks, every lane must be a valid position
+        for (; Start + 16 <= Last + 1; Start += 16)
+        {
+          __m128i Counts = _mm_setzero_si128();
+          bool OverBudget = false;
+
+          for (std::uint32_t I : P.GetRarestFirst())
+          {
+            __m128i Bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data + Start + I));
+            __m128i Mask = _mm_set1_epi8(static_cast<char>(P.GetMasks()[I]));
+            __m128i Value = _mm_set1_epi8(static_cast<char>(P.GetValues()[I]));
+            __m128i Equal = _mm_cmpeq_epi8(_mm_and_si128(Bytes, Mask), Value);
+            Counts = _mm_adds_epu8(Counts, _mm_andnot_si128(Equal, One));
+
+            // Every lane has at least Limit mismatches
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(Counts, Limit), Counts)) == 0xFFFF)
+            {
+              OverBudget = true;
+              break;
+            }
+          }
+
+          if (OverBudget)
+          {
+            continue;
+          }
+
+          alignas(16) std::uint8_t Lanes[16];
+          _mm_store_si128(reinterpret_cast<__m128i*>(Lanes), Counts);
+
+          if (auto Lane = PickLane(Lanes, 16, Budget))
+          {
+            Best = ApproximateMatch{ Start + Lane->Offset, Lane->Mismatches };
+
+            if (!Best->Mismatches)
+            {
+              return Best;
+            }
+
+            Budget = Best->Mismatches - 1;
+            Limit = _mm_set1_epi8(static_cast<char>(Budget + 1));
+          }
+        }
+
+        if (Start <= Last)
+        {
+          if (auto Tail = FindApproximateScalar(P, Data, Size, Start, Budget))
+          {
+            Best = Tail;
+          }
+        }
+
+        return Best;
+      }
+
+      COF_TARGET_AVX2
+      std::optional<ApproximateMatch> FindApproximateAvx2(const CompiledPattern& P, const std::uint8_t* Data, std::size_t Size,
+        std::size_t Budget)
+      {
+        const std::size_t Last = Size - P.GetSize();
+        const __m256i One = _mm256_set1_epi8(1);
+        __m256i Limit = _mm256_set1_epi8(static_cast<char>(Budget + 1));
+        std::optional<ApproximateMatch> Best;
+        std::size_t Start = 0;
+
+        for (; Start + 32 <= Last + 1; Start += 32)
+        {
+          __m256i Counts = _mm256_setzero_si256();
+          bool OverBudget = false;
+
+          for (std::uint32_t I : P.GetRarestFirst())
+          {
+            __m256i Bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Data + Start + I));
+            __m256i Mask = _mm256_set1_epi8(static_cast<char>(P.GetMasks()[I]));
+            __m256i Value = _mm256_set1_epi8(static_cast<char>(P.GetValues()[I]));
+            __m256i Equal = _mm256_cmpeq_epi8(_mm256_and_si256(Bytes, Mask), Value);
+            Counts = _mm256_adds_epu8(Counts, _mm256_andnot_si256(Equal, One));
+
+            if (static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(Counts, Limit), Counts))) == 0xFFFFFFFF)
+            {
+              OverBudget = true;
+              break;
+            }
+          }
+
+          if (OverBudget)
+          {
+            continue;
+          }
+
+          alignas(32) std::uint8_t Lanes[32];
+          _mm256_store_si256(reinterpret_cast<__m256i*>(Lanes), Counts);
+
+          if (auto Lane = PickLane(Lanes, 32, Budget))
+          {
+            Best = ApproximateMatch{ Start + Lane->Offset, Lane->Mismatches };
+
+            if (!Best->Mismatches)
+            {
+              return Best;
+            }
+
+            Budget = Best->Mismatches - 1;
+            Limit = _mm256_set1_epi8(static_cast<char>(Budget + 1));
+          }
+        }
+
+        // Less than a full vector left, finish with SSE2 (which handles its own tail)
+        if (Start <= Last)
+        {
+          if (auto Tail = FindApproximateSse2(P, Data + Start, Size - Start, Budget))
+          {
+            Best = ApproximateMatch{ Start + Tail->Offset, Tail->Mismatches };
+          }
+        }
+
+        return Best;
+      }
+
+      bool IsAvx2Supported()
+      {
+#if defined(_MSC_VER)
+        int Info[4];
+        __cpuid(Info, 0);
+
+        if (Info[0] < 7)
+        {
+          return false;
+        }
+
+        // AVX and OSXSAVE, and the OS must save the YMM registers
+        __cpuid(Info, 1);
+
+        if ((Info[2] & (1 << 27)) == 0 || (Info[2] & (1 << 28)) == 0)
+        {
+          return false;
+        }
+
+        if ((_xgetbv(0) & 0x6) != 0x6)
+        {
+          return false;
+        }
+
+        __cpuidex(Info, 7, 0);
+        return (Info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+      }
+    }
+
+    std::optional<Capture> Capture::Parse(const std::string& Token)
+    {
+      static const std::pair<const char*, Capture::Kind> Kinds[] = {
+        { "rel", Capture::Kind::Relative },
+        { "u", Capture::Kind::Unsigned },
+        { "i", Capture::Kind::Signed }
+      };
+
+      if (Token.size() < 4 || Token.front() != '{' || Token.back() != '}')
+      {
+        return std::nullopt;
+      }
+
+      std::string Body = Token.substr(1, Token.size() - 2);
+      Capture Out;
+      std::size_t Prefix = 0;
+
+      for (const auto& [Name, Type] : Kinds)
+      {
+        if (Body.rfind(Name, 0) == 0)
+        {
+          Out.Type = Type;
+          Prefix = std::strlen(Name);
+          break;
+        }
+      }
+
+      if (!Prefix)
+      {
+        return std::nullopt;
+      }
+
+      char* End = nullptr;
+      unsigned long Bits = std::strtoul(Body.c_str() + Prefix, &End, 10);
+
+      if (Bits != 8 && Bits != 16 && Bits != 32 && Bits != 64)
+      {
+        return std::nullopt;
+      }
+
+      Out.Size = static_cast<std::uint8_t>(Bits / CHAR_BIT);
+
+      // Bytes between the relative value and the instruction end
+      if (*End == '+' && Out.Type == Capture::Kind::Relative)
+      {
+        const char* TailStart = End + 1;
+        unsigned long Tail = std::strtoul(TailStart, &End, 10);
+
+        if (End == TailStart || Tail > 0xFF)
+        {
+          return std::nullopt;
+        }
+
+        Out.Tail = static_cast<std::uint8_t>(Tail);
+      }
+
+      if (*End != '\0')
+      {
+        return std::nullopt;
+      }
+
+      return Out;
+    }
+
+    std::uint64_t Capture::Resolve(const std::uint8_t* Bytes, std::uint64_t CaptureOffset) const
+    {
+      std::uint64_t Value = 0;
+      std::memcpy(&Value, Bytes, this->Size);
+
+      if (this->Type != Kind::Unsigned && this->Size < sizeof(Value))
+      {
+        // Sign extend
+        const std::size_t Shift = (sizeof(Value) - this->Size) * CHAR_BIT;
+        Value = static_cast<std::uint64_t>(static_cast<std::int64_t>(Value << Shift) >> Shift);
+      }
+
+      if (this->Type == Kind::Relative)
+      {
+        Value += CaptureOffset + this->Size + this->Tail;
+      }
+
+      return Value;
+    }
+
+    std::optional<PatternElem> ParseElem(const std::string& Token)
+    {
+      PatternElem Elem{ 0x00, 0x00 };
+
+      if (Token.empty())
+      {
+        return std::nullopt;
+      }
+
+      // Full byte wildcard
+      if (Token == "?" || Token == "??")
+      {
+        Elem = { 0x00, 0x00 };
+      }
+      // Two character token, possibly with '?' nibble
+      else if (Token.size() == 2 && (ParseNibble(Token[0]) || Token[0] == '?')
+        && (ParseNibble(Token[1]) || Token[1] == '?'))
+      {
+        if (auto High = ParseNibble(Token[0]))
+        {
+          Elem.first |= 0xF0;
+          Elem.second |= static_cast<std::uint8_t>(*High << 4);
+        }
+
+        if (auto Low = ParseNibble(Token[1]))
+        {
+          Elem.first |= 0x0F;
+          Elem.second |= *Low;
+        }
+      }
+      // Fixed byte
+      else
+      {
+        char* End = nullptr;
+        unsigned long ByteValue = std::strtoul(Token.c_str(), &End, 16);
+
+        if (End == Token.c_str())
+        {
+          return std::nullopt;
+        }
+
+        Elem = { 0xFF, static_cast<std::uint8_t>(ByteValue) };
+      }
+
+      return Elem;
+    }
+
+    CompiledPattern::CompiledPattern(const std::vector<PatternElem>& Pattern, std::vector<Capture> Captures)
+      : Captures(std::move(Captures))
+    {
+      this->Size = Pattern.size();
+
+      const std::size_t Padded = (this->Size + MaxVectorSize - 1) / MaxVectorSize * MaxVectorSize;
+      this->Masks.assign(Padded, 0);
+      this->Values.assign(Padded, 0);
+
+      // Prefer the rarest fully specified byte,
+      // otherwise fall back to the element with the most specified bits.
+      int BestScore = -1;
+
+      for (std::size_t I = 0; I < this->Size; ++I)
+      {
+        auto [Mask, Value] = Pattern[I];
+        this->Masks[I] = Mask;
+        this->Values[I] = Value;
+
+        if (!Mask)
+        {
+          continue;
+        }
+
+        int Score = ElementScore(Mask, Value);
+        this->RarestFirst.push_back(static_cast<std::uint32_t>(I));
+
+        if (Score > BestScore)
+        {
+          BestScore = Score;
+          this->Anchor = I;
+          this->AnchorMask = Mask;
+          this->AnchorValue = Value;
+        }
+      }
+
+      std::stable_sort(this->RarestFirst.begin(), this->RarestFirst.end(), [&](std::uint32_t Left, std::uint32_t Right)
+      {
+        return ElementScore(this->Masks[Left], this->Values[Left]) > ElementScore(this->Masks[Right], this->Values[Right]);
+      });
+
+      // Shift to the closest element (before the last one) that accepts the byte,
+      // a wildcard accepts every byte and caps the shift.
+      for (std::size_t Byte = 0; Byte < 256; ++Byte)
+      {
+        std::size_t Shift = (std::max)(this->Size, static_cast<std::size_t>(1));
+
+        for (std::size_t I = 0; I + 1 < this->Size; ++I)
+        {
+          if ((Byte & this->Masks[I]) == this->Values[I])
+          {
+            Shift = this->Size - 1 - I;
+          }
+        }
+
+        this->Skip[Byte] = static_cast<std::uint32_t>(Shift);
+      }
+    }
+
+    std::optional<CompiledPattern> CompiledPattern::Parse(const std::string& IdaPattern)
+    {
+      std::vector<PatternElem> Pattern;
+      std::vector<Capture> Captures;
+      std::istringstream Stream(IdaPattern);
+      std::string Token;
+
+      while (Stream >> Token)
+      {
+        // Capture, its bytes are wildcards
+        if (Token.front() == '{')
+        {
+          auto Parsed = Capture::Parse(Token);
+
+          if (!Parsed)
+          {
+            return std::nullopt;
+          }
+
+          Parsed->Offset = Pattern.size();
+          Pattern.insert(Pattern.end(), Parsed->Size, PatternElem{ 0x00, 0x00 });
+          Captures.push_back(*Parsed);
+          continue;
+        }
+
+        auto Elem = ParseElem(Token);
+
+        if (!Elem)
+        {
+          return std::nullopt;
+        }
+
+        Pattern.push_back(*Elem);
+      }
+
+      return CompiledPattern(Pattern, std::move(Captures));
+    }
+
+    std::size_t CompiledPattern::GetSize() const
+    {
+      return this->Size;
+    }
+
+    bool CompiledPattern::IsEmpty() const
+    {
+      return this->Size == 0;
+    }
+
+    const std::vector<Capture>& CompiledPattern::GetCaptures() const
+    {
+      return this->Captures;
+    }
+
+    const std::uint8_t* CompiledPattern::GetMasks() const
+    {
+      return this->Masks.data();
+    }
+
+    const std::uint8_t* CompiledPattern::GetValues() const
+    {
+      return this->Values.data();
+    }
+
+    std::size_t CompiledPattern::GetAnchor() const
+    {
+      return this->Anchor;
+    }
+
+    std::uint8_t CompiledPattern::GetAnchorMask() const
+    {
+      return this->AnchorMask;
+    }
+
+    std::uint8_t CompiledPattern::GetAnchorValue() const
+    {
+      return this->AnchorValue;
+    }
+
+    std::size_t CompiledPattern::GetSkip(std::uint8_t Byte) const
+    {
+      return this->Skip[Byte];
+    }
+
+    const std::vector<std::uint32_t>& CompiledPattern::GetRarestFirst() const
+    {
+      return this->RarestFirst;
+    }
+
+    Kernel GetBestKernel()
+    {
+      static const Kernel Best = IsAvx2Supported() ? Kernel::AVX2 : Kernel::SSE2;
+      return Best;
+    }
+
+    std::optional<std::size_t> Find(const std::uint8_t* Data, std::size_t Size, const CompiledPattern& Pattern)
+    {
+      return Find(GetBestKernel(), Data, Size, Pattern);
+    }
+
+    std::optional<std::size_t> Find(Kernel UseKernel, const std::uint8_t* Data, std::size_t Size, const CompiledPattern& Pattern)
+    {
+      if (Size < Pattern.GetSize())
+      {
+        return std::nullopt;
+      }
+
+      // Nothing to anchor on (empty or all wildcards)
+      if (!Pattern.GetAnchorMask())
+      {
+        UseKernel = Kernel::Scalar;
+      }
+
+      switch (UseKernel)
+      {
+      case Kernel::AVX2:
+        return FindAvx2(Pattern, Data, Size);
+
+      case Kernel::SSE2:
+        return FindSse2(Pattern, Data, Size);
+
+      default:
+        return FindScalar(Pattern, Data, Size);
+      }
+    }
+
+    std::optional<ApproximateMatch> FindApproximate(const std::uint8_t* Data, std::size_t Size, const CompiledPattern& Pattern,
+      std::size_t MaxMismatches)
+    {
+      return FindApproximate(GetBestKernel(), Data, Size, Pattern, MaxMismatches);
+    }
+
+    std::optional<ApproximateMatch> FindApproximate(Kernel UseKernel, const std::uint8_t* Data, std::size_t Size,
+      const CompiledPattern& Pattern, std::size_t MaxMismatches)
+    {
+      // Nothing beats an exact match
+      if (auto Exact = Find(UseKernel, Data, Size, Pattern))
+      {
+        return ApproximateMatch{ *Exact, 0 };
+      }
+
+      if (!MaxMismatches || Size < Pattern.GetSize())
+      {
+        return std::nullopt;
+      }
+
+      // A match never has more mismatches than specified elements
+      std::size_t Budget = (std::min)(MaxMismatches, Pattern.GetRarestFirst().size());
+
+      // The vector kernels count in bytes
+      if (Budget >= 0xFF)
+      {
+        UseKernel = Kernel::Scalar;
+      }
+
+      switch (UseKernel)
+      {
+      case Kernel::AVX2:
+        return FindApproximateAvx2(Pattern, Data, Size, Budget);
+
+      case Kernel::SSE2:
+        return FindApproximateSse2(Pattern, Data, Size, Budget);
+
+      default:
+        return FindApproximateScalar(Pattern, Data, Size, 0, Budget);
+      }
+    }
+  } // !namespace PatternScanner
+} // !namespace COF
@@ -0,0 +1,137 @@
+#ifndef COF_PATTERN_SCANNER_H
+#define COF_PATTERN_SCANNER_H
+
+#include <array>
+#include <vector>
+#include <string>
+#include <utility>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+
+namespace COF
+{
+  // Masked byte pattern search (IDA style patterns, incl. "D?"/"?A" nibble wildcards).
+  // The vector kernels look for a single anchor byte of the pattern (the rarest fully
+  // specified byte) and only verify the whole pattern at positions where the anchor hits.
+  // All kernels return the same result: the lowest matching offset.
+  // Approximate searches count mismatching elements of up to 32 positions at once per vector,
+  // visiting the rarest elements first so a block is dropped as soon as all its lanes are over budget.
+  namespace PatternScanner
+  {
+    using PatternElem = std::pair<std::uint8_t /*Mask*/, std::uint8_t /*Value*/>;
+
+    // Value read straight from the bytes of a match, given as a "{...}" token in the pattern
+    // (e.g. "48 8B 05 {rel32}", "8B 81 {u32}"). The captured bytes match anything.
+    struct Capture
+    {
+      enum class Kind : std::uint8_t
+      {
+        Unsigned, // {u8}, {u16}, {u32}, {u64}
+        Signed,   // {i8}, {i16}, {i32}, {i64}, sign extended to 64 bits
+        Relative  // {rel8}, {rel32}, {rel32+N}: signed, relative to the instruction end
+      };
+
+      std::size_t Offset = 0;  // Of the captured bytes from the start of the pattern
+      std::uint8_t Size = 0;   // In bytes, little endian
+      Kind Type = Kind::Unsigned;
+
+      // Relative only: instruction bytes after the captured ones (e.g. the imm32 of "C7 05 {rel32+4} ...")
+      std::uint8_t Tail = 0;
+
+      // "{u32}", "{i8}", "{rel32}", "{rel32+4}", ... (Offset left at 0), nullopt if invalid
+      static std::optional<Capture> Parse(const std::string& Token);
+
+      // Bytes are the Size captured bytes, CaptureOffset their offset in the address space
+      // relative captures are resolved in.
+      std::uint64_t Resolve(const std::uint8_t* Bytes, std::uint64_t CaptureOffset) const;
+    };
+
+    // Single byte token of a pattern ("48", "4?", "?", "??"), nullopt if invalid
+    std::optional<PatternElem> ParseElem(const std::string& Token);
+
+    // Immutable, ready to scan form of a pattern.
+    // Patterns are compiled once when the search config is loaded
+    // instead of being re-parsed for every region they are searched in.
+    class CompiledPattern
+    {
+      std::size_t Size = 0;
+
+      // Zero padded to a multiple of the widest vector so
+      // the verification never needs a partial load.
+      std::vector<std::uint8_t> Masks;
+      std::vector<std::uint8_t> Values;
+
+      // Element the vector kernels search for
+      std::size_t Anchor = 0;
+      std::uint8_t AnchorMask = 0;
+      std::uint8_t AnchorValue = 0;
+
+      // Horspool shift for the byte under the last pattern element
+      std::array<std::uint32_t, 256> Skip{};
+
+      // Specified (non wildcard) elements, rarest first
+      std::vector<std::uint32_t> RarestFirst;
+
+      std::vector<Capture> Captures;
+
+    public:
+      CompiledPattern() = default;
+      explicit CompiledPattern(const std::vector<PatternElem>& Pattern, std::vector<Capture> Captures = {});
+
+      // Parses an IDA style pattern ("48 8B ? ?? D? 0F", optionally with captures), nullopt on invalid tokens
+      static std::optional<CompiledPattern> Parse(const std::string& IdaPattern);
+
+      std::size_t GetSize() const;
+      bool IsEmpty() const;
+
+      // In pattern order
+      const std::vector<Capture>& GetCaptures() const;
+
+      const std::uint8_t* GetMasks() const;
+      const std::uint8_t* GetValues() const;
+
+      std::size_t GetAnchor() const;
+      std::uint8_t GetAnchorMask() const;
+      std::uint8_t GetAnchorValue() const;
+
+      std::size_t GetSkip(std::uint8_t Byte) const;
+
+      const std::vector<std::uint32_t>& GetRarestFirst() const;
+    };
+
+    enum class Kernel
+    {
+      Scalar,
+      SSE2,
+      AVX2
+    };
+
+    // Best kernel supported by the CPU, detected once
+    Kernel GetBestKernel();
+
+    // Offset of the first match of Pattern in Data, using the best available kernel
+    std::optional<std::size_t> Find(const std::uint8_t* Data, std::size_t Size, const CompiledPattern& Pattern);
+
+    // Same as above with an explicit kernel
+    std::optional<std::size_t> Find(Kernel UseKernel, const std::uint8_t* Data, std::size_t Size, const CompiledPattern& Pattern);
+
+    struct ApproximateMatch
+    {
+      std::size_t Offset = 0;
+      std::size_t Mismatches = 0; // Specified elements the bytes at Offset don't match
+    };
+
+    // Match with the fewest mismatching elements (at most MaxMismatches), the lowest offset of those.
+    // Wildcards never mismatch and a nibble wildcard element counts as a single element.
+    // An exact match is looked for first with Find(), so unchanged patterns cost the same as an exact search.
+    std::optional<ApproximateMatch> FindApproximate(const std::uint8_t* Data, std::size_t Size, const CompiledPattern& Pattern,
+      std::size_t MaxMismatches);
+
+    // Same as above with an explicit kernel
+    std::optional<ApproximateMatch> FindApproximate(Kernel UseKernel, const std::uint8_t* Data, std::size_t Size,
+      const CompiledPattern& Pattern, std::size_t MaxMismatches);
+  } // !namespace PatternScanner
+} // !namespace COF
+
+#endif // !COF_PATTERN_SCANNER_H
@@ -6,6 +6,7 @@
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <cstddef>
 
 // Defines the criteria to search by (region, access, etc.)
 // and related stuff.
@@ -43,6 +44,9 @@ namespace COF
       TslDecryptor64,
     };
 
+    // Number of SearchType values, for tables indexed by SearchType
+    constexpr std::size_t SearchTypeCount = static_cast<std::size_t>(SearchType::TslDecryptor64) + 1;
+
     enum class MatcherMode
     {
       None,  // Some search items dont define matchers
@@ -69,6 +73,12 @@ namespace COF
       InstructionSubsequence
     };
 
+    enum class StringEncoding
+    {
+      UTF16LE, // Default, wide strings (e.g. UE FName/FString literals)
+      ASCII
+    };
+
     // String maps for the enum types above,
     // so we can deal with the JSON search configuration file.
 
@@ -128,6 +138,12 @@ namespace COF
       { "InstructionSubsequence", AnchorType::InstructionSubsequence }
     };
 
+    inline std::unordered_map<std::string, StringEncoding> StringEncodings =
+    {
+      { "UTF16LE", StringEncoding::UTF16LE },
+      { "ASCII", StringEncoding::ASCII }
+    };
+
     template <typename EnumType>
     std::string ToString(const std::unordered_map<std::string, EnumType>& Map, EnumType Value)
     {
@@ -46,8 +46,11 @@ namespace COF
               return false;
             }
 
-            if (SearchCriteria::RegionIDs[Region.RegionID] ==
-              SearchCriteria::RegionID::Section_Text)
+            // Lookup without operator[], regions may be handled concurrently
+            auto RegionID = SearchCriteria::RegionIDs.find(Region.RegionID);
+
+            if (RegionID != SearchCriteria::RegionIDs.end() &&
+              RegionID->second == SearchCriteria::RegionID::Section_Text)
             {
               auto Section = Sections->GetSection(".text");
 
@@ -227,27 +230,24 @@ namespace COF
       bool XReferenceHandled = false;
 
       // Go to reagion/function in the offset and handle its list of SearchFor...
-      for (auto& SearchRegion : Finder->GetSearchRegions())
+      // NOTE:
+      //  We should't have to check if NextRegion has a value
+      //  because if we've already reached this point then it must.
+      //  We can therefore safely dereference the std::optional.
+      if (TSearchRegion* SearchRegion = ToFind.NextRegion->Region; SearchRegion)
       {
-        // NOTE:
-        //  We should't have to check if NextRegion has a value
-        //  because if we've already reached this point then it must.
-        //  We can therefore safely dereference the std::optional.
-        if (SearchRegion.RegionID == ToFind.NextRegion->ID)
+        if (SearchRegion->AccessType != SearchCriteria::AccessType::XReference)
+        {
+          COF_LOG("[!] Found matching region but AccessType is not 'XReference'! Skipping...");
+        }
+        else
         {
-          if (SearchRegion.AccessType != SearchCriteria::AccessType::XReference)
-          {
-            COF_LOG("[!] Found matching region but AccessType is not 'XReference'! Skipping...");
-            continue;
-          }
-
           // Set base address of XReferenced region,
           // then handle the regions finds next.
-          SearchRegion.RegionRange.Offset = *Extracted->Value;
-          Finder->HandleExpectedFinds(SearchRegion);
+          SearchRegion->RegionRange.Offset = *Extracted->Value;
+          Finder->HandleExpectedFinds(*SearchRegion);
 
           XReferenceHandled = true;
-          break; // We only wanna handle XReferenced region.
         }
       }
 
@@ -296,31 +296,25 @@ namespace COF
       // to handle them here.
       if (ToFind.Group)
       {
-        for (auto& Region : Finder->GetSearchRegions())
+        for (TSearchFor* Member : *ToFind.Group->Members)
         {
-          for (auto& Find : Region.SearchFor)
-          {
-            const auto& Group = Find.Group;
+          auto& Find = *Member;
 
-            if (Group && Group->ID == ToFind.Group->ID)
-            {
-              if (Find.SearchType != ToFind.SearchType)
-              {
-                COF_LOG("[!] Grouped finds must be of same type (Type: %s)! Skipping...",
-                  SearchCriteria::ToString(SearchCriteria::SearchTypes, ToFind.SearchType).c_str());
+          if (Find.SearchType != ToFind.SearchType)
+          {
+            COF_LOG("[!] Grouped finds must be of same type (Type: %s)! Skipping...",
+              SearchCriteria::ToString(SearchCriteria::SearchTypes, ToFind.SearchType).c_str());
 
-                // Mark as handled or handle later? Dilemma.
-                // Find.Handled = true;
-                continue;
-              }
+            // Mark as handled or handle later? Dilemma.
+            // Find.Handled = true;
+            continue;
+          }
 
-              GroupedFinds.push_back(Find);
+          GroupedFinds.push_back(Find);
 
-              // Mark group member as handled to exclude it
-              // from future handling sice we're already handling it here now.
-              Find.Handled = true;
-            }
-          }
+          // Mark group member as handled to exclude it
+          // from future handling sice we're already handling it here now.
+          Find.Handled = true;
         }
 
         // We are strict here, to encourage updating offsets/patterns when needed.
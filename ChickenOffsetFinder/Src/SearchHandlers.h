@@ -23,11 +23,14 @@ namespace COF
       TRange SetBoundaries(const TSearchRegion& Region, const TSearchFor& ToFind);
 
       // Generic central value extractor for simple values (displacement, immediate, reference etc.).
+      // Extractor is any callable (StartOffset, Size) -> std::optional<DumpAnalyzer::Result<T>>.
+      // If a matching (sub)pattern has a capture (e.g. "{rel32}") its value is used instead,
+      // so the Extractor never decodes the matched instruction.
       // TODO: MatcherCoverage should be returned with the return statement
-      template <typename T = DumpAnalyzer::Result<std::uint64_t>>
+      template <typename T = DumpAnalyzer::Result<std::uint64_t>, typename ExtractorT>
       inline std::optional<DumpAnalyzer::Result<T>>
         ValueExtractingHandler(OffsetFinder* Finder, const TSearchRegion& Region, TSearchFor& ToFind, TRange* MatcherCoverage,
-          std::function<std::optional<DumpAnalyzer::Result<T>>(std::uint64_t, std::size_t)> Extractor)
+          ExtractorT&& Extractor)
       {
         // First set scan boundaries. We don't want to overshoot our region
         // address space and scan somewhere else.
@@ -41,6 +44,9 @@ namespace COF
         std::size_t SuccessfulMatches = 0;
         std::size_t ToMatch = 0;
 
+        // Value of the first successful pattern matcher with a capture
+        std::optional<DumpAnalyzer::Result<std::uint64_t>> Captured;
+
         // Maybe too pedantic here? Whatever
         if (ToFind.MatcherMode != SearchCriteria::MatcherMode::None)
         {
@@ -60,8 +66,31 @@ namespace COF
           ToMatch = NumMatchers;
         }
 
-        for (const auto& Matcher : ToFind.Matchers)
+        // Instruction matchers all walk the same window, so they are evaluated together in a
+        // single pass (once the first of them is reached) instead of decoding the window once each.
+        std::vector<DumpAnalyzer::InstructionMatcher> InstructionMatchers;
+        std::vector<std::size_t> InstructionMatcherSlots(NumMatchers);
+        std::optional<std::vector<std::optional<DumpAnalyzer::Result<std::vector<DumpAnalyzer::MatchRange>>>>> InstructionMatches;
+
+        for (std::size_t I = 0; I < NumMatchers; ++I)
         {
+          const auto& Matcher = ToFind.Matchers[I];
+          InstructionMatcherSlots[I] = InstructionMatchers.size();
+
+          if (Matcher.Type == SearchCriteria::MatcherType::InstructionSequence)
+          {
+            InstructionMatchers.push_back({ &Matcher.InstructionSequence, false });
+          }
+          else if (Matcher.Type == SearchCriteria::MatcherType::InstructionSubsequence)
+          {
+            InstructionMatchers.push_back({ &Matcher.InstructionSubsequence, true });
+          }
+        }
+
+        for (std::size_t I = 0; I < NumMatchers; ++I)
+        {
+          const auto& Matcher = ToFind.Matchers[I];
+
           COF_LOG("[>] Locating target instruction with '%s'",
             SearchCriteria::ToString(SearchCriteria::MatcherTypes, Matcher.Type).c_str());
 
@@ -74,81 +103,67 @@ namespace COF
             ++SuccessfulMatches;
           };
 
-          if (Matcher.Type == SearchCriteria::MatcherType::Pattern)
+          if (Matcher.Type == SearchCriteria::MatcherType::Pattern && Matcher.MaxMismatches)
           {
             if (auto Found = Finder->GetAnalyzer()
-              .FindPattern(RegionRange.Offset + Range.Offset, Range.Size, Matcher.Pattern); Found)
-            {              
+              .FindApproximatePattern(RegionRange.Offset + Range.Offset, Range.Size, Matcher.Pattern, Matcher.MaxMismatches); Found)
+            {
+              if (*Found->Value)
+              {
+                COF_LOG("[?] Pattern matched with (%d) mismatching byte(s) at (0x%llX)", *Found->Value, Found->Range.Offset);
+              }
+
               PostMatching(Found->Range.Offset, Found->Range.Size);
+
+              if (!Captured)
+              {
+                Captured = Finder->GetAnalyzer().ExtractCapture(Found->Range.Offset, Matcher.Pattern);
+              }
             }
           }
-          else if (Matcher.Type == SearchCriteria::MatcherType::PatternSubsequence)
+          else if (Matcher.Type == SearchCriteria::MatcherType::Pattern)
           {
             if (auto Found = Finder->GetAnalyzer()
-              .FindPatternSubsequence(RegionRange.Offset + Range.Offset, Range.Size, Matcher.PatternSubsequence); Found)
-            {
-              const auto& SubsequenceRange = (*Found->Value)[Matcher.Index];
-              PostMatching(SubsequenceRange.Offset, SubsequenceRange.Size);
-            }
-          }
-          else if (Matcher.Type == SearchCriteria::MatcherType::InstructionSequence)
-          {
-            std::vector<AssemblyParser::ParsedInstruction> ParsedInstructions;
-
-            for (const auto& AsmText : Matcher.InstructionSequence)
+              .FindPattern(RegionRange.Offset + Range.Offset, Range.Size, Matcher.Pattern); Found)
             {
-              auto Instruction = COF::AssemblyParser::ParseInstruction(AsmText);
+              PostMatching(Found->Range.Offset, Found->Range.Size);
 
-              if (!Instruction)
+              if (!Captured)
               {
-                COF_LOG("[!] Parsing instruction (%s) in sequence failed!", AsmText.c_str());
-                return std::nullopt;
+                Captured = Finder->GetAnalyzer().ExtractCapture(Found->Range.Offset, Matcher.Pattern);
               }
-
-              ParsedInstructions.push_back(*Instruction);
-            }
-
-            if (ParsedInstructions.empty())
-            {
-              COF_LOG("[!] No sequence instructions were parsed!");
-              return std::nullopt;
-            }
-
-            if (auto Found = Finder->GetAnalyzer()
-              .FindInstructionSequence(RegionRange.Offset + Range.Offset, Range.Size, ParsedInstructions); Found)
-            {
-              const auto& SequenceRange = (*Found->Value)[Matcher.Index];
-              PostMatching(SequenceRange.Offset, SequenceRange.Size);
             }
           }
-          else if (Matcher.Type == SearchCriteria::MatcherType::InstructionSubsequence)
+          else if (Matcher.Type == SearchCriteria::MatcherType::PatternSubsequence)
           {
-            std::vector<AssemblyParser::ParsedInstruction> ParsedInstructions;
-
-            for (const auto& AsmText : Matcher.InstructionSubsequence)
+            if (auto Found = Finder->GetAnalyzer()
+              .FindPatternSubsequence(RegionRange.Offset + Range.Offset, Range.Size, Matcher.PatternSubsequence); Found)
             {
-              auto Instruction = COF::AssemblyParser::ParseInstruction(AsmText);
+              const auto& SubsequenceRange = (*Found->Value)[Matcher.Index];
+              PostMatching(SubsequenceRange.Offset, SubsequenceRange.Size);
 
-              if (!Instruction)
+              if (!Captured)
               {
-                COF_LOG("[!] Parsing instruction (%s) in subsequence failed!", AsmText.c_str());
-                return std::nullopt;
+                Captured = Finder->GetAnalyzer()
+                  .ExtractCapture(SubsequenceRange.Offset, Matcher.PatternSubsequence.GetElements()[Matcher.Index]);
               }
-
-              ParsedInstructions.push_back(*Instruction);
             }
-
-            if (ParsedInstructions.empty())
+          }
+          else if (Matcher.Type == SearchCriteria::MatcherType::InstructionSequence ||
+            Matcher.Type == SearchCriteria::MatcherType::InstructionSubsequence)
+          {
+            if (!InstructionMatches)
             {
-              COF_LOG("[!] No subsequence instructions were parsed!");
-              return std::nullopt;
+              // First instruction matcher reached, evaluate it together with the later ones.
+              // In 'First' mode the walk stops as soon as the earliest of them matched.
+              InstructionMatches = Finder->GetAnalyzer()
+                .FindInstructionMatches(RegionRange.Offset + Range.Offset, Range.Size, InstructionMatchers, ToMatch == 1);
             }
 
-            if (auto Found = Finder->GetAnalyzer()
-              .FindInstructionSubsequence(RegionRange.Offset + Range.Offset, Range.Size, ParsedInstructions); Found)
+            if (const auto& Found = (*InstructionMatches)[InstructionMatcherSlots[I]]; Found)
             {
-              const auto& SubsequenceRange = (*Found->Value)[Matcher.Index];
-              PostMatching(SubsequenceRange.Offset, SubsequenceRange.Size);
+              const auto& SequenceRange = (*Found->Value)[Matcher.Index];
+              PostMatching(SequenceRange.Offset, SequenceRange.Size);
             }
           }
 
@@ -242,6 +257,11 @@ namespace COF
             Extracted = *FoundTarget;
           }
         }
+        else if (Captured)
+        {
+          // Value was captured by a pattern matcher already
+          Extracted = DumpAnalyzer::Result<T>{ Captured->Range, static_cast<T>(*Captured->Value) };
+        }
         else
         {
           // Instruction base is known from matchers above,
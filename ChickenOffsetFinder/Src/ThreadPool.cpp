@@ -0,0 +1,133 @@
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <algorithm>
+#include <iterator>
+
+namespace COF
+{
+  ThreadPool::ThreadPool(std::size_t ThreadCount)
+  {
+    if (!ThreadCount)
+    {
+      ThreadCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+    }
+
+    // The calling thread is one of them
+    for (std::size_t I = 1; I < ThreadCount; ++I)
+    {
+      this->Workers.emplace_back([this]()
+      {
+        this->WorkerLoop();
+      });
+    }
+  }
+
+  ThreadPool::~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> Lock(this->Mutex);
+      this->Stopping = true;
+    }
+
+    this->TaskAvailable.notify_all();
+
+    for (auto& Worker : this->Workers)
+    {
+      Worker.join();
+    }
+  }
+
+  std::size_t ThreadPool::GetThreadCount() const
+  {
+    return this->Workers.size() + 1;
+  }
+
+  void ThreadPool::WorkerLoop()
+  {
+    std::unique_lock<std::mutex> Lock(this->Mutex);
+
+    for (;;)
+    {
+      this->TaskAvailable.wait(Lock, [this]()
+      {
+        return this->Stopping || !this->Tasks.empty();
+      });
+
+      if (this->Tasks.empty())
+      {
+        return; // Stopping
+      }
+
+      auto Task = std::move(this->Tasks.front().Run);
+      this->Tasks.pop_front();
+
+      Lock.unlock();
+      Task();
+      Lock.lock();
+    }
+  }
+
+  void ThreadPool::ParallelFor(std::size_t Count, std::size_t ChunkSize,
+    const std::function<void(std::size_t, std::size_t)>& Task)
+  {
+    ChunkSize = (std::max)(ChunkSize, static_cast<std::size_t>(1));
+    const std::size_t ChunkCount = (Count + ChunkSize - 1) / ChunkSize;
+
+    std::atomic<std::size_t> NextChunk = 0;
+
+    auto RunChunks = [&]()
+    {
+      for (std::size_t Chunk = NextChunk++; Chunk < ChunkCount; Chunk = NextChunk++)
+      {
+        std::size_t Begin = Chunk * ChunkSize;
+        Task(Begin, (std::min)(Begin + ChunkSize, Count));
+      }
+    };
+
+    // No point in waking workers for a single chunk
+    const std::size_t Helpers = (std::min)(this->Workers.size(), ChunkCount ? ChunkCount - 1 : 0);
+    std::size_t Running = Helpers;
+
+    if (Helpers)
+    {
+      std::lock_guard<std::mutex> Lock(this->Mutex);
+
+      for (std::size_t I = 0; I < Helpers; ++I)
+      {
+        this->Tasks.push_back({ &NextChunk, [&]()
+        {
+          RunChunks();
+
+          {
+            std::lock_guard<std::mutex> DoneLock(this->Mutex);
+            --Running;
+          }
+
+          this->TaskDone.notify_all();
+        } });
+      }
+    }
+
+    this->TaskAvailable.notify_all();
+    RunChunks();
+
+    // Every chunk is claimed by now, helpers that didn't start have nothing left to do.
+    // Drop them and only wait for the running ones. Running other queued work here instead
+    // could re-enter whatever this thread holds (e.g. the once flag of a lazy artifact).
+    std::unique_lock<std::mutex> Lock(this->Mutex);
+
+    auto Unstarted = std::remove_if(this->Tasks.begin(), this->Tasks.end(), [&NextChunk](const QueuedTask& Queued)
+    {
+      return Queued.Owner == &NextChunk;
+    });
+
+    Running -= static_cast<std::size_t>(std::distance(Unstarted, this->Tasks.end()));
+    this->Tasks.erase(Unstarted, this->Tasks.end());
+
+    this->TaskDone.wait(Lock, [&Running]()
+    {
+      return Running == 0;
+    });
+  }
+} // !namespace COF
@@ -0,0 +1,54 @@
+#ifndef COF_THREAD_POOL_H
+#define COF_THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstddef>
+
+namespace COF
+{
+  // Fixed size pool of worker threads.
+  // The thread submitting work always works on it too and never waits for helpers that didn't start,
+  // so work can be submitted from inside a task (even one holding a lock or once flag other tasks
+  // wait on, e.g. a lazily computed artifact) without deadlocking the pool.
+  class ThreadPool
+  {
+    struct QueuedTask
+    {
+      const void* Owner = nullptr; // Identifies the ParallelFor call that queued the task
+      std::function<void()> Run;
+    };
+
+    std::vector<std::thread> Workers;
+    std::deque<QueuedTask> Tasks;
+
+    std::mutex Mutex;
+    std::condition_variable TaskAvailable;
+    std::condition_variable TaskDone;
+    bool Stopping = false;
+
+    void WorkerLoop();
+
+  public:
+    // Number of threads taking part in the work, including the calling thread
+    std::size_t GetThreadCount() const;
+
+    // Calls Task(ChunkBegin, ChunkEnd) for contiguous chunks of [0, Count).
+    // Chunks are handed out in ascending order, the calling thread works on them too.
+    // Returns once every chunk has been processed.
+    void ParallelFor(std::size_t Count, std::size_t ChunkSize, const std::function<void(std::size_t, std::size_t)>& Task);
+
+    // ThreadCount includes the calling thread, 0 uses all hardware threads
+    explicit ThreadPool(std::size_t ThreadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+  };
+} // !namespace COF
+
+#endif // !COF_THREAD_POOL_H
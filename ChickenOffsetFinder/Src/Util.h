@@ -19,6 +19,9 @@
 #include <cstddef>
 #include <fstream>
 #include <iterator>
+#include <memory>
+#include <mutex>
+#include <atomic>
 
 namespace COF
 {
@@ -127,6 +130,102 @@ namespace COF
       }
     } // !namespace String
 
+    // Minimal non-owning view over contiguous memory, since we're stuck on C++17 (no std::span).
+    // Method names mimic the standard containers so it can stand in for a std::vector in scanners.
+    template <typename T>
+    class Span
+    {
+      T* Data_ = nullptr;
+      std::size_t Size_ = 0;
+
+    public:
+      T* data() const
+      {
+        return this->Data_;
+      }
+
+      std::size_t size() const
+      {
+        return this->Size_;
+      }
+
+      bool empty() const
+      {
+        return this->Size_ == 0;
+      }
+
+      T* begin() const
+      {
+        return this->Data_;
+      }
+
+      T* end() const
+      {
+        return this->Data_ + this->Size_;
+      }
+
+      T& operator[](std::size_t Index) const
+      {
+        return this->Data_[Index];
+      }
+
+      // Clamped to the bounds of this span
+      Span subspan(std::size_t Offset, std::size_t Count = static_cast<std::size_t>(-1)) const
+      {
+        if (Offset > this->Size_)
+        {
+          return {};
+        }
+
+        return { this->Data_ + Offset, (std::min)(Count, this->Size_ - Offset) };
+      }
+
+      Span(T* Data, std::size_t Size)
+        : Data_(Data), Size_(Size)
+      {
+      }
+
+      Span() = default;
+    };
+
+    // Value computed on first access and memoized. Safe to access from several threads,
+    // concurrent first callers wait for the one computing it.
+    // Copies share the value (and its computation), so copying the owner doesn't redo the work.
+    template <typename T>
+    class Lazy
+    {
+      struct State
+      {
+        std::once_flag Once;
+        std::atomic<bool> Ready{ false };
+        T Value{};
+      };
+
+      std::shared_ptr<State> Shared = std::make_shared<State>();
+
+    public:
+      template <typename Compute>
+      const T& Get(Compute&& Function) const
+      {
+        State& Current = *this->Shared;
+
+        std::call_once(Current.Once, [&Current, &Function]()
+        {
+          Current.Value = Function();
+          Current.Ready.store(true, std::memory_order_release);
+        });
+
+        return Current.Value;
+      }
+
+      // Value if it was computed already, nullptr otherwise. Never computes.
+      const T* TryGet() const
+      {
+        const State& Current = *this->Shared;
+        return Current.Ready.load(std::memory_order_acquire) ? &Current.Value : nullptr;
+      }
+    };
+
     // Not used for now but probably useful for logging at some point.
     inline std::optional<std::string> GetFileVersion(const std::string& FilePath)
     {
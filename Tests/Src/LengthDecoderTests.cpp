@@ -0,0 +1,247 @@
+#include "Tests.h"
+#include "LengthDecoder.h"
+
+#include <Zydis/Zydis.h>
+#include <Windows.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+namespace COF
+{
+  namespace Tests
+  {
+    namespace
+    {
+      struct CodeSection
+      {
+        std::string Name;
+        std::vector<std::uint8_t> Bytes;
+      };
+
+      // Raw bytes of the executable sections of an x64 PE file (or a COF dump), empty if it isn't one
+      std::vector<CodeSection> ReadCodeSections(const std::string& Path)
+      {
+        std::vector<CodeSection> Sections;
+        std::ifstream File(Path, std::ios::binary);
+        std::vector<std::uint8_t> Image((std::istreambuf_iterator<char>(File)), std::istreambuf_iterator<char>());
+
+        auto Fits = [&Image](std::uint64_t Offset, std::uint64_t Size)
+        {
+          return Offset <= Image.size() && Size <= Image.size() - Offset;
+        };
+
+        IMAGE_DOS_HEADER DosHeader;
+        IMAGE_NT_HEADERS64 NtHeaders;
+
+        if (!Fits(0, sizeof(DosHeader)))
+        {
+          return Sections;
+        }
+
+        std::memcpy(&DosHeader, Image.data(), sizeof(DosHeader));
+
+        if (DosHeader.e_magic != IMAGE_DOS_SIGNATURE || DosHeader.e_lfanew < 0 || !Fits(DosHeader.e_lfanew, sizeof(NtHeaders)))
+        {
+          return Sections;
+        }
+
+        std::memcpy(&NtHeaders, Image.data() + DosHeader.e_lfanew, sizeof(NtHeaders));
+
+        if (NtHeaders.Signature != IMAGE_NT_SIGNATURE || NtHeaders.OptionalHeader.Magic != IMAGE_NT_OPTIONAL_HDR64_MAGIC)
+        {
+          return Sections;
+        }
+
+        const std::uint64_t SectionTable = static_cast<std::uint64_t>(DosHeader.e_lfanew)
+          + offsetof(IMAGE_NT_HEADERS64, OptionalHeader) + NtHeaders.FileHeader.SizeOfOptionalHeader;
+
+        for (WORD I = 0; I < NtHeaders.FileHeader.NumberOfSections; ++I)
+        {
+          IMAGE_SECTION_HEADER Header;
+
+          if (!Fits(SectionTable + I * sizeof(Header), sizeof(Header)))
+          {
+            break;
+          }
+
+          std::memcpy(&Header, Image.data() + SectionTable + I * sizeof(Header), sizeof(Header));
+
+          // IMAGE_SCN_CNT_CODE
+          if (!(Header.Characteristics & 0x00000020) || !Fits(Header.PointerToRawData, Header.SizeOfRawData))
+          {
+            continue;
+          }
+
+          // Without the file alignment padding
+          std::size_t Size = Header.Misc.VirtualSize
+            ? (std::min)(Header.Misc.VirtualSize, Header.SizeOfRawData)
+            : Header.SizeOfRawData;
+
+          CodeSection& Section = Sections.emplace_back();
+          Section.Name.assign(reinterpret_cast<const char*>(Header.Name), strnlen(reinterpret_cast<const char*>(Header.Name), sizeof(Header.Name)));
+          Section.Bytes.assign(Image.begin() + Header.PointerToRawData, Image.begin() + Header.PointerToRawData + Size);
+        }
+
+        return Sections;
+      }
+
+      // Binaries every Windows machine has, plus this test itself
+      std::vector<std::string> DefaultCorpora()
+      {
+        std::vector<std::string> Corpora;
+        char Path[MAX_PATH];
+
+        if (DWORD Length = GetModuleFileNameA(nullptr, Path, MAX_PATH); Length && Length < MAX_PATH)
+        {
+          Corpora.emplace_back(Path);
+        }
+
+        if (UINT Length = GetSystemDirectoryA(Path, MAX_PATH); Length && Length < MAX_PATH)
+        {
+          for (const char* Name : { "\\ntdll.dll", "\\kernel32.dll", "\\kernelbase.dll" })
+          {
+            Corpora.push_back(std::string(Path) + Name);
+          }
+        }
+
+        return Corpora;
+      }
+
+      // LengthDecoder's result as Zydis sees the instruction
+      LengthDecoder::Instruction Expect(const ZydisDecodedInstruction& Instruction, const ZydisDecodedOperand* Operands)
+      {
+        LengthDecoder::Instruction Expected;
+        Expected.Length = Instruction.length;
+
+        for (std::size_t I = 0; I < Instruction.operand_count; ++I)
+        {
+          if (Operands[I].type == ZYDIS_OPERAND_TYPE_MEMORY && Operands[I].mem.base == ZYDIS_REGISTER_RIP)
+          {
+            Expected.RipRelative = true;
+            Expected.DispOffset = Instruction.raw.disp.offset;
+          }
+        }
+
+        if (Instruction.raw.imm[0].is_relative)
+        {
+          switch (Instruction.meta.category)
+          {
+          case ZYDIS_CATEGORY_CALL:
+            Expected.OpcodeClass = LengthDecoder::Class::CallRel32;
+            break;
+
+          case ZYDIS_CATEGORY_UNCOND_BR:
+            Expected.OpcodeClass = LengthDecoder::Class::JmpRel;
+            break;
+
+          default:
+            Expected.OpcodeClass = LengthDecoder::Class::CondRel; // jcc, loop*, jrcxz
+            break;
+          }
+
+          Expected.BranchOffset = Instruction.raw.imm[0].offset;
+        }
+
+        return Expected;
+      }
+
+      bool SameDecode(const LengthDecoder::Instruction& Left, const LengthDecoder::Instruction& Right)
+      {
+        return Left.Length == Right.Length
+          && Left.OpcodeClass == Right.OpcodeClass
+          && Left.RipRelative == Right.RipRelative
+          && (!Left.RipRelative || Left.DispOffset == Right.DispOffset)
+          && (Left.OpcodeClass == LengthDecoder::Class::Other || Left.BranchOffset == Right.BranchOffset);
+      }
+    }
+
+    std::size_t LengthDecoderAgainstZydis(const std::vector<std::string>& Corpora)
+    {
+      ZydisDecoder Decoder;
+      ZydisDecoderInit(&Decoder, ZYDIS_MACHINE_MODE_LONG_64, ZYDIS_STACK_WIDTH_64);
+
+      std::size_t Failures = 0;
+      std::size_t Sections = 0;
+
+      for (const auto& Path : Corpora.empty() ? DefaultCorpora() : Corpora)
+      {
+        for (const auto& Section : ReadCodeSections(Path))
+        {
+          const std::uint8_t* Bytes = Section.Bytes.data();
+          const std::size_t Size = Section.Bytes.size();
+          std::size_t Claimed = 0;
+          std::size_t Boundaries = 0;
+          std::size_t ClaimedBoundaries = 0;
+          std::size_t NextBoundary = 0;
+          ++Sections;
+
+          // Every offset, not only the ones a sweep from the section start lands on,
+          // since sweeps resync on data and padding at arbitrary offsets.
+          for (std::size_t Offset = 0; Offset < Size; ++Offset)
+          {
+            ZydisDecodedInstruction Instruction;
+            ZydisDecodedOperand Operands[ZYDIS_MAX_OPERAND_COUNT];
+            bool Decoded = ZYAN_SUCCESS(ZydisDecoderDecodeFull(&Decoder, Bytes + Offset, Size - Offset, &Instruction, Operands));
+            auto Claim = LengthDecoder::Decode(Bytes + Offset, Size - Offset);
+
+            // Coverage of the instructions a Zydis sweep walks
+            bool IsBoundary = (Offset == NextBoundary);
+
+            if (IsBoundary)
+            {
+              NextBoundary += Decoded ? Instruction.length : 1;
+              Boundaries += Decoded;
+              ClaimedBoundaries += (Decoded && Claim);
+            }
+
+            if (!Claim)
+            {
+              continue;
+            }
+
+            ++Claimed;
+
+            if (Decoded && SameDecode(*Claim, Expect(Instruction, Operands)))
+            {
+              continue;
+            }
+
+            if (++Failures <= MaxReported)
+            {
+              std::printf("  [!] %s (%s) +0x%zX: LengthDecoder length %u class %u rip %d, Zydis %s (length %u):",
+                Path.c_str(), Section.Name.c_str(), Offset, static_cast<unsigned>(Claim->Length), static_cast<unsigned>(Claim->OpcodeClass),
+                Claim->RipRelative ? 1 : 0, Decoded ? "decoded" : "failed", Decoded ? static_cast<unsigned>(Instruction.length) : 0u);
+
+              for (std::size_t I = 0; I < Claim->Length; ++I)
+              {
+                std::printf(" %02X", Bytes[Offset + I]);
+              }
+
+              std::printf("\n");
+            }
+          }
+
+          std::printf("  [?] %s (%s): %zu bytes, %zu claimed offsets, %zu/%zu sweep instructions covered\n",
+            Path.c_str(), Section.Name.c_str(), Size, Claimed, ClaimedBoundaries, Boundaries);
+        }
+      }
+
+      // A run over nothing proves nothing
+      if (!Sections)
+      {
+        std::printf("  [!] No code sections found in the corpora\n");
+        ++Failures;
+      }
+
+      return Failures;
+    }
+  } // !namespace Tests
+} // !namespace COF
@@ -0,0 +1,44 @@
+#include "Tests.h"
+
+#include <functional>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstddef>
+
+// Usage: COFTests [<PE files/dumps to decode...>]
+int main(int ArgC, char* ArgV[])
+{
+  struct Suite
+  {
+    const char* Name;
+    std::function<std::size_t()> Run;
+  };
+
+  std::vector<std::string> Corpora(ArgV + 1, ArgV + ArgC);
+
+  const Suite Suites[] = {
+    { "PatternScannerKernels", COF::Tests::PatternScannerKernels },
+    { "LengthDecoderAgainstZydis", [&Corpora]() { return COF::Tests::LengthDecoderAgainstZydis(Corpora); } }
+  };
+
+  std::size_t FailedSuites = 0;
+
+  for (const auto& Entry : Suites)
+  {
+    std::printf("[>] %s\n", Entry.Name);
+    std::size_t Failures = Entry.Run();
+
+    if (Failures)
+    {
+      std::printf("[!] %s: %zu failed check(s)\n", Entry.Name, Failures);
+      ++FailedSuites;
+    }
+    else
+    {
+      std::printf("[+] %s passed\n", Entry.Name);
+    }
+  }
+
+  return FailedSuites ? 1 : 0;
+}
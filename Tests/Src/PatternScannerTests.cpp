@@ -0,0 +1,222 @@
+#include "Tests.h"
+#include "PatternScanner.h"
+
+#include <random>
+#include <vector>
+#include <optional>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+namespace COF
+{
+  namespace Tests
+  {
+    namespace
+    {
+      using namespace PatternScanner;
+
+      constexpr std::uint32_t Seed = 0xC0F0008;
+      constexpr std::size_t Iterations = 100000;
+      constexpr std::size_t MaxTestedMismatches = 4;
+
+      // Plain first match, independent of CompiledPattern's padding, anchor and skip table
+      std::optional<std::size_t> FindNaive(const std::vector<std::uint8_t>& Data, const std::vector<PatternElem>& Pattern)
+      {
+        if (Data.size() < Pattern.size())
+        {
+          return std::nullopt;
+        }
+
+        for (std::size_t Start = 0; Start + Pattern.size() <= Data.size(); ++Start)
+        {
+          bool Matches = true;
+
+          for (std::size_t I = 0; I < Pattern.size() && Matches; ++I)
+          {
+            Matches = (Data[Start + I] & Pattern[I].first) == Pattern[I].second;
+          }
+
+          if (Matches)
+          {
+            return Start;
+          }
+        }
+
+        return std::nullopt;
+      }
+
+      // Mismatching elements at every start position, the naive base of the approximate checks
+      std::vector<std::size_t> CountMismatchesNaive(const std::vector<std::uint8_t>& Data, const std::vector<PatternElem>& Pattern)
+      {
+        std::vector<std::size_t> Counts;
+
+        for (std::size_t Start = 0; Start + Pattern.size() <= Data.size(); ++Start)
+        {
+          std::size_t Mismatches = 0;
+
+          for (std::size_t I = 0; I < Pattern.size(); ++I)
+          {
+            Mismatches += (Data[Start + I] & Pattern[I].first) != Pattern[I].second;
+          }
+
+          Counts.push_back(Mismatches);
+        }
+
+        return Counts;
+      }
+
+      // Fewest mismatches within MaxMismatches, lowest offset of those
+      std::optional<ApproximateMatch> FindApproximateNaive(const std::vector<std::size_t>& Counts, std::size_t MaxMismatches)
+      {
+        std::optional<ApproximateMatch> Best;
+
+        for (std::size_t Start = 0; Start < Counts.size(); ++Start)
+        {
+          if (Counts[Start] <= MaxMismatches && (!Best || Counts[Start] < Best->Mismatches))
+          {
+            Best = ApproximateMatch{ Start, Counts[Start] };
+          }
+        }
+
+        return Best;
+      }
+
+      const char* KernelName(Kernel UseKernel)
+      {
+        switch (UseKernel)
+        {
+        case Kernel::AVX2:
+          return "AVX2";
+
+        case Kernel::SSE2:
+          return "SSE2";
+
+        default:
+          return "Scalar";
+        }
+      }
+    }
+
+    std::size_t PatternScannerKernels()
+    {
+      std::mt19937 Random(Seed);
+      std::size_t Failures = 0;
+
+      // AVX2 is only run where the CPU supports it
+      std::vector<Kernel> Kernels = { Kernel::Scalar, Kernel::SSE2 };
+
+      if (GetBestKernel() == Kernel::AVX2)
+      {
+        Kernels.push_back(Kernel::AVX2);
+      }
+      else
+      {
+        std::printf("  [?] AVX2 not supported, skipping the AVX2 kernel\n");
+      }
+
+      for (std::size_t Iteration = 0; Iteration < Iterations; ++Iteration)
+      {
+        // A small alphabet makes partial matches (and anchor hits that fail verification) common
+        std::uint32_t Alphabet = 1 + Random() % 16;
+
+        // Sizes around the vector widths, so that blocks, unaligned tails and
+        // patterns spanning several vectors are all covered.
+        // Exactly sized, so reading past the end shows up under the debug heap/sanitizers.
+        std::vector<std::uint8_t> Data(Random() % 300);
+
+        for (auto& Byte : Data)
+        {
+          Byte = static_cast<std::uint8_t>(Random() % Alphabet);
+        }
+
+        std::vector<PatternElem> Pattern(1 + Random() % 70);
+
+        // Often plant the pattern (taken from the data) so there is something to find
+        bool Planted = !Data.empty() && Random() % 2;
+        std::size_t PlantedAt = Planted ? Random() % Data.size() : 0;
+
+        for (std::size_t I = 0; I < Pattern.size(); ++I)
+        {
+          std::uint8_t Byte = (Planted && PlantedAt + I < Data.size())
+            ? Data[PlantedAt + I]
+            : static_cast<std::uint8_t>(Random() % Alphabet);
+
+          switch (Random() % 8)
+          {
+          case 0:
+            Pattern[I] = { 0x00, 0x00 }; // "??"
+            break;
+
+          case 1:
+            Pattern[I] = { 0xF0, static_cast<std::uint8_t>(Byte & 0xF0) }; // "4?"
+            break;
+
+          case 2:
+            Pattern[I] = { 0x0F, static_cast<std::uint8_t>(Byte & 0x0F) }; // "?8"
+            break;
+
+          default:
+            Pattern[I] = { 0xFF, Byte };
+            break;
+          }
+        }
+
+        CompiledPattern Compiled(Pattern);
+        auto Expected = FindNaive(Data, Pattern);
+
+        for (Kernel UseKernel : Kernels)
+        {
+          auto Found = Find(UseKernel, Data.data(), Data.size(), Compiled);
+
+          if (Found == Expected)
+          {
+            continue;
+          }
+
+          if (++Failures <= MaxReported)
+          {
+            std::printf("  [!] %s: iteration %zu (data %zu bytes, pattern %zu elements): expected %lld, found %lld\n",
+              KernelName(UseKernel), Iteration, Data.size(), Pattern.size(),
+              Expected ? static_cast<long long>(*Expected) : -1LL,
+              Found ? static_cast<long long>(*Found) : -1LL);
+          }
+        }
+
+        // Approximate search with the same kernels, across a few mismatch budgets
+        auto Counts = CountMismatchesNaive(Data, Pattern);
+
+        for (std::size_t MaxMismatches = 0; MaxMismatches <= MaxTestedMismatches; ++MaxMismatches)
+        {
+          auto ExpectedApproximate = FindApproximateNaive(Counts, MaxMismatches);
+
+          for (Kernel UseKernel : Kernels)
+          {
+            auto Found = FindApproximate(UseKernel, Data.data(), Data.size(), Compiled, MaxMismatches);
+
+            bool Same = (!Found && !ExpectedApproximate) || (Found && ExpectedApproximate
+              && Found->Offset == ExpectedApproximate->Offset && Found->Mismatches == ExpectedApproximate->Mismatches);
+
+            if (Same)
+            {
+              continue;
+            }
+
+            if (++Failures <= MaxReported)
+            {
+              std::printf("  [!] %s approximate (max %zu): iteration %zu (data %zu bytes, pattern %zu elements): "
+                "expected %lld (%lld mismatches), found %lld (%lld mismatches)\n",
+                KernelName(UseKernel), MaxMismatches, Iteration, Data.size(), Pattern.size(),
+                ExpectedApproximate ? static_cast<long long>(ExpectedApproximate->Offset) : -1LL,
+                ExpectedApproximate ? static_cast<long long>(ExpectedApproximate->Mismatches) : -1LL,
+                Found ? static_cast<long long>(Found->Offset) : -1LL,
+                Found ? static_cast<long long>(Found->Mismatches) : -1LL);
+            }
+          }
+        }
+      }
+
+      return Failures;
+    }
+  } // !namespace Tests
+} // !namespace COF
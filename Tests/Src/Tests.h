@@ -0,0 +1,28 @@
+#ifndef COF_TESTS_H
+#define COF_TESTS_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace COF
+{
+  // Differential tests of the fast paths against their reference implementations.
+  // Each suite prints its first failures and returns the number of failed checks.
+  namespace Tests
+  {
+    // Failures printed per suite, the rest are only counted
+    constexpr std::size_t MaxReported = 10;
+
+    // Every PatternScanner kernel (SSE2, AVX2 if supported) against a naive search,
+    // exact and approximate (FindApproximate) with small mismatch budgets
+    std::size_t PatternScannerKernels();
+
+    // LengthDecoder against Zydis at every offset of the code sections of the given PE files
+    // (e.g. COF dumps), by default of a few system binaries and this test itself.
+    // Wherever LengthDecoder claims a decode, length, opcode class and relative operands must match.
+    std::size_t LengthDecoderAgainstZydis(const std::vector<std::string>& Corpora);
+  } // !namespace Tests
+} // !namespace COF
+
+#endif // !COF_TESTS_H